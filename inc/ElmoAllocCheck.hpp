@@ -0,0 +1,47 @@
+#ifndef ELMOALLOCCHECK_H
+#define ELMOALLOCCHECK_H
+
+// Standard headers
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// instrumentation sizing
+#define ALLOC_MAX_THREADS 8     // threads whose heap calls are counted
+#define ALLOC_MAX_TRACES  4     // heap calls whose stack is kept for the report
+#define ALLOC_TRACE_DEPTH 24    // frames kept per stack
+
+// heap calls and page faults of the tracked threads between allocCheckBegin and allocCheckEnd
+struct AllocUsage {
+  uint64_t calls;            // malloc, calloc, realloc, memalign family and free
+  uint64_t bytes;            // [bytes] requested
+  long minflt;               // minor page faults
+  long majflt;               // major page faults
+};
+
+/*  Heap and page fault instrumentation of the steady-state cycle
+    - linking this library into an executable replaces malloc, free and the rest of the family with
+      wrappers around the glibc allocator, so every heap call in the process goes through them (operator
+      new included)
+    - the wrappers count the calls of the tracked threads while the check is running and keep the stack of
+      the first few, the page faults of the tracked threads come from /proc/self/task/<tid>/stat
+    - only meant for check builds (elmo_alloc_check), the control program does not link it
+*/
+
+// function to get the kernel thread id of the calling thread
+pid_t allocCheckSelf();
+
+// function to count the heap calls and page faults of a thread from the next allocCheckBegin, false when full
+bool allocCheckThread(pid_t tid);
+
+// function to start counting, after the warm-up
+void allocCheckBegin();
+
+// function to stop counting and return the totals of the tracked threads
+AllocUsage allocCheckEnd();
+
+// function to print the stacks of the first heap calls counted
+void allocCheckTraces(FILE *out);
+
+#endif
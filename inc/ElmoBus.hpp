@@ -0,0 +1,130 @@
+#ifndef ELMOBUS_H
+#define ELMOBUS_H
+
+// Standard headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Ethercat headers
+#include <ethercattype.h>
+
+// Custom headers
+#include "ElmoTelemetry.hpp"
+#include "ElmoExecutor.hpp"
+
+// EtherCAT bus backends
+#define BUS_SOEM 0   // real drives through SOEM on an ethernet port
+#define BUS_SIM  1   // simulated drives inside this process
+
+// bus health of a drive seen by checkState
+#define DRIVE_OK   0   // OPERATIONAL
+#define DRIVE_DOWN 1   // out of OPERATIONAL, being brought back
+#define DRIVE_LOST 2   // not answering
+
+// working counter of one drive in a complete exchange: 2 for writing its outputs, 1 for reading its inputs
+#define DRIVE_WKC 3
+
+// struct to hold out-going data, Laptop --> ELMO
+// Torque Control (x1602)
+struct ELMOOut {
+   int16_t torque;       // "Torque Command"
+   uint16_t controlword; // "Control Word", converted to binary and use DS402 SM, 6040
+};
+
+// struct to hold in-coming data, ELMO --> Laptop
+// Pos and Vel (0x1A03)
+struct ELMOIn {
+    int32_t position;  // "Position Actual Value"
+    uint32_t inputs;   // "Digital Inputs"
+    int32_t velocity;  // "Velocity Actual Value"
+    uint16_t status;   // "Status Word", converted to binary and use DS402 SM, 6041
+};
+
+// struct for the simulated drive model
+struct SimConfig {
+  int drives;                        // number of simulated drives on the chain
+  std::vector<double> gear_ratio;    // gear ratio of each drive (chain order)
+  double cpr;                        // encoder counts per motor revolution
+  double rated_torque;               // motor rated torque, torque command is in 1/1000 of it [Nm]
+  double inertia;                    // joint side inertia [kg m^2]
+  double damping;                    // joint side viscous damping [Nm s/rad]
+  double roundtrip_us;               // emulated frame round trip time [us]
+  double dc_drift_ppm;               // rate error of the drives' reference clock against the master [ppm]
+  double dropout_rate;               // [1/s] rate at which a drive drops to SAFE_OP + ERROR, 0 never
+};
+
+// struct for one EtherCAT chain when the drives are split over several ports
+struct ChainConfig {
+  std::string port;                  // ethernet port of the chain
+  int cpu;                           // core the chain is exchanged on, -1 leaves it free
+  int drives;                        // number of simulated drives on the chain (BUS_SIM)
+};
+
+// struct for the bus backend configuration
+struct BusConfig {
+  int type;                          // BUS_SOEM or BUS_SIM
+  SimConfig sim;                     // used when type is BUS_SIM
+  std::vector<ChainConfig> chains;   // empty: one chain on the ethernet port
+  bool degraded;                     // keep the drives that exchange running while others are out (held at zero torque)
+};
+
+//  An EtherCAT chain of ELMO drives, implemented by the SOEM and simulated backends
+class ELMOBus {
+
+    public:
+
+        // constructor / desctructors
+        ELMOBus() {};
+        virtual ~ELMOBus() {};
+
+        // function to find the drives, map the PDOs and bring the chain to OPERATIONAL
+        virtual bool open(const char* port, uint8 opmode) = 0;
+
+        // function to request SYNC0 on every drive, applied when the chain is opened
+        virtual void enableSync0(uint32 cycle_ns, int32 shift_ns) = 0;
+
+        // function to request the telemetry PDO after 0x1A03 on every drive, applied when the chain is opened
+        virtual void mapTelemetry(const TelemetryLayout &layout) = 0;
+
+        // function to walk every drive through the DS402 enable sequence
+        virtual void enableDrives() = 0;
+
+        // function to return the chain to INIT and release the port
+        virtual void close() = 0;
+
+        // number of drives found on the chain
+        virtual int slaveCount() = 0;
+
+        // process data images of drive i (0-indexed, daisy chain order)
+        virtual ELMOIn *inputs(int i) = 0;
+        virtual ELMOOut *outputs(int i) = 0;
+
+        // telemetry PDO image of drive i inside its inputs, decoded with the TelemetryLayout
+        virtual const uint8 *telemetry(int i) = 0;
+
+        // cyclic process data exchange, receive returns the working counter
+        virtual int sendProcessdata() = 0;
+        virtual int receiveProcessdata(int timeout) = 0;
+
+        // working counter of a complete exchange
+        virtual int expectedWKC() = 0;
+
+        // distributed clock time of the reference clock carried by the last frame [ns]
+        virtual int64 dcTime() = 0;
+
+        // function to check the drive states and recover drives out of OPERATIONAL (health monitor, in a window
+        // between bus cycles). Fills the state every drive was found in (DRIVE_*), returns the number not OK
+        virtual int checkState(bool wkc_low, uint8 *health) = 0;
+
+        // acyclic CoE SDO transfer with drive i, blocks until the drive answers or the timeout [us] expires,
+        // returns the working counter (> 0 on success). Safe to call from another thread than the cyclic one
+        virtual int sdoRead(int i, uint16 index, uint8 subindex, int *size, void *data, int timeout) = 0;
+        virtual int sdoWrite(int i, uint16 index, uint8 subindex, int size, const void *data, int timeout) = 0;
+};
+
+// function to create the configured bus backend, the executor starts the worker threads of several chains
+ELMOBus *createBus(BusConfig config, double freq, ELMOExecutor *executor = NULL);
+
+#endif
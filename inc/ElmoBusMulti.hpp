@@ -0,0 +1,108 @@
+#ifndef ELMOBUSMULTI_H
+#define ELMOBUSMULTI_H
+
+// Standard headers
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+// Custom headers
+#include "ElmoBus.hpp"
+#include "ElmoChannel.hpp"
+#include "ElmoExecutor.hpp"
+
+// worker start: wait until every worker started, then run or leave without touching the barriers
+#define LAUNCH_WAIT    0
+#define LAUNCH_RUN     1
+#define LAUNCH_ABORT   2
+#define LAUNCH_POLL_US 100
+
+/*  Several EtherCAT chains driven as one bus
+    - each chain has its own port, SOEM context and process data image (ELMOBusSoem or ELMOBusSim)
+    - chain 0 is exchanged by the calling (comm) thread, every other chain by its own worker thread, started by
+      the executor in the bus role on the core of its chain
+    - all chains send and receive in the same cycle: sendProcessdata releases the workers through a
+      barrier and receiveProcessdata waits for all of them, so the process data of every chain is
+      ready (and the outputs are safe to write) between receive and the next send
+    - drives are numbered chain after chain (chain 0 first), in daisy chain order within a chain
+    - DC synchronous mode is not supported on more than one chain, only chain 0's reference clock would be
+      followed and the others would drift
+*/
+class ELMOBusMulti : public ELMOBus {
+
+    public:
+
+        // constructor / desctructors, takes ownership of the chains, the workers are started by the executor
+        ELMOBusMulti(std::vector<ELMOBus *> chains, std::vector<ChainConfig> config, ELMOExecutor *executor);
+        ~ELMOBusMulti();
+
+        // ELMOBus interface
+        bool open(const char* port, uint8 opmode);
+        void enableSync0(uint32 cycle_ns, int32 shift_ns);
+        void mapTelemetry(const TelemetryLayout &layout);
+        void enableDrives();
+        void close();
+        int slaveCount();
+        ELMOIn *inputs(int i);
+        ELMOOut *outputs(int i);
+        const uint8 *telemetry(int i);
+        int sendProcessdata();
+        int receiveProcessdata(int timeout);
+        int expectedWKC();
+        int64 dcTime();
+        int checkState(bool wkc_low, uint8 *health);
+        int sdoRead(int i, uint16 index, uint8 subindex, int *size, void *data, int timeout);
+        int sdoWrite(int i, uint16 index, uint8 subindex, int size, const void *data, int timeout);
+
+    private:
+
+        // one chain and the state its worker thread shares with the comm thread
+        struct alignas(CACHE_LINE) Chain {
+          ELMOBusMulti *multi;     // owner
+          ELMOBus *bus;            // the chain
+          ChainConfig config;      // port and core
+          int index;               // chain index
+          int first;               // index of the chain's first drive on the bus
+          std::atomic<int> wkc;    // working counter of the last exchange, read by the health monitor
+          int thread;              // executor handle of the worker thread (chains 1..n-1)
+        };
+        std::vector<Chain> chains;
+
+        // starts and joins the workers
+        ELMOExecutor *executor;
+
+        // DC synchronous mode was requested on several chains, open fails
+        bool dc_refused;
+
+        // drive i lives on chain drive_chain[i]
+        std::vector<int> drive_chain;
+
+        // cycle barriers: start releases the exchange, done collects it
+        SpinBarrier start;
+        SpinBarrier done;
+
+        // set by close to stop the workers
+        volatile bool stop;
+
+        // LAUNCH_*, set by open once every worker started or one could not be
+        std::atomic<int> launch;
+
+        // true while the worker threads run
+        bool running;
+
+        // function to pin the calling thread to a core (-1 leaves it free)
+        static void pinThread(int cpu, int index);
+
+        // worker thread of one chain
+        static void *worker(void *arg);
+
+        // function to stop and join the worker threads
+        void stopWorkers();
+};
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef ELMOBUSSIM_H
+#define ELMOBUSSIM_H
+
+// Standard headers
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+// Custom headers
+#include "ElmoBus.hpp"
+#include "ElmoCycle.hpp"
+
+// DS402 status words reported by the simulated drives
+#define SIM_NOT_READY         0x0000  // not ready to switch on
+#define SIM_SWITCH_ON_DISABLED 0x0250 // switch on disabled (SOD)
+#define SIM_READY_SWITCH_ON   0x0231  // ready to switch on (RSO)
+#define SIM_SWITCHED_ON       0x0233  // switched on (SO)
+#define SIM_OP_ENABLED        0x0237  // operation enabled (ARMED)
+#define SIM_QUICK_STOP        0x0217  // quick stop active
+#define SIM_FAULT             0x0218  // fault
+
+// number of exchanges a drive stays NOT READY after power up
+#define SIM_BOOT_CYCLES 10
+
+// emulated SDO answer time of the drive firmware [us]
+#define SIM_MAILBOX_US 1000
+
+// emulated time of an AL status read / write [us]
+#define SIM_AL_US 200
+
+// error code (0x603F) reported while a simulated drive is in FAULT
+#define SIM_FAULT_CODE 0x8130
+
+// telemetry of the simulated drives: DC link voltage [mV], ambient temperature and winding
+// temperature rise at rated current [C], thermal time constant [s]
+#define SIM_DC_VOLTAGE  48000
+#define SIM_AMBIENT     30.0
+#define SIM_TEMP_RISE   40.0
+#define SIM_THERMAL_TAU 60.0
+
+// one entry of the simulated object dictionary
+struct SimObject {
+  uint32 value;              // little endian value
+  int size;                  // [bytes]
+};
+
+// one simulated ELMO drive with a motor + gear load
+struct SimDrive {
+  ELMOIn in;                 // TxPDO 0x1A03 image
+  ELMOOut out;               // RxPDO 0x1602 image
+  ELMOOut latched;           // outputs received with the last frame
+  std::atomic<uint16> state; // DS402 state (one of the SIM_* status words), read by the SDO worker
+  uint16 last_controlword;   // for the fault reset rising edge
+  int boot;                  // exchanges left before leaving NOT READY
+  double gear_ratio;         // gear ratio
+  double q;                  // joint position [rad]
+  double qd;                 // joint velocity [rad/s]
+  double temperature;        // drive temperature [C]
+  uint8 telemetry[TELEMETRY_MAX_BYTES]; // telemetry PDO image
+};
+
+//  ELMO drives simulated in-process, no EtherCAT hardware needed
+class ELMOBusSim : public ELMOBus {
+
+    public:
+
+        // constructor / desctructors
+        ELMOBusSim(SimConfig config, double freq);
+        ~ELMOBusSim() {};
+
+        // ELMOBus interface
+        bool open(const char* port, uint8 opmode);
+        void enableSync0(uint32 cycle_ns, int32 shift_ns);
+        void mapTelemetry(const TelemetryLayout &layout);
+        void enableDrives();
+        void close();
+        int slaveCount();
+        ELMOIn *inputs(int i);
+        ELMOOut *outputs(int i);
+        const uint8 *telemetry(int i);
+        int sendProcessdata();
+        int receiveProcessdata(int timeout);
+        int expectedWKC();
+        int64 dcTime();
+        int checkState(bool wkc_low, uint8 *health);
+        int sdoRead(int i, uint16 index, uint8 subindex, int *size, void *data, int timeout);
+        int sdoWrite(int i, uint16 index, uint8 subindex, int size, const void *data, int timeout);
+
+    private:
+
+        // drive model parameters
+        SimConfig config;
+        double dt;
+
+        // objects in the telemetry PDO
+        TelemetryLayout telemetry_layout;
+
+        // simulated drives
+        std::vector<SimDrive> drives;
+
+        // reference clock: start time on the master clock, DC time at start and the last frame DC time [ns]
+        int64_t dc_start_ns;
+        int64_t dc_epoch_ns;
+        int64 dc_time;
+
+        // time the last frame was sent, the round trip runs from there [ns]
+        int64_t t_sent;
+
+        // EtherCAT state of every drive (EC_STATE_*), dropped by the comm thread, brought back by checkState
+        std::unique_ptr<std::atomic<uint16>[]> al_state;
+
+        // drop out draws and a state check left to finish
+        unsigned int seed;
+        bool docheck;
+
+        // object dictionary of every drive, key (index << 8) | subindex, SDOs come from another thread
+        std::vector<std::map<uint32, SimObject>> objects;
+        std::mutex objects_lock;
+
+        // function to apply a control word to the DS402 state machine of one drive
+        void applyControlword(SimDrive &drive, uint16 controlword);
+
+        // function to advance the motor + gear model of one drive by one period
+        void stepDynamics(SimDrive &drive, int16 torque);
+
+        // function to fill the telemetry PDO image of one drive for the torque it applied
+        void fillTelemetry(SimDrive &drive, int16 torque);
+};
+
+#endif
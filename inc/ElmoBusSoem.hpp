@@ -0,0 +1,98 @@
+#ifndef ELMOBUSSOEM_H
+#define ELMOBUSSOEM_H
+
+// Standard headers
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Ethercat headers
+#include <ethercat.h>
+#include <ethercattype.h>
+#include <nicdrv.h>
+#include <ethercatbase.h>
+#include <ethercatmain.h>
+#include <ethercatdc.h>
+#include <ethercatcoe.h>
+#include <ethercatfoe.h>
+#include <ethercatconfig.h>
+#include <ethercatprint.h>
+
+// Custom headers
+#include "ElmoBus.hpp"
+
+/*  ELMO drives on a real EtherCAT chain, driven through SOEM
+    - uses the ecx_ context API, every instance owns its own slave list, groups and process data
+      image, so several chains on separate ports can run side by side (see ELMOBusMulti)
+*/
+class ELMOBusSoem : public ELMOBus {
+
+    public:
+
+        // constructor / desctructors
+        ELMOBusSoem();
+        ~ELMOBusSoem() {};
+
+        // ELMOBus interface
+        bool open(const char* port, uint8 opmode);
+        void enableSync0(uint32 cycle_ns, int32 shift_ns);
+        void mapTelemetry(const TelemetryLayout &layout);
+        void enableDrives();
+        void close();
+        int slaveCount();
+        ELMOIn *inputs(int i);
+        ELMOOut *outputs(int i);
+        const uint8 *telemetry(int i);
+        int sendProcessdata();
+        int receiveProcessdata(int timeout);
+        int expectedWKC();
+        int64 dcTime();
+        int checkState(bool wkc_low, uint8 *health);
+        int sdoRead(int i, uint16 index, uint8 subindex, int *size, void *data, int timeout);
+        int sdoWrite(int i, uint16 index, uint8 subindex, int size, const void *data, int timeout);
+
+    private:
+
+        // SOEM context of this chain and the state it points to
+        ecx_contextt context;
+        ecx_portt port;
+        ec_slavet slave[EC_MAXSLAVE];
+        int slavecount;
+        ec_groupt group[EC_MAXGROUP];
+        uint8 esibuf[EC_MAXEEPBUF];
+        uint32 esimap[EC_MAXEEPBITMAP];
+        ec_eringt elist;
+        ec_idxstackT idxstack;
+        ec_SMcommtypet SMcommtype[EC_MAX_MAPT];
+        ec_PDOassignt PDOassign[EC_MAX_MAPT];
+        ec_PDOdesct PDOdesc[EC_MAX_MAPT];
+        ec_eepromSMt eepSM;
+        ec_eepromFMMUt eepFMMU;
+        boolean ecaterror;
+        int64 DCtime;
+
+        // process data image of the whole chain
+        char IOmap[4096];
+
+        // working counter of a complete exchange
+        int expected_wkc;
+
+        // print a new line before the next state check message
+        boolean needlf;
+
+        // group checked by checkState
+        uint8 currentgroup;
+
+        // SYNC0 cycle time and shift, 0 keeps the drives free running [ns]
+        uint32 sync0_cycle_ns;
+        int32 sync0_shift_ns;
+
+        // objects mapped into the telemetry PDO, none keeps the 0x1A03 mapping alone
+        TelemetryLayout telemetry_layout;
+
+        // function to request INIT on all drives after the heartbeat is turned back on
+        void requestInit();
+};
+
+#endif
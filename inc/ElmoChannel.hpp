@@ -0,0 +1,391 @@
+#ifndef ELMOCHANNEL_H
+#define ELMOCHANNEL_H
+
+// Standard headers
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+
+// size of a cache line, used to keep the writer and reader sides apart
+#define CACHE_LINE 64
+
+// channels are members of heap allocated structs (ELMOData), new only honours their alignment from C++17 on
+#if __cplusplus < 201703L
+#error "ElmoChannel needs C++17 (aligned new for the cache line aligned channels)"
+#endif
+
+// time a barrier spins before its waiters go to sleep [ns]
+#define BARRIER_SPIN_NS 20000
+
+// function to copy a channel value, overloaded for values with runtime-sized parts (DriveFrame)
+template <typename T>
+inline void channelCopy(T &dst, const T &src) {
+    memcpy(&dst, &src, sizeof(T));
+}
+
+/* Single writer, many reader snapshot channel (seqlock)
+   - the writer never waits, it bumps the sequence to odd, updates, and bumps it to even
+   - readers copy the value and retry if the sequence changed while copying
+   - used for ELMO --> Laptop state, so the comm thread never blocks on the app
+*/
+template <typename T>
+class SeqLock {
+
+    public:
+
+        // constructor / desctructors
+        SeqLock() : seq(0), value() {};
+        ~SeqLock() {};
+
+        // function to set up the value (e.g. size its arrays) before any thread uses the channel
+        void init(const T& v) {
+            this->value = v;
+        }
+
+        // writer: start an in-place update and get the value to fill in
+        T& beginWrite() {
+            this->seq.store(this->seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            return this->value;
+        }
+
+        // writer: publish the in-place update
+        void endWrite() {
+            this->seq.store(this->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // writer: publish a full copy
+        void write(const T& v) {
+            channelCopy(this->beginWrite(), v);
+            this->endWrite();
+        }
+
+        // reader: copy a consistent snapshot (into any type channelCopy takes it to), returns the number of retries
+        template <typename U>
+        int read(U& out) const {
+            int retries = -1;
+            uint32_t s0, s1;
+            do {
+                retries++;
+                s0 = this->seq.load(std::memory_order_acquire);
+                while (s0 & 1) {
+                    s0 = this->seq.load(std::memory_order_acquire);
+                }
+                channelCopy(out, this->value);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                s1 = this->seq.load(std::memory_order_relaxed);
+            } while (s0 != s1);
+            return retries;
+        }
+
+        // number of completed writes
+        uint32_t sequence() const {
+            return this->seq.load(std::memory_order_acquire) >> 1;
+        }
+
+    private:
+
+        // sequence counter, odd while a write is in progress
+        alignas(CACHE_LINE) std::atomic<uint32_t> seq;
+
+        // the protected value
+        alignas(CACHE_LINE) T value;
+};
+
+/* Single producer, single consumer latest-value channel (triple buffer)
+   - producer and consumer each own one buffer, the third is swapped atomically
+   - both sides are wait-free, the consumer always gets the newest complete value
+   - used for Laptop --> ELMO commands, so the comm thread never waits on the app
+*/
+template <typename T>
+class TripleBuffer {
+
+    public:
+
+        // constructor / desctructors
+        TripleBuffer() : buf(), middle(2), back(0), front(1) {};
+        ~TripleBuffer() {};
+
+        // function to set up all buffers (e.g. size their arrays) before any thread uses the channel
+        void init(const T& v) {
+            for (int i = 0; i < 3; i++) {
+                this->buf[i].value = v;
+            }
+        }
+
+        // producer: get the buffer to fill in
+        T& writeBuffer() {
+            return this->buf[this->back].value;
+        }
+
+        // producer: publish the filled buffer and take the spare one
+        void publish() {
+            this->back = this->middle.exchange(this->back | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // consumer: get the newest published value
+        const T& read() {
+            if (this->middle.load(std::memory_order_relaxed) & FRESH) {
+                this->front = this->middle.exchange(this->front, std::memory_order_acq_rel) & INDEX;
+            }
+            return this->buf[this->front].value;
+        }
+
+    private:
+
+        // bits of the shared index
+        static const uint8_t INDEX = 0x3;  // buffer index
+        static const uint8_t FRESH = 0x4;  // set when the middle buffer holds an unread value
+
+        // buffers padded to their own cache lines
+        struct alignas(CACHE_LINE) Slot { T value; };
+        Slot buf[3];
+
+        // shared spare buffer index
+        alignas(CACHE_LINE) std::atomic<uint8_t> middle;
+
+        // producer and consumer owned buffer indices
+        alignas(CACHE_LINE) uint8_t back;
+        alignas(CACHE_LINE) uint8_t front;
+};
+
+/* Single producer, single consumer bounded queue (lock-free ring)
+   - storage is allocated once in the constructor, push and pop never allocate
+   - push fails instead of blocking when the ring is full
+   - each side caches the other side's index to avoid sharing cache lines every call
+*/
+template <typename T>
+class SpscRing {
+
+    public:
+
+        // constructor / desctructors, capacity is rounded up to a power of two
+        explicit SpscRing(size_t capacity) : head(0), tail_cache(0), tail(0), head_cache(0) {
+            size_t n = 1;
+            while (n < capacity) {
+                n <<= 1;
+            }
+            this->mask = n - 1;
+            this->buf = new T[n];
+        };
+        ~SpscRing() { delete[] this->buf; };
+
+        // not copyable
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        // producer: append one element, returns false if the ring is full
+        bool push(const T& v) {
+            size_t h = this->head.load(std::memory_order_relaxed);
+            if (h - this->tail_cache > this->mask) {
+                this->tail_cache = this->tail.load(std::memory_order_acquire);
+                if (h - this->tail_cache > this->mask) {
+                    return false;
+                }
+            }
+            this->buf[h & this->mask] = v;
+            this->head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer: take one element, returns false if the ring is empty
+        bool pop(T& v) {
+            size_t t = this->tail.load(std::memory_order_relaxed);
+            if (t == this->head_cache) {
+                this->head_cache = this->head.load(std::memory_order_acquire);
+                if (t == this->head_cache) {
+                    return false;
+                }
+            }
+            v = this->buf[t & this->mask];
+            this->tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // number of elements currently queued
+        size_t size() const {
+            return this->head.load(std::memory_order_acquire) - this->tail.load(std::memory_order_acquire);
+        }
+
+        // max number of elements
+        size_t capacity() const {
+            return this->mask + 1;
+        }
+
+    private:
+
+        // element storage
+        T *buf;
+        size_t mask;
+
+        // producer side
+        alignas(CACHE_LINE) std::atomic<size_t> head;
+        size_t tail_cache;
+
+        // consumer side
+        alignas(CACHE_LINE) std::atomic<size_t> tail;
+        size_t head_cache;
+};
+
+/* Single writer, fixed readers read-copy-update cell
+   - the writer publishes a new copy with one pointer swap, readers pick the pointer up at their cycle boundary
+     and use the copy until their next boundary, neither side locks and readers never copy or wait
+   - every reader marks the epoch it last picked the pointer up in, the writer frees the replaced copy once
+     every reader picked it up after the swap (grace period), publishing fails until then
+   - used for parameters swapped while the loops run (gains and limits reloaded from the config)
+*/
+template <typename T, int READERS>
+class RcuCell {
+
+    public:
+
+        // constructor / desctructors
+        RcuCell() : current(NULL), epoch(1), retired(NULL), retired_epoch(0) {
+            for (int r = 0; r < READERS; r++) {
+                this->seen[r].epoch.store(IDLE, std::memory_order_relaxed);
+            }
+        };
+        ~RcuCell() {
+            delete this->current.load(std::memory_order_relaxed);
+            delete this->retired;
+        };
+
+        // not copyable
+        RcuCell(const RcuCell&) = delete;
+        RcuCell& operator=(const RcuCell&) = delete;
+
+        // writer: publish a copy of the value, false while the previous copy is still in its grace period
+        bool publish(const T& v) {
+            if (!this->reclaim()) {
+                return false;
+            }
+            T *copy = new T(v);
+            this->retired = this->current.exchange(copy, std::memory_order_seq_cst);
+            this->retired_epoch = this->epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+            return true;
+        }
+
+        // writer: free the replaced copy once no reader can hold it, false while one still might
+        bool reclaim() {
+            if (this->retired == NULL) {
+                return true;
+            }
+
+            // seq_cst with the readers' mark: a reader whose mark this scan misses loads the pointer after the swap
+            for (int r = 0; r < READERS; r++) {
+                uint64_t e = this->seen[r].epoch.load(std::memory_order_seq_cst);
+                if (e != IDLE && e < this->retired_epoch) {
+                    return false;
+                }
+            }
+            delete this->retired;
+            this->retired = NULL;
+            return true;
+        }
+
+        // reader: get the newest copy (NULL before the first publish), valid until this reader's next read or leave
+        const T *read(int reader) {
+            // the mark must be visible before the pointer is loaded (store-load order, seq_cst on both sides)
+            this->seen[reader].epoch.store(this->epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            return this->current.load(std::memory_order_seq_cst);
+        }
+
+        // reader: stop holding a copy, e.g. when the reader's loop ends
+        void leave(int reader) {
+            this->seen[reader].epoch.store(IDLE, std::memory_order_release);
+        }
+
+    private:
+
+        // epoch of a reader that holds no copy
+        static const uint64_t IDLE = UINT64_MAX;
+
+        // newest copy and the number of swaps
+        alignas(CACHE_LINE) std::atomic<T *> current;
+        std::atomic<uint64_t> epoch;
+
+        // epoch every reader last picked the pointer up in, padded to their own cache lines
+        struct alignas(CACHE_LINE) Mark { std::atomic<uint64_t> epoch; };
+        Mark seen[READERS];
+
+        // writer owned: replaced copy waiting for its grace period, and the epoch it ends in
+        alignas(CACHE_LINE) T *retired;
+        uint64_t retired_epoch;
+};
+
+/* Reusable barrier for a fixed group of threads (generation counting)
+   - the last thread to arrive releases the others by bumping the generation
+   - waiters spin on the generation for spin_ns, then sleep on it (futex) so waiting threads
+     give their core back, e.g. when the chains share cores with the app
+*/
+class SpinBarrier {
+
+    public:
+
+        // constructor / desctructors
+        SpinBarrier() : parties(1), spin_ns(BARRIER_SPIN_NS), count(0), generation(0), sleepers(0) {};
+        ~SpinBarrier() {};
+
+        // function to set the number of threads and the spin time, before any thread waits
+        void init(int parties, int64_t spin_ns = BARRIER_SPIN_NS) {
+            this->parties = parties;
+            this->spin_ns = spin_ns;
+            this->count.store(0, std::memory_order_relaxed);
+        }
+
+        // function to wait until all threads arrived, everything written before is visible after
+        void wait() {
+            uint32_t gen = this->generation.load(std::memory_order_acquire);
+            if (this->count.fetch_add(1, std::memory_order_acq_rel) == this->parties - 1) {
+                this->count.store(0, std::memory_order_relaxed);
+                this->generation.store(gen + 1, std::memory_order_seq_cst);
+                if (this->sleepers.load(std::memory_order_seq_cst) > 0) {
+                    syscall(SYS_futex, &this->generation, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+                }
+                return;
+            }
+
+            // spin while the others are about to arrive
+            int64_t t_end = now_ns() + this->spin_ns;
+            while (this->generation.load(std::memory_order_acquire) == gen && now_ns() < t_end) {
+            }
+
+            // then sleep until the last thread bumps the generation
+            this->sleepers.fetch_add(1, std::memory_order_seq_cst);
+            while (this->generation.load(std::memory_order_seq_cst) == gen) {
+                syscall(SYS_futex, &this->generation, FUTEX_WAIT_PRIVATE, gen, NULL, NULL, 0);
+            }
+            this->sleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+    private:
+
+        // monotonic time [ns]
+        static int64_t now_ns() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+        }
+
+        // number of threads
+        int parties;
+
+        // time to spin before sleeping [ns]
+        int64_t spin_ns;
+
+        // threads arrived in the current generation
+        alignas(CACHE_LINE) std::atomic<int> count;
+
+        // bumped by the last thread of each generation, waited on by the sleepers
+        alignas(CACHE_LINE) std::atomic<uint32_t> generation;
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the sleepers wait on the generation word");
+
+        // threads sleeping on the generation
+        std::atomic<int> sleepers;
+};
+
+#endif
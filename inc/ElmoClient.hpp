@@ -0,0 +1,98 @@
+#ifndef ELMOCLIENT_H
+#define ELMOCLIENT_H
+
+// Custom headers
+#include "ElmoShm.hpp"
+
+// time the client waits for the daemon's bus to come up in attach [sec]
+#define CLIENT_ATTACH_TIMEOUT 5.0
+
+/*  Controller side of the bus daemon, with the state and command calls of ELMOInterface
+    - attach maps the daemon's shared memory segment and claims it, detach hands the drives back to zero
+      torque. Neither touches the bus, the drives stay enabled across controller restarts
+    - states come straight out of the segment (one copy into the preallocated snapshot, as in process),
+      torques and setpoints go straight into it
+    - every sendTorque / sendSetpoint is also the heartbeat: the daemon holds zero torque once the newest one
+      is older than its heartbeat timeout, heartbeat keeps the current command alive without a new one
+    - in setpoint mode the daemon runs the PD law in the bus cycle with its own limits and interpolation
+*/
+class ELMOClient {
+
+    public:
+
+        // constructor / desctructors
+        ELMOClient() {};
+        ~ELMOClient() { this->detach(); };
+
+        // function to attach to the daemon's segment, false if there is no daemon or another client holds it
+        bool attach(const char *name, double timeout = CLIENT_ATTACH_TIMEOUT);
+
+        // function to hand the drives back to zero torque and release the segment
+        void detach();
+
+        // function to keep the current command alive without sending a new one
+        void heartbeat();
+
+        // function to set the low level gains and limits
+        void setGains(JointGains gains);
+        void setLimits(JointLimits limits);
+
+        // function to get a consistent snapshot of all drives, valid until the next read. Detached it is the
+        // last one read, commands are refused
+        const ELMOState &getState();
+
+        // number of drives on the chain
+        int getDriveCount() { return this->snapshot.drives(); };
+
+        // function to get the newest telemetry of all drives (daisy chain order), valid until the next call
+        const ELMOTelemetry &getTelemetry();
+
+        // function to get teh ELMO status
+        ELMOStatus getELMOStatus();
+
+        // function to get encoder data
+        JointVec getEncoderData();
+
+        // functions to compute and send target torque to the ELMO
+        JointTorque computeTorque(JointVec joint_ref,
+                                  JointTorque tau_ff);
+        void sendTorque(JointTorque torque);
+
+        // function to stream a setpoint to the daemon's in-cycle PD law, uses the current gains
+        void sendSetpoint(JointVec joint_ref, JointTorque tau_ff);
+
+        // function to get the torques sent to the drives in the newest snapshot
+        JointTorque getTorque();
+
+        // function to get the joints whose reference was saturated / that are outside their limits (bit masks)
+        int getSaturatedJoints() { return this->ref_saturated; };
+        int getTrippedJoints() { return this->joint_tripped; };
+
+        // bus cycles the daemon held zero torque without a client heartbeat
+        uint64 getHeldCycles() { return (this->shm != NULL) ? this->shm->held.load(std::memory_order_relaxed) : 0; };
+
+    private:
+
+        // daemon's segment, NULL while detached
+        ShmBus *shm = NULL;
+
+        // newest drive snapshot and telemetry, sized once in attach so reading them does not allocate
+        ELMOState snapshot;
+        ELMOTelemetry telemetry;
+
+        // struct to hold the joint gains
+        JointGains gains;
+
+        //struct to hold the joint limits
+        JointLimits limits;
+
+        // joints whose reference was saturated / that were outside their limits in the last tick (bit masks)
+        int ref_saturated = 0;
+        int joint_tripped = 0;
+
+        // function to fill in and publish a command
+        ShmCommand &beginCommand(int mode);
+        void endCommand(ShmCommand &command);
+};
+
+#endif
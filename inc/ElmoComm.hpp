@@ -13,54 +13,144 @@
 #include <bitset>
 #include <chrono>
 #include <algorithm>
+#include <cstdlib>
+#include <vector>
 
 // Ethercat headers
-#include <ethercat.h>
 #include <ethercattype.h>
-#include <nicdrv.h>
-#include <ethercatbase.h>
-#include <ethercatmain.h>
-#include <ethercatdc.h>
-#include <ethercatcoe.h>
-#include <ethercatfoe.h>
-#include <ethercatconfig.h>
-#include <ethercatprint.h>
+
+// Custom headers
+#include "ElmoCycle.hpp"
+#include "ElmoChannel.hpp"
+#include "ElmoStats.hpp"
+#include "ElmoBus.hpp"
+#include "ElmoTelemetry.hpp"
+#include "ElmoMailbox.hpp"
+#include "ElmoHealth.hpp"
+#include "ElmoDS402.h"
+
+// drive enable sequences
+#define ENABLE_SDO 0   // SDO writes to 0x6040, one drive after the other
+#define ENABLE_PDO 1   // cyclic control word PDO, all drives in parallel
+
+// struct for the drive enable configuration
+struct EnableConfig {
+  int mode;                  // ENABLE_SDO or ENABLE_PDO
+  double timeout;            // [sec] time each drive has to reach OPERATION ENABLED (PDO mode)
+};
+
+/* Per cycle fields followed by one record per drive (daisy chain order)
+   - the drive records are sized once at startup, from the number of drives found on the chain
+   - channelCopy copies into an already sized frame without allocating
+*/
+template <typename Head, typename Drive>
+struct DriveFrame {
+  Head head;                 // per cycle fields
+  std::vector<Drive> drive;  // one record per drive
+
+  // number of drives
+  int drives() const { return (int) this->drive.size(); }
+};
+
+// function to copy a drive frame, only the first copy into an unsized frame allocates
+template <typename Head, typename Drive>
+inline void channelCopy(DriveFrame<Head, Drive> &dst, const DriveFrame<Head, Drive> &src) {
+    dst.head = src.head;
+    if (dst.drive.size() != src.drive.size()) {
+        dst.drive.resize(src.drive.size());
+    }
+    memcpy(dst.drive.data(), src.drive.data(), src.drive.size() * sizeof(Drive));
+}
+
+// per cycle fields of a state snapshot
+struct ELMOStateHead {
+  uint64 cycle;              // bus cycle counter
+  int64 timestamp;           // bus timestamp of the received frame [ns]
+};
+
+// one drive in a state snapshot, all fields of a drive next to each other
+struct DriveState {
+  int32 pos;                 // encoder joint position from ELMO
+  int32 vel;                 // encoder joint velocity from ELMO
+  uint32 inputs;             // inputs
+  int16 torque;              // torque command sent to ELMO in this cycle
+  uint16 controlword;        // control word of the motor
+  uint16 statusword;         // status word of the motor
+  uint16 stale;              // cycles since the inputs were last refreshed (saturates), 0: fresh in this cycle
+};
+
+// per cycle fields of a command
+struct ELMOCommandHead {
+  uint64 seq;                // command counter
+  int64 timestamp;           // time the command was published [ns]
+};
+
+// one drive in a command
+struct DriveCommand {
+  int16 torque;              // desried torque command from Laptop
+};
+
+// per cycle fields of a telemetry frame
+struct ELMOTelemetryHead {
+  uint64 cycle;              // bus cycle the telemetry was read in
+  int64 timestamp;           // bus timestamp of the received frame [ns]
+};
+
+// snapshot of all drives taken in one bus cycle, ELMO --> Laptop
+typedef DriveFrame<ELMOStateHead, DriveState> ELMOState;
+
+// telemetry PDO objects of all drives, published every few bus cycles, ELMO --> Laptop
+typedef DriveFrame<ELMOTelemetryHead, DriveTelemetry> ELMOTelemetry;
+
+// command for all drives published by the app, Laptop --> ELMO
+typedef DriveFrame<ELMOCommandHead, DriveCommand> ELMOCommand;
+
+//  Torque law run by the comm thread in every bus cycle, on the snapshot it just received
+class CycleController {
+
+    public:
+
+        // constructor / desctructors
+        CycleController() {};
+        virtual ~CycleController() {};
+
+        // function to size the controller for the drives found, called once before the main loop
+        virtual void init(int drives) = 0;
+
+        // function to compute the torque command of every drive from this cycle's snapshot
+        virtual const ELMOCommand &update(const ELMOState &state) = 0;
+};
+
+// flight recorder of the process data (ElmoRecorder.hpp)
+class ELMORecorder;
 
 // struct for general ELMO data
 struct ELMOData{
   uint8 OpMode;              // operation mode
   char port[1028];           // ethernet port container
-  bool motor_control_switch; // desired motor state
-  int commStatus;            // communication status
+  volatile bool motor_control_switch; // desired motor state
+  volatile int commStatus;   // communication status
   double freq;               // frequency of control loop
-  int16 torque[6];           // desried torque commands from Laptop
-  int32 pos[6];              // encoder joint position from ELMO
-  int32 vel[6];              // encoder joint velocity from ELMO
-  uint32 inputs[6];          // inputs
-  uint16 controlword[6];     // control word of each motor
-  uint16 statusword[6];      // status word of each motor
-};
-
-// struct to hold out-going data, Laptop --> ELMO
-// Torque Control (x1602)
-struct ELMOOut {
-   int16_t torque;       // "Torque Command"
-   uint16_t controlword; // "Control Word", converted to binary and use DS402 SM, 6040
-};
-
-// struct to hold in-coming data, ELMO --> Laptop
-// Pos and Vel (0x1A03)
-struct ELMOIn {
-    int32_t position;  // "Position Actual Value"
-    uint32_t inputs;   // "Digital Inputs"
-    int32_t velocity;  // "Velocity Actual Value"
-    uint16_t status;   // "Status Word", converted to binary and use DS402 SM, 6041
+  int drives;                // number of drives expected on the chain, 0 accepts any
+  CycleConfig cycle;         // cycle scheduler configuration
+  EnableConfig enable;       // drive enable sequence configuration
+  TelemetryConfig telemetry_config;  // telemetry PDO objects and decimation
+  ELMOBus *bus;              // EtherCAT chain backend (SOEM or simulated)
+  bool degraded;             // keep the drives that exchange running while others are out
+  SeqLock<ELMOState> state;          // latest drive snapshot, written by the comm thread
+  TripleBuffer<ELMOCommand> command; // latest command, written by the app
+  TripleBuffer<ELMOTelemetry> telemetry; // latest telemetry, written by the comm thread every decimation cycles
+  CycleController *controller;       // torque law run in the bus cycle, NULL uses the app's command
+  ELMORecorder *recorder;            // flight recorder fed by the comm thread, NULL records nothing
+  CycleStats stats;                  // cyclic loop timing, written by the comm thread
+  CycleWindow window;                // idle time after every cycle's frame, opened by the comm thread
+  ELMOExecutor *executor;            // starts the threads the comm thread needs (mailbox worker, chain workers)
+  ELMOMailbox mailbox;               // non-cyclic SDO access in the windows
+  ELMOHealth health;                 // bus health monitor, fed by the comm thread, checks in the windows
+  LinkStats link;                    // per drive working counter and frame loss, written by the comm thread
 };
 
 // ELMO communication function
 void *ELMOcommunication(void *data);
 
-// callback function to check for ethercat communication errors
-void *ecatcheck(void* why);
-
 #endif
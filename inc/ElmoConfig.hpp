@@ -0,0 +1,42 @@
+#ifndef ELMOCONFIG_H
+#define ELMOCONFIG_H
+
+// Standard headers
+#include <string>
+
+// Custom headers
+#include "ElmoInterface.hpp"
+#include "ElmoRecorder.hpp"
+#include "ElmoExecutor.hpp"
+#include "ElmoShm.hpp"
+#include "ElmoTrajectory.hpp"
+#include "ElmoReload.hpp"
+
+// struct for everything in config/config.yaml
+struct ELMOConfig {
+  std::string port;          // ethernet port of the chain
+  uint8 opmode;              // operation mode of the drives
+  double freq;               // [Hz] bus rate
+  int drives;                // drives expected on the chain (0 accepts any)
+  CycleConfig cycle;         // cycle scheduler
+  EnableConfig enable;       // drive enable sequence
+  int control;               // CONTROL_APP or CONTROL_CYCLE_PD
+  double app_freq;           // [Hz] app loop rate
+  InterpConfig interp;       // setpoint interpolation (CONTROL_CYCLE_PD)
+  BusConfig bus;             // EtherCAT backend
+  TelemetryConfig telemetry; // telemetry PDO objects and decimation
+  RecorderConfig recorder;   // flight recorder
+  double diag_rate;          // [Hz] drive diagnostics polls, 0 turns them off
+  ExecutorConfig realtime;   // thread scheduling and memory locking
+  ShmConfig daemon;          // bus daemon shared memory and client heartbeat
+  TrajectoryConfig trajectory; // joint references of the app loop
+  ReloadConfig reload;       // gain and limit reload while running
+  double max_time;           // [sec] max program time
+  JointGains gains;          // joint gains, joint order
+  JointLimits limits;        // joint limits, joint order
+};
+
+// function to load the configuration file, throws YAML::Exception on a missing or malformed entry
+ELMOConfig loadConfig(const std::string &file);
+
+#endif
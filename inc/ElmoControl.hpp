@@ -0,0 +1,129 @@
+#ifndef ELMOCONTROL_H
+#define ELMOCONTROL_H
+
+// Standard headers
+#include <string.h>
+#include <stdint.h>
+#include <Eigen/Dense>
+
+// number of joints driven by the low level controller
+#define NUM_JOINTS 6
+
+// one value per joint, joint order (HFL, HSL, KL, HFR, HSR, KR)
+typedef Eigen::Array<double, NUM_JOINTS, 1> JointArray;
+
+// struct for joint gains
+struct JointGains {
+  JointArray Kp;      // proportional gains
+  JointArray Kd;      // derivative gains
+  JointArray Kff;     // feedforward torque scaling
+};
+
+// struct for joint limits
+struct JointLimits {
+  JointArray q_min;   // configuration limits [rad]
+  JointArray q_max;
+  JointArray qd_min;  // velocity limits [rad/s]
+  JointArray qd_max;
+};
+
+// struct for the gains and limits swapped together while the loops run
+struct JointParams {
+  JointGains gains;
+  JointLimits limits;
+  double ramp_s;      // [sec] time the new gains are blended in over, 0 switches at once
+};
+
+/*  Gains blended linearly from the ones in use to new ones, so a gain change does not step the torque */
+struct GainRamp {
+
+  JointGains from;    // gains in use when the ramp started
+  JointGains to;      // target gains
+  JointGains gains;   // gains at the last call of at
+  int64_t t0;         // [ns] start of the ramp
+  double ramp_s;      // [sec] ramp time
+
+  // function to switch to the gains at once
+  void reset(const JointGains &target) {
+    this->from = this->to = this->gains = target;
+    this->t0 = 0;
+    this->ramp_s = 0.0;
+  }
+
+  // function to start blending from the gains in use to the target at time t [ns]
+  void start(const JointGains &target, double ramp_s, int64_t t) {
+    this->from = this->gains;
+    this->to = target;
+    this->t0 = t;
+    this->ramp_s = ramp_s;
+  }
+
+  // function to get the gains at time t [ns]
+  const JointGains &at(int64_t t) {
+    double s = (this->ramp_s > 0.0) ? (t - this->t0) * 1e-9 / this->ramp_s : 1.0;
+    s = (s < 0.0) ? 0.0 : (s > 1.0) ? 1.0 : s;
+    this->gains.Kp = this->from.Kp + s * (this->to.Kp - this->from.Kp);
+    this->gains.Kd = this->from.Kd + s * (this->to.Kd - this->from.Kd);
+    this->gains.Kff = this->from.Kff + s * (this->to.Kff - this->from.Kff);
+    return this->gains;
+  }
+};
+
+// two joints per SIMD register (SSE2 / NEON), comparisons give all-ones lanes
+typedef double JointPair __attribute__((vector_size(16)));
+typedef long long JointPairMask __attribute__((vector_size(16)));
+static_assert(NUM_JOINTS % 2 == 0, "the PD kernel processes the joints in pairs");
+
+// function to load two joints
+static inline JointPair loadPair(const double *p) {
+    JointPair v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* PD + feedforward torque of all joints in one branch-free pass
+   - the position reference is saturated to [q_min, q_max]
+   - tau = Kp (q_ref - q) + Kd (qd_ref - qd) + Kff tau_ff
+   - joints outside [q_min, q_max] get zero torque
+   same operations in the same order as the scalar code, so the torques are bit-for-bit identical
+   returns the masks (bit i = joint i) of saturated references and of joints outside their limits
+*/
+static inline void pdTorque(const JointGains &gains, const JointLimits &limits,
+                            const JointArray &q_ref, const JointArray &qd_ref,
+                            const JointArray &q, const JointArray &qd, const JointArray &tau_ff,
+                            JointArray &tau, int &saturated, int &tripped) {
+
+    const JointPair zero = {0.0, 0.0};
+    int sat = 0, trip = 0;
+
+    for (int i = 0; i < NUM_JOINTS; i += 2) {
+
+        JointPair lo = loadPair(&limits.q_min(i));
+        JointPair hi = loadPair(&limits.q_max(i));
+        JointPair r = loadPair(&q_ref(i));
+        JointPair x = loadPair(&q(i));
+
+        // bounds checks of the reference and of the joint
+        JointPairMask r_out = (r < lo) | (r > hi);
+        JointPairMask x_out = (x < lo) | (x > hi);
+
+        // saturate the reference, std::min(std::max(r, lo), hi)
+        JointPair r_sat = (r < lo) ? lo : r;
+        r_sat = (hi < r_sat) ? hi : r_sat;
+
+        // PD + feedforward, zero torque outside the limits
+        JointPair t = loadPair(&gains.Kp(i)) * (r_sat - x) 
+                    + loadPair(&gains.Kd(i)) * (loadPair(&qd_ref(i)) - loadPair(&qd(i))) 
+                    + loadPair(&gains.Kff(i)) * loadPair(&tau_ff(i));
+        t = x_out ? zero : t;
+        memcpy(&tau(i), &t, sizeof(t));
+
+        sat |= (int) ((r_out[0] & 1) | ((r_out[1] & 1) << 1)) << i;
+        trip |= (int) ((x_out[0] & 1) | ((x_out[1] & 1) << 1)) << i;
+    }
+
+    saturated = sat;
+    tripped = trip;
+}
+
+#endif
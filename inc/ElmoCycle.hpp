@@ -0,0 +1,181 @@
+#ifndef ELMOCYCLE_H
+#define ELMOCYCLE_H
+
+// Standard headers
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <atomic>
+
+// cycle scheduling modes
+#define CYCLE_BUSY_POLL    0   // legacy: spin on the clock, fire when dt >= 1/freq
+#define CYCLE_ABS_DEADLINE 1   // clock_nanosleep(TIMER_ABSTIME) on a fixed time grid
+#define CYCLE_DC_SYNC      2   // absolute deadlines steered onto the drives' distributed clock (SYNC0)
+
+// catch-up rules when one or more deadlines were missed (absolute deadline mode)
+#define CATCHUP_SKIP   0   // drop the missed cycles, stay on the original time grid
+#define CATCHUP_BURST  1   // run the missed cycles back-to-back (up to max_burst)
+#define CATCHUP_RESYNC 2   // restart the time grid one period after the late wakeup
+
+/* Order of the bus exchange within a cycle
+   - sequential: send, block for the round trip in receive, compute. The outputs computed in
+     cycle k leave with the send of cycle k+1.
+   - pipelined: receive the frame sent at the end of the previous cycle, compute, send. The frame
+     travels while the thread sleeps, so the round trip no longer blocks the cycle ("bus io").
+     The outputs leave right after they are computed, so inputs to outputs is still one period,
+     but the inputs are up to one period old when the computation sees them.
+*/
+#define PIPELINE_OFF 0   // sequential: send -> receive -> compute
+#define PIPELINE_ON  1   // pipelined: receive -> compute -> send
+
+// acyclic frames start at most this fraction of the period after the cycle's deadline
+#define CYCLE_WINDOW 0.5
+
+// struct for the cycle scheduler configuration
+struct CycleConfig {
+  int mode;          // CYCLE_BUSY_POLL, CYCLE_ABS_DEADLINE or CYCLE_DC_SYNC
+  double spin_us;    // spin this long before each deadline instead of sleeping [us]
+  int catchup;       // CATCHUP_SKIP, CATCHUP_BURST or CATCHUP_RESYNC
+  int max_burst;     // max number of back-to-back cycles in CATCHUP_BURST
+  double dc_lead_us; // frames reach the drives this long before SYNC0 (CYCLE_DC_SYNC) [us]
+  double dc_kp;      // proportional gain of the DC phase controller
+  double dc_ki;      // integral gain of the DC phase controller
+  int pipeline;      // PIPELINE_OFF or PIPELINE_ON
+};
+
+// monotonic clock in nanoseconds
+static inline int64_t cycle_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+//  A class that paces the cyclic EtherCAT loop
+class CycleScheduler {
+
+    public:
+
+        // constructor / desctructors
+        CycleScheduler() {};
+        ~CycleScheduler() {};
+
+        // function to set the loop frequency and scheduling mode
+        void init(double freq, CycleConfig config);
+
+        // function that blocks until the next cycle is due, returns the number of skipped cycles
+        int wait();
+
+        // function to shift the time grid by ns from the next deadline on
+        void adjust(int64_t ns);
+
+        // cycle counters
+        uint64_t cycles;     // number of cycles released
+        uint64_t overruns;   // number of wakeups that missed at least one full period
+        uint64_t skipped;    // number of cycles dropped by the catch-up rule
+
+        // timing of the last released cycle [ns]
+        int64_t deadline_ns; // scheduled release time
+        int64_t wakeup_ns;   // actual release time
+
+    private:
+
+        // scheduler configuration
+        CycleConfig config;
+
+        // cycle period and spin window [ns]
+        int64_t period_ns;
+        int64_t spin_ns;
+
+        // time of the next deadline [ns]
+        int64_t next_ns;
+
+        // remaining back-to-back cycles allowed in burst catch-up
+        int burst_left;
+
+        // one wait for each scheduling mode
+        int waitBusyPoll();
+        int waitDeadline();
+};
+
+//  A PI controller that keeps the master wakeup at a fixed phase of the distributed clock
+class DCSync {
+
+    public:
+
+        // constructor / desctructors
+        DCSync() {};
+        ~DCSync() {};
+
+        // function to set the loop frequency and controller gains
+        void init(double freq, CycleConfig config);
+
+        // function to update the controller with the DC time of the last frame, returns the wakeup correction [ns]
+        int64_t update(int64_t dc_time);
+
+        // phase error of the last frame: DC time relative to (SYNC0 - lead) [ns]
+        int64_t offset_ns;
+
+        // master clock drift relative to the DC reference clock, from the integrator [ppm]
+        double drift_ppm;
+
+    private:
+
+        // cycle period, SYNC0 lead and the largest correction per cycle [ns]
+        int64_t period_ns;
+        int64_t lead_ns;
+        int64_t max_step_ns;
+
+        // controller gains and integrator
+        double kp;
+        double ki;
+        double integral;
+};
+
+/*  Idle time on the wire after every cycle's frame, shared by the threads with acyclic frames
+    - the comm thread opens the window of each cycle once its process data frame is out
+    - the mailbox and the health monitor only start a transfer in a fresh window and only in its first part,
+      so their frames follow the cycle's frame on the wire instead of going out right before the next one
+*/
+class CycleWindow {
+
+    public:
+
+        // constructor / desctructors
+        CycleWindow() : close(0), window_ns(0) {};
+        ~CycleWindow() {};
+
+        // function to set the window to fraction of the period, before the comm thread opens any
+        void init(double freq, double fraction) {
+            this->window_ns = (int64_t) (fraction * 1e9 / freq);
+        }
+
+        // function to open the window of the cycle released at deadline_ns, comm thread only, never blocks
+        void open(int64_t deadline_ns) {
+            this->close.store(deadline_ns + this->window_ns, std::memory_order_release);
+        }
+
+        // function to wait for a window newer than last_close, polling every poll_us, false once running is false
+        bool wait(int64_t &last_close, const std::atomic<bool> &running, int poll_us) const {
+            while (running.load(std::memory_order_relaxed)) {
+                int64_t close = this->close.load(std::memory_order_acquire);
+                if (close > last_close && cycle_now_ns() < close) {
+                    last_close = close;
+                    return true;
+                }
+                usleep(poll_us);
+            }
+            return false;
+        }
+
+    private:
+
+        // close of the newest window [ns]
+        std::atomic<int64_t> close;
+
+        // window length [ns]
+        int64_t window_ns;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef ELMODS402_H
+#define ELMODS402_H
+
+/* DS402 drive state machine engine (shared by the C++ library and the Simulink S-function)
+ * -------------------
+ * refer to DS-402 document from ELMO
+ * - the state is decoded from status word bits 0,1,2,3,5,6 through a 64 entry lookup table
+ * - each entry holds the control word that moves the drive towards OPERATION ENABLED
+ *   (SOD -> 6, RSO -> 7, SO -> 15, ARMED -> 15) and whether torque may be applied
+ * - the table is built from constant expressions, so it is fixed at compile time in C and C++
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+#define DS402_CONST constexpr
+extern "C" {
+#else
+#define DS402_CONST const
+#endif
+
+/* drive states, in the order the status word is tested */
+#define DS402_NOT_READY          0  /* not ready to switch on */
+#define DS402_SWITCH_ON_DISABLED 1  /* switch on disabled (SOD) */
+#define DS402_READY_SWITCH_ON    2  /* ready to switch on (RSO) */
+#define DS402_SWITCHED_ON        3  /* switched on (SO) */
+#define DS402_OP_ENABLED         4  /* operation enabled (ARMED) */
+#define DS402_QUICK_STOP         5  /* quick stop active */
+#define DS402_FAULT_REACTION     6  /* fault reaction active */
+#define DS402_FAULT              7  /* fault */
+#define DS402_UNKNOWN            8  /* status word matches no state */
+#define DS402_NUM_STATES         9
+
+/* one table entry */
+typedef struct {
+    uint8_t state;          /* DS402_* state */
+    uint8_t enable;         /* 1 if torque may be applied */
+    uint16_t controlword;   /* next control word */
+} ds402_entry_t;
+
+/* table key: status word bits 0..3 in key bits 0..3, bit 5 in key bit 4, bit 6 in key bit 5 */
+#define DS402_KEY(sw) ((uint8_t) (((sw) & 0x0F) | (((sw) & 0x60) >> 1)))
+
+/* status word bit n of a table key */
+#define DS402_SW0(k) (((k) >> 0) & 1)
+#define DS402_SW1(k) (((k) >> 1) & 1)
+#define DS402_SW2(k) (((k) >> 2) & 1)
+#define DS402_SW3(k) (((k) >> 3) & 1)
+#define DS402_SW5(k) (((k) >> 4) & 1)
+#define DS402_SW6(k) (((k) >> 5) & 1)
+
+/* state decoded from a table key, same tests and order as the original if-chain */
+#define DS402_DECODE(k) ( \
+    (!DS402_SW0(k) && !DS402_SW1(k) && !DS402_SW2(k) && !DS402_SW3(k) && !DS402_SW6(k)) ? DS402_NOT_READY : \
+    (!DS402_SW0(k) && !DS402_SW1(k) && !DS402_SW2(k) && !DS402_SW3(k) &&  DS402_SW6(k)) ? DS402_SWITCH_ON_DISABLED : \
+    ( DS402_SW0(k) && !DS402_SW1(k) && !DS402_SW2(k) && !DS402_SW3(k) &&  DS402_SW5(k) && !DS402_SW6(k)) ? DS402_READY_SWITCH_ON : \
+    ( DS402_SW0(k) &&  DS402_SW1(k) && !DS402_SW2(k) && !DS402_SW3(k) &&  DS402_SW5(k) && !DS402_SW6(k)) ? DS402_SWITCHED_ON : \
+    ( DS402_SW0(k) &&  DS402_SW1(k) &&  DS402_SW2(k) && !DS402_SW3(k) &&  DS402_SW5(k) && !DS402_SW6(k)) ? DS402_OP_ENABLED : \
+    ( DS402_SW0(k) &&  DS402_SW1(k) &&  DS402_SW2(k) && !DS402_SW3(k) && !DS402_SW5(k) && !DS402_SW6(k)) ? DS402_QUICK_STOP : \
+    ( DS402_SW0(k) &&  DS402_SW1(k) &&  DS402_SW2(k) &&  DS402_SW3(k) && !DS402_SW6(k)) ? DS402_FAULT_REACTION : \
+    (!DS402_SW0(k) && !DS402_SW1(k) && !DS402_SW2(k) &&  DS402_SW3(k) && !DS402_SW6(k)) ? DS402_FAULT : \
+    DS402_UNKNOWN)
+
+/* control word sent in each state */
+#define DS402_CONTROLWORD(s) ( \
+    ((s) == DS402_SWITCH_ON_DISABLED) ? 0x06 : \
+    ((s) == DS402_READY_SWITCH_ON)    ? 0x07 : \
+    ((s) == DS402_SWITCHED_ON)        ? 0x0F : \
+    ((s) == DS402_OP_ENABLED)         ? 0x0F : 0x00)
+
+/* table rows */
+#define DS402_ENTRY(k)  { DS402_DECODE(k), DS402_DECODE(k) == DS402_OP_ENABLED, DS402_CONTROLWORD(DS402_DECODE(k)) }
+#define DS402_ROW4(k)   DS402_ENTRY(k), DS402_ENTRY(k + 1), DS402_ENTRY(k + 2), DS402_ENTRY(k + 3)
+#define DS402_ROW16(k)  DS402_ROW4(k), DS402_ROW4(k + 4), DS402_ROW4(k + 8), DS402_ROW4(k + 12)
+
+/* lookup table, indexed by DS402_KEY(status word) */
+static DS402_CONST ds402_entry_t ds402_table[64] = {
+    DS402_ROW16(0), DS402_ROW16(16), DS402_ROW16(32), DS402_ROW16(48)
+};
+
+/* decode one status word */
+static inline const ds402_entry_t *ds402_lookup(uint16_t statusword) {
+    return &ds402_table[DS402_KEY(statusword)];
+}
+
+/* printable name of a DS402_* state */
+const char *ds402_state_name(int state);
+
+#ifdef __cplusplus
+}
+
+/* the table is evaluated by the compiler */
+static_assert(ds402_table[DS402_KEY(0x0250)].controlword == 0x06, "SOD must send shutdown");
+static_assert(ds402_table[DS402_KEY(0x0231)].controlword == 0x07, "RSO must send switch on");
+static_assert(ds402_table[DS402_KEY(0x0233)].controlword == 0x0F, "SO must send enable operation");
+static_assert(ds402_table[DS402_KEY(0x0237)].enable == 1, "ARMED must enable torque");
+static_assert(ds402_table[DS402_KEY(0x0218)].state == DS402_FAULT, "0x218 is a fault");
+#endif
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef ELMOEXECUTOR_H
+#define ELMOEXECUTOR_H
+
+// Standard headers
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <mutex>
+
+// thread roles
+#define ROLE_BUS    0   // EtherCAT cycle (ELMOcommunication)
+#define ROLE_CHECK  1   // bus health monitor, drive state check and recovery (ELMOHealth)
+#define ROLE_LOGGER 2   // log writer
+#define ROLE_APP    3   // application loop (main thread)
+#define ROLE_COUNT  4
+
+// max threads started or adopted by one executor
+#define EXECUTOR_MAX_THREADS 16
+
+// core of a started thread taken from its role
+#define CPU_ROLE -2
+
+// struct for the scheduling of one thread role
+struct ThreadConfig {
+  int policy;                // SCHED_FIFO, SCHED_RR or SCHED_OTHER
+  int priority;              // real-time priority (SCHED_FIFO / SCHED_RR), 0 otherwise
+  int cpu;                   // core the thread is pinned to, -1 leaves it free
+};
+
+// struct for the executor configuration
+struct ExecutorConfig {
+  bool lock_memory;                  // mlockall the process and keep freed heap in the process
+  int prefault_stack_kb;             // [kB] stack touched by every thread before it starts its work
+  int prefault_heap_mb;              // [MB] heap touched at startup
+  ThreadConfig role[ROLE_COUNT];     // scheduling of every role
+};
+
+// page faults and context switches of a thread
+struct ThreadUsage {
+  long minflt;               // minor page faults
+  long majflt;               // major page faults
+  long nvcsw;                // voluntary context switches
+  long nivcsw;               // involuntary context switches
+};
+
+// function to parse a scheduling policy name ("fifo", "rr", "other")
+int schedPolicy(const char *name);
+
+/*  Creates, configures and joins the threads of the process
+    - every thread takes a role whose policy, priority and core come from the configuration
+    - threads touch their stack before they run, so the loops do not fault it in later
+    - page faults and context switches are counted from the moment a thread starts its work to the moment
+      it returns (started threads) or the report (adopted threads)
+    - a real-time policy the process may not use (no privileges) falls back to default scheduling
+*/
+class ELMOExecutor {
+
+    public:
+
+        // constructor / desctructors
+        ELMOExecutor(ExecutorConfig config);
+        ~ELMOExecutor() { this->joinAll(); };
+
+        // function to lock the process memory and prefault the heap, call once at startup
+        bool lockMemory();
+
+        // function to start a thread in a role, returns its handle (-1 on failure). cpu overrides the core of
+        // the role (e.g. one per chain worker), any thread may start threads
+        int spawn(int role, const char *name, void *(*fn)(void *), void *arg, int cpu = CPU_ROLE);
+
+        // function to give the calling thread a role (e.g. the app loop in main), returns its handle
+        int adopt(int role, const char *name);
+
+        // function to wait for a started thread to return
+        bool join(int handle);
+
+        // function to wait for every started thread, last started first
+        void joinAll();
+
+        // function to get the kernel thread id of a thread by name, 0 until it started
+        pid_t threadId(const char *name);
+
+        // function to print the scheduling, page faults and context switches of every thread
+        void report();
+
+    private:
+
+        // one started or adopted thread
+        struct Thread {
+          ELMOExecutor *executor;    // owner
+          char name[16];             // thread name (15 characters)
+          int role;                  // ROLE_*
+          int policy;                // policy the thread runs with
+          int cpu;                   // core the thread is pinned to, -1 free
+          void *(*fn)(void *);       // thread function and its argument (started threads)
+          void *arg;
+          pthread_t thread;
+          std::atomic<pid_t> tid;    // kernel thread id, set by the thread itself
+          bool adopted;              // the calling thread of adopt, never joined
+          bool joined;
+          ThreadUsage start;         // usage when the work started
+          ThreadUsage end;           // usage when the work returned
+          std::atomic<bool> done;    // the work returned
+        };
+
+        // configuration
+        ExecutorConfig config;
+
+        // threads, fixed storage so the started threads can keep a pointer to their slot
+        Thread threads[EXECUTOR_MAX_THREADS];
+        int count;
+
+        // taken while a slot is handed out, threads are also started from other threads (chain workers, mailbox)
+        std::mutex lock;
+
+        // function to set the core and name of the calling thread and prefault its stack
+        void configure(Thread &t);
+
+        // function to read the usage of the calling thread
+        static ThreadUsage usage();
+
+        // thread entry: configure, run the work, record the usage
+        static void *trampoline(void *thread);
+};
+
+#endif
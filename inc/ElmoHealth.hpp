@@ -0,0 +1,270 @@
+#ifndef ELMOHEALTH_H
+#define ELMOHEALTH_H
+
+// Standard headers
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+// Custom headers
+#include "ElmoBus.hpp"
+#include "ElmoCycle.hpp"
+#include "ElmoChannel.hpp"
+#include "ElmoStats.hpp"
+
+// health monitor sizing
+#define HEALTH_QUEUE    256   // max events waiting for the monitor
+#define HEALTH_IDLE_MS  100   // monitor sleep while the bus is healthy [ms]
+#define HEALTH_RETRY_MS 10    // time between state checks while a drive is being brought back [ms]
+#define HEALTH_POLL_US  50    // monitor sleep while it waits for a window [us]
+
+// rolling loss rates over LINK_WINDOW_S, moved on in LINK_BUCKETS steps
+#define LINK_WINDOW_S 1.0
+#define LINK_BUCKETS  10
+
+// events posted by the comm thread
+#define HEALTH_WKC_LOW       0   // working counter dropped below the expected one
+#define HEALTH_WKC_OK        1   // working counter back to the expected one
+#define HEALTH_DRIVE_FAULT   2   // drive entered DS402 FAULT
+#define HEALTH_DRIVE_ENABLED 3   // drive reached OPERATION ENABLED in a complete exchange
+
+// one event, posted in the cycle it was seen in
+struct HealthEvent {
+  int type;                  // HEALTH_*
+  int drive;                 // drive index (0-indexed, bus order), -1 for the whole bus
+  uint64 cycle;              // bus cycle
+  int64 t;                   // receive time of the cycle's frame [ns]
+  int value;                 // working counter (HEALTH_WKC_*)
+};
+
+// health metrics of one drive
+struct DriveHealthSummary {
+  uint64_t dropouts;         // times the drive was found out of OPERATIONAL
+  uint64_t faults;           // times the drive entered DS402 FAULT on its own
+  TimingSummary detect;      // anomaly seen by the cycle -> drive named by the monitor
+  TimingSummary recover;     // anomaly seen by the cycle -> drive OPERATIONAL and OPERATION ENABLED again
+};
+
+// frame loss of one drive
+struct DriveLinkSummary {
+  uint64_t lost;             // cycles the drive's inputs were not refreshed
+  double loss_rate;          // fraction of the last LINK_WINDOW_S of cycles lost
+  uint64_t bursts;           // runs of consecutive lost cycles
+  uint64_t burst_max;        // longest run [cycles]
+  uint64_t burst;            // current run [cycles], 0 while the drive exchanges
+  uint64_t degraded;         // cycles the other drives ran on while this one was held at zero torque
+};
+
+// frame loss of the whole bus
+struct LinkStatsSummary {
+  uint64_t cycles;           // exchanges
+  uint64_t frames_lost;      // no frame came back (working counter 0)
+  uint64_t partial;          // frames with a low working counter
+  uint64_t degraded;         // partial frames the drives that exchanged ran on
+  uint64_t unattributed;     // partial frames the loss could not be put on named drives, no drive was updated
+  double loss_rate;          // fraction of the last LINK_WINDOW_S of frames lost or partial
+};
+
+/*  Per drive working counter and frame loss accounting, written by the comm thread in every cycle
+    - a lost frame counts against every drive, a partial one against the drives it was put on
+    - counters and the rolling loss rates are readable from any thread, for alerting while running
+*/
+class LinkStats {
+
+    public:
+
+        // constructor / desctructors
+        LinkStats();
+        ~LinkStats() {};
+
+        // function to size the counters for the drives found at the bus rate, before the comm thread updates them
+        void init(int drives, double freq);
+
+        // function to account one exchange, lost[j] != 0 for the drives whose inputs were not refreshed. degraded:
+        // the drives that exchanged ran on (comm thread only, never allocates)
+        void update(int wkc, int expected, bool degraded, const char *lost);
+
+        // function to get the counters of drive i (all zero for a drive not on the bus) / of the bus
+        DriveLinkSummary drive(int i) const;
+        LinkStatsSummary summary() const;
+
+        // number of drives counted
+        int drives() const { return this->count.load(std::memory_order_acquire); };
+
+        // function to print the counters of the bus and of the drives that lost cycles
+        void print() const;
+
+    private:
+
+        // rolling window: lost cycles of each bucket, oldest one dropped when the window moves
+        struct Window {
+          uint32_t bucket[LINK_BUCKETS];
+          std::atomic<uint64_t> total;
+        };
+
+        // counters of one drive
+        struct DriveLink {
+          std::atomic<uint64_t> lost;
+          std::atomic<uint64_t> bursts;
+          std::atomic<uint64_t> burst_max;
+          std::atomic<uint64_t> burst;
+          std::atomic<uint64_t> degraded;
+          Window window;
+        };
+
+        // drives, allocated by init, count published once they are
+        std::atomic<int> count;
+        std::unique_ptr<DriveLink[]> link;
+
+        // bus counters, cycles and lost or partial frames of the window
+        std::atomic<uint64_t> cycles;
+        std::atomic<uint64_t> frames_lost;
+        std::atomic<uint64_t> partial;
+        std::atomic<uint64_t> degraded;
+        std::atomic<uint64_t> unattributed;
+        Window window_cycles;
+        Window window_loss;
+
+        // cycles per bucket, cycles in the current bucket and its index
+        uint32_t bucket_cycles;
+        uint32_t in_bucket;
+        int current;
+
+        // single writer increments
+        static inline void bump(std::atomic<uint64_t> &c, uint64_t v) {
+            c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        }
+        static inline void add(Window &w, int bucket, uint32_t v) {
+            w.bucket[bucket] += v;
+            bump(w.total, v);
+        }
+        static inline void drop(Window &w, int bucket) {
+            w.total.store(w.total.load(std::memory_order_relaxed) - w.bucket[bucket], std::memory_order_relaxed);
+            w.bucket[bucket] = 0;
+        }
+};
+
+/*  Bus health monitor, off the critical path of the bus cycle
+    - the comm thread only posts events (working counter drops, DS402 faults) into a lock-free ring and
+      wakes the monitor, it never waits on it
+    - the monitor sleeps until an event comes in. While the working counter is low or a drive is down it
+      reads the drive states and brings them back (ack SAFE_OP + ERROR, request OPERATIONAL, reconfigure or
+      recover lost drives) every HEALTH_RETRY_MS, each time in a window of the comm thread (CycleWindow) so
+      its frames follow the cycle's frame on the wire instead of colliding with the next one
+    - per drive it measures the time from the cycle that saw the anomaly to the drive being named
+      (detect) and to it being OPERATIONAL and OPERATION ENABLED again (recover)
+*/
+class ELMOHealth {
+
+    public:
+
+        // constructor / desctructors
+        ELMOHealth();
+        ~ELMOHealth() {};
+
+        // function to start monitoring an open bus, called by the comm thread before its main loop
+        void start(ELMOBus *bus, const CycleWindow *window, int drives);
+
+        // function to stop monitoring, returns once the monitor is off the bus. Called by the comm thread
+        // before the bus is closed, the monitor thread exits after it
+        void stop();
+
+        // function to post an event, comm thread only, never blocks or allocates
+        inline void post(int type, int drive, uint64 cycle, int64 t, int value) {
+            HealthEvent event = {type, drive, cycle, t, value};
+            if (!this->events.push(event)) {
+                this->dropped.store(this->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return;
+            }
+            this->signal.fetch_add(1, std::memory_order_seq_cst);
+            if (this->sleepers.load(std::memory_order_seq_cst) > 0) {
+                syscall(SYS_futex, &this->signal, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+            }
+        }
+
+        // function to tell whether the last state check found drive i out of OPERATIONAL (any thread)
+        bool down(int i) const { return this->named[i].load(std::memory_order_relaxed) != DRIVE_OK; };
+
+        // function to get the time the last state check started [ns], 0 before the first one. down() reflects
+        // the drive states read after it (any thread)
+        int64 checked() const { return this->t_checked.load(std::memory_order_acquire); };
+
+        // function to get the metrics of drive i, valid once the monitor has started
+        DriveHealthSummary summary(int i) const;
+
+        // number of drives monitored
+        int drives() const { return this->count; };
+
+        // function to print the metrics of the drives that had an anomaly
+        void print() const;
+
+        // monitor thread, arg is the ELMOHealth
+        static void *monitorThread(void *health);
+
+    private:
+
+        // per drive state and metrics, written by the monitor only
+        struct DriveHealth {
+          uint8 state;               // DRIVE_* seen by the last state check
+          bool episode;              // anomaly not recovered yet
+          bool enabled;              // OPERATION ENABLED since the anomaly
+          int64 t_onset;             // cycle time the anomaly was seen [ns]
+          int64 t_ok;                // time the state check found the drive OPERATIONAL again, 0 if it never left [ns]
+          int64 t_enabled;           // cycle time the drive was OPERATION ENABLED again [ns]
+          std::atomic<uint64_t> dropouts;
+          std::atomic<uint64_t> faults;
+          LatencyHistogram detect;
+          LatencyHistogram recover;
+        };
+
+        // events from the comm thread, futex word bumped with every event and number of waiters on it
+        SpscRing<HealthEvent> events;
+        std::atomic<uint32_t> signal;
+        std::atomic<int> sleepers;
+        std::atomic<uint64_t> dropped;
+
+        // bus and the windows of the comm thread
+        ELMOBus *bus;
+        const CycleWindow *window;
+        int count;
+
+        // true between start and stop, done once stopped, and while the monitor is on the bus
+        std::atomic<bool> running;
+        std::atomic<bool> done;
+        std::atomic<bool> busy;
+
+        // per drive state and the health array filled by the state check, allocated by start
+        std::unique_ptr<DriveHealth[]> drive;
+        std::unique_ptr<uint8[]> health;
+
+        // drives the last state check found out of OPERATIONAL and the time it started, read by the comm thread
+        // to attribute losses
+        std::unique_ptr<std::atomic<uint8>[]> named;
+        std::atomic<int64> t_checked;
+
+        // working counter: low since the cycle time t_wkc_low, drops and the time until it was back
+        bool wkc_low;
+        int64 t_wkc_low;
+        std::atomic<uint64_t> wkc_drops;
+        LatencyHistogram wkc_recover;
+
+        // function to apply one event
+        void apply(const HealthEvent &event);
+
+        // function to read the drive states in a window and bring the drives back, true while any is down
+        bool check();
+
+        // function to close the anomaly of drive i once it is back
+        void settle(int i);
+
+        // function to sleep until an event comes in or timeout_ms pass
+        void sleep(uint32_t seen, int timeout_ms);
+};
+
+#endif
@@ -3,6 +3,11 @@
 
 // we will also use the ELMO communication header
 #include "ElmoComm.hpp"
+#include "ElmoRecorder.hpp"
+#include "ElmoExecutor.hpp"
+#include "ElmoJointMap.hpp"
+#include "ElmoControl.hpp"
+#include "ElmoSetpoint.hpp"
 
 // standard headers
 #include <Eigen/Dense>
@@ -12,82 +17,103 @@
 #define HIP_GR 30.0   // gear ratio for the hip actuators
 #define KNEE_GR 50.0  // gear ratio for the knee actuators
 
-// actuator conversion factors
-#define HIP_CONVERSION 2*M_PI/CPR/HIP_GR
-#define KNEE_CONVERSION 2*M_PI/CPR/KNEE_GR
-
-// struct for joint gains
-struct JointGains {
-
-    // proportional gains
-    double Kp_HFL;
-    double Kp_HSL;
-    double Kp_KL;
-    double Kp_HFR;
-    double Kp_HSR;
-    double Kp_KR;
-
-    // derivative gains
-    double Kd_HFL;
-    double Kd_HSL;
-    double Kd_KL;
-    double Kd_HFR;
-    double Kd_HSR;
-    double Kd_KR;
-
-    // feedforward torque scaling
-    double Kff_HFL;
-    double Kff_HSL;
-    double Kff_KL;
-    double Kff_HFR;
-    double Kff_HSR;
-    double Kff_KR;
+// joints in joint order and the place of their drive on the daisy chain
+struct LegJoints {
+  static constexpr int N = 6;
+  static constexpr JointTable<N> table() {
+    return {{
+      {0, HIP_GR,  CPR, 1.0},   // (HFL) Hip Frontal Left
+      {1, HIP_GR,  CPR, 1.0},   // (HSL) Hip Sagittal Left
+      {3, KNEE_GR, CPR, 1.0},   // (KL) Knee Left
+      {4, HIP_GR,  CPR, 1.0},   // (HFR) Hip Frontal Right
+      {2, HIP_GR,  CPR, 1.0},   // (HSR) Hip Sagittal Right
+      {5, KNEE_GR, CPR, 1.0}    // (KR) Knee Right
+    }};
+  }
 };
 
-// struct for joint gains
-struct JointLimits {
-
-    // Hip Frontal Left (HFL)
-    double q_max_HFL; 
-    double q_min_HFL;
-    double qd_max_HFL; 
-    double qd_min_HFL;
-
-    // Hip Sagittal Left (HSL)
-    double q_max_HSL; 
-    double q_min_HSL;
-    double qd_max_HSL;
-    double qd_min_HSL;
-
-    // Knee Left (KL)
-    double q_max_KL;  
-    double q_min_KL;
-    double qd_max_KL;
-    double qd_min_KL;
-
-    // Hip Frontal Right (HFR)
-    double q_max_HFR; 
-    double q_min_HFR;
-    double qd_max_HFR;
-    double qd_min_HFR;
-
-    // Hip Sagittal Right (HSR)
-    double q_max_HSR; 
-    double q_min_HSR;
-    double qd_max_HSR;
-    double qd_min_HSR;
-
-    // Knee Right (KR)
-    double q_max_KR;  
-    double q_min_KR;
-    double qd_max_KR;
-    double qd_min_KR;
-};
+// reorder and conversion kernels of the legs
+typedef JointMap<LegJoints> LegJointMap;
+
+// the low level controller runs on the joints of the map
+static_assert(LegJointMap::N == NUM_JOINTS, "the joint map and the PD kernel need the same number of joints");
 
 // variable for joint data
-typedef Eigen::Matrix< double, 12, 1> JointVec;    // vector for joint state
-typedef Eigen::Matrix< double, 6, 1> JointTorque;  // vector for feedforward torque
-typedef Eigen::Matrix< double, 18, 1> ELMOStatus;   // status of each motor controller
+typedef Eigen::Matrix< double, 2 * LegJointMap::N, 1> JointVec;    // vector for joint state
+typedef Eigen::Matrix< double, LegJointMap::N, 1> JointTorque;     // vector for feedforward torque
+typedef Eigen::Matrix< double, 3 * LegJointMap::N, 1> ELMOStatus;  // status of each motor controller
+
+// joint names in joint order, as in the config file and the warnings
+static constexpr const char *JOINT_NAMES[LegJointMap::N] = {"HFL", "HSL", "KL", "HFR", "HSR", "KR"};
+
+// functions to get the reordered status / converted encoder data / torques of the joints out of a drive snapshot
+ELMOStatus jointStatus(const ELMOState &state);
+JointVec jointEncoders(const ELMOState &state);
+JointTorque jointTorques(const ELMOState &state);
+
+// function to compute the PD + feedforward torques of the joints, with the joints whose reference was
+// saturated / that are outside their limits (bit masks)
+JointTorque jointPD(const JointGains &gains, const JointLimits &limits, const JointVec &joint_ref,
+                    const JointTorque &tau_ff, const JointVec &joint_data, int &saturated, int &tripped);
+
+// function to warn about the joints that just went out of bounds and keep the new masks, returns the joints
+// that just tripped
+int reportJoints(int saturated, int tripped, int &ref_saturated, int &joint_tripped);
+
+// readers of the gains and limits swapped while the loops run
+#define PARAM_READER_APP 0   // app loop (computeTorque, sendSetpoint)
+#define PARAM_READER_BUS 1   // comm thread (in-cycle PD law)
+#define PARAM_READERS    2
+typedef RcuCell<JointParams, PARAM_READERS> JointParamCell;
+
+// where the joint torques are computed
+#define CONTROL_APP      0   // by the app (computeTorque), streamed to the bus with sendTorque
+#define CONTROL_CYCLE_PD 1   // by the comm thread in every bus cycle, the app streams setpoints (sendSetpoint)
+
+//  Joint PD + feedforward law run by the comm thread on the freshly received encoders,
+//  with the streamed setpoints interpolated to the bus rate
+class ELMOJointPD : public CycleController {
+
+    public:
+
+        // constructor / desctructors
+        ELMOJointPD(JointLimits limits, InterpConfig interp);
+        ~ELMOJointPD() {};
+
+        // CycleController interface
+        void init(int drives);
+        const ELMOCommand &update(const ELMOState &state);
+
+        // function to take the limits from swapped parameters, picked up at the start of every cycle
+        void setParams(JointParamCell *params) { this->params = params; };
+
+        // newest setpoint, written by the app
+        TripleBuffer<JointSetpoint> setpoint;
+
+        // joints whose reference was saturated / that were outside their limits in the last cycle (bit masks)
+        std::atomic<int> saturated;
+        std::atomic<int> tripped;
+
+        // bus cycles with interpolated, extrapolated and fallback (expired) references
+        std::atomic<uint64> interpolated;
+        std::atomic<uint64> extrapolated;
+        std::atomic<uint64> expired;
+
+    private:
+
+        // joint limits, and the swapped parameters they come from (NULL: fixed)
+        JointLimits limits;
+        JointParamCell *params = NULL;
+
+        // resamples the setpoints at the bus rate
+        SetpointInterpolator interp;
+
+        // torque command of every drive, daisy chain order
+        ELMOCommand command;
+};
+
+// allocated with new by initELMO, the setpoint channel keeps its cache line only with aligned new (C++17)
+static_assert(alignof(ELMOJointPD) >= CACHE_LINE, "ELMOJointPD must keep the setpoint channel cache line aligned");
 
 //  A class that enables communication between the computer and motor controllers
 class ELMOInterface {
@@ -98,35 +124,167 @@ class ELMOInterface {
         ELMOInterface() {};
         ~ELMOInterface() {};
 
-        // function to initialize/shutdown ELMO
-        void initELMO(uint8 opmode, double freq, char* port, pthread_t thread1, pthread_t thread2);
+        // function to initialize/shutdown ELMO, the comm and health monitor threads are started and joined by the executor
+        void initELMO(uint8 opmode, double freq, char* port, ELMOExecutor &executor);
         void shutdownELMO();
 
         // function to set the low level gains and limits
         void setGains(JointGains gains);
         void setLimits(JointLimits limits);
 
+        // function to swap the gains and limits while the loops run (one writer at a time), the app and comm
+        // threads pick them up at their next tick / cycle, the gains are blended in over params.ramp_s.
+        // false while the previous swap is still in use, try again later
+        bool setParams(const JointParams &params);
+
+        // function to set the cyclic loop scheduling mode
+        void setCycleConfig(CycleConfig cycle);
+
+        // function to set the drive enable sequence (SDO or PDO)
+        void setEnableConfig(EnableConfig enable);
+
+        // function to select the EtherCAT backend (real drives or simulated)
+        void setBusConfig(BusConfig bus);
+
+        // function to run an external torque law in every bus cycle (e.g. the shared memory bridge of the bus
+        // daemon) instead of the app's commands, takes precedence over the control mode
+        void setCycleController(CycleController *controller);
+
+        // function to set how streamed setpoints are interpolated to the bus rate (CONTROL_CYCLE_PD)
+        void setInterpConfig(InterpConfig interp);
+
+        // function to set the number of drives expected on the chain (0 accepts any)
+        void setDriveCount(int drives);
+
+        // function to set the telemetry PDO objects and how often they are handed to the app
+        void setTelemetryConfig(TelemetryConfig telemetry);
+
+        // function to set the flight recorder (window, post event time, output directory)
+        void setRecorderConfig(RecorderConfig recorder);
+
+        // function to freeze the flight recorder and write the last seconds of process data
+        void triggerRecorder();
+
+        // function to get the cyclic loop timing statistics
+        CycleStatsSummary getCycleStats();
+        void printCycleStats();
+
+        // function to get the bus health metrics of drive i (dropouts, faults, time to detect and to recover)
+        DriveHealthSummary getHealthStats(int drive);
+
+        // function to get the frame loss counters of the bus / of drive i (lost cycles, rolling loss rate, bursts),
+        // any thread while the loop runs. Empty for i outside 0 .. getDriveCount() - 1
+        LinkStatsSummary getLinkStats();
+        DriveLinkSummary getLinkStats(int drive);
+
+        // function to get a consistent snapshot of all drives, valid until the next read
+        const ELMOState &getState();
+
+        // number of drives on the chain
+        int getDriveCount() { return this->snapshot.drives(); };
+
+        // function to get the newest telemetry of all drives (daisy chain order), no copy is made,
+        // valid until the next call. head.cycle tells whether it changed since the last call
+        const ELMOTelemetry &getTelemetry();
+
         // function to get teh ELMO status
         ELMOStatus getELMOStatus();
 
         // function to get encoder data
         JointVec getEncoderData();
 
+        // function to select where the joint torques are computed (CONTROL_APP or CONTROL_CYCLE_PD)
+        void setControlMode(int mode);
+
         // functions to compute and send target torque to the ELMO
         JointTorque computeTorque(JointVec joint_ref, 
                                   JointTorque tau_ff);
         void sendTorque(JointTorque torque);
 
+        // function to stream a setpoint to the in-cycle PD law (CONTROL_CYCLE_PD), uses the current gains. Refused
+        // in CONTROL_APP mode or with an external controller set
+        void sendSetpoint(JointVec joint_ref, JointTorque tau_ff);
+
+        // function to get the torques sent to the drives in the newest snapshot
+        JointTorque getTorque();
+
+        // functions to read / write an object of a drive (bus order) while the loop runs, carried out by the
+        // mailbox worker between bus cycles and completed through a future or a callback on the worker thread
+        std::future<SdoResult> sdoRead(int drive, uint16 index, uint8 subindex);
+        std::future<SdoResult> sdoWrite(int drive, uint16 index, uint8 subindex, int size, uint32 value);
+        bool sdoRead(int drive, uint16 index, uint8 subindex, SdoCallback done);
+        bool sdoWrite(int drive, uint16 index, uint8 subindex, int size, uint32 value, SdoCallback done);
+
+        // function to get the joints whose reference was saturated / that are outside their limits (bit masks)
+        int getSaturatedJoints() { return this->ref_saturated; };
+        int getTrippedJoints() { return this->joint_tripped; };
+
     private:
 
         // struct to hold ELMO data
         struct ELMOData *data;
 
+        // executor running the comm and health monitor threads, and their handles
+        ELMOExecutor *executor = NULL;
+        int bus_thread = -1;
+        int check_thread = -1;
+
+        // number of torque commands / setpoints published
+        uint64 command_seq = 0;
+
+        // where the joint torques are computed
+        int control_mode = CONTROL_APP;
+
+        // in-cycle PD law (CONTROL_CYCLE_PD)
+        ELMOJointPD *pd = NULL;
+
+        // external torque law run in the bus cycle, NULL when there is none
+        CycleController *controller = NULL;
+
+        // flight recorder fed by the comm thread
+        ELMORecorder *recorder = NULL;
+
+        // newest drive snapshot, sized once in initELMO so reading it does not allocate
+        ELMOState snapshot;
+
+        // number of drives expected on the chain, 0 accepts any
+        int drives = 0;
+
         // struct to hold the joint gains
         JointGains gains;
 
         //struct to hold the joint limits
         JointLimits limits;
+
+        // gains and limits swapped while the loops run, the copy the app tick uses and its gain ramp
+        JointParamCell params;
+        const JointParams *active = NULL;
+        GainRamp ramp;
+
+        // function to pick up swapped gains and limits at the start of an app tick
+        void updateParams();
+
+        // joints whose reference was saturated / that were outside their limits in the last tick (bit masks)
+        int ref_saturated = 0;
+        int joint_tripped = 0;
+
+        // struct to hold the cycle scheduler configuration
+        CycleConfig cycle = {CYCLE_BUSY_POLL, 0.0, CATCHUP_SKIP, 1, 0.0, 0.0, 0.0, PIPELINE_OFF};
+
+        // struct to hold the drive enable configuration
+        EnableConfig enable = {ENABLE_SDO, 1.0};
+
+        // struct to hold the setpoint interpolation configuration
+        InterpConfig interp = {INTERP_ZOH, 0.0, 10000.0, FALLBACK_HOLD};
+
+        // struct to hold the flight recorder configuration
+        RecorderConfig recorder_config = {false, 10.0, 1.0, "."};
+
+        // struct to hold the telemetry configuration
+        TelemetryConfig telemetry = {{}, 1};
+
+        // struct to hold the bus backend configuration
+        BusConfig bus = {BUS_SOEM, {0, {}, 8192.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0}, {}, false};
 };
 
 #endif
\ No newline at end of file
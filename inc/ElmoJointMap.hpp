@@ -0,0 +1,145 @@
+#ifndef ELMOJOINTMAP_H
+#define ELMOJOINTMAP_H
+
+// Standard headers
+#include <math.h>
+#include <stddef.h>
+#include <utility>
+
+/* Compile-time joint maps
+ * -------------------
+ * A robot is described by one table with a JointSpec per joint, in the order the app uses
+ * (joint order). Each joint says where its drive sits on the daisy chain and how to convert
+ * encoder counts to radians. JointMap<Robot> turns the table into fully unrolled kernels:
+ *   - toJoint:  chain order counts -> joint order [rad] or [rad/s]  (fused gather + scale)
+ *   - gather:   chain order -> joint order, no scaling               (status words, inputs, ...)
+ *   - toChain:  joint order -> chain order with the joint sign       (torque commands)
+ *   - fromChain: chain order -> joint order with the joint sign      (torques sent)
+ * The chain side is either a plain array or one field of per drive records (DriveState, ...).
+ * A robot only provides:
+ *   struct MyRobot {
+ *     static constexpr int N = ...;
+ *     static constexpr JointTable<N> table() { return {{ {chain, gear_ratio, cpr, sign}, ... }}; }
+ *   };
+ */
+
+// one joint: its drive on the chain and its encoder conversion
+struct JointSpec {
+  int chain;           // index of the drive in the daisy chain (0-indexed)
+  double gear_ratio;   // gear ratio between motor and joint
+  double cpr;          // encoder counts per motor revolution
+  double sign;         // +1.0 or -1.0, joint direction relative to the motor
+
+  // encoder counts to joint radians
+  constexpr double scale() const { return this->sign * 2.0 * M_PI / this->cpr / this->gear_ratio; }
+};
+
+// the joints of one robot, in joint order
+template <int N>
+struct JointTable {
+  JointSpec joint[N];
+};
+
+// constants of joint I, evaluated by the compiler
+template <class Robot, int I>
+struct JointConst {
+  static constexpr int chain = Robot::table().joint[I].chain;
+  static constexpr double scale = Robot::table().joint[I].scale();
+  static constexpr double sign = Robot::table().joint[I].sign;
+};
+
+//  Permutation and scaling kernels generated from a robot table
+template <class Robot>
+class JointMap {
+
+    public:
+
+        // number of joints
+        static constexpr int N = Robot::N;
+
+        // function to convert chain order encoder counts to joint order radians
+        template <class In>
+        static inline void toJoint(const In *chain, double *joint) {
+            toJoint(chain, joint, std::make_index_sequence<N>());
+        }
+
+        // function to reorder chain order values to joint order
+        template <class In, class Out>
+        static inline void gather(const In *chain, Out *joint) {
+            gather(chain, joint, std::make_index_sequence<N>());
+        }
+
+        // function to reorder joint order values to chain order, applying the joint sign
+        template <class In, class Out>
+        static inline void toChain(const In *joint, Out *chain) {
+            toChain(joint, chain, std::make_index_sequence<N>());
+        }
+
+        // same kernels on one field of chain order drive records
+        template <class Drive, class F>
+        static inline void toJoint(const Drive *chain, F Drive::*field, double *joint) {
+            toJoint(chain, field, joint, std::make_index_sequence<N>());
+        }
+        template <class Drive, class F, class Out>
+        static inline void gather(const Drive *chain, F Drive::*field, Out *joint) {
+            gather(chain, field, joint, std::make_index_sequence<N>());
+        }
+        template <class In, class Drive, class F>
+        static inline void toChain(const In *joint, Drive *chain, F Drive::*field) {
+            toChain(joint, chain, field, std::make_index_sequence<N>());
+        }
+        template <class Drive, class F>
+        static inline void fromChain(const Drive *chain, F Drive::*field, double *joint) {
+            fromChain(chain, field, joint, std::make_index_sequence<N>());
+        }
+
+        // number of drives the robot needs on the chain (highest chain index + 1)
+        static constexpr int drives() {
+            int n = 0;
+            for (int i = 0; i < N; i++) {
+                n = (Robot::table().joint[i].chain >= n) ? Robot::table().joint[i].chain + 1 : n;
+            }
+            return n;
+        }
+
+    private:
+
+        // every joint in one expression, unrolled at compile time
+        template <class In, size_t... I>
+        static inline void toJoint(const In *chain, double *joint, std::index_sequence<I...>) {
+            int expand[] = {0, (joint[I] = (double) chain[JointConst<Robot, I>::chain] * JointConst<Robot, I>::scale, 0)...};
+            (void) expand;
+        }
+        template <class In, class Out, size_t... I>
+        static inline void gather(const In *chain, Out *joint, std::index_sequence<I...>) {
+            int expand[] = {0, (joint[I] = (Out) chain[JointConst<Robot, I>::chain], 0)...};
+            (void) expand;
+        }
+        template <class In, class Out, size_t... I>
+        static inline void toChain(const In *joint, Out *chain, std::index_sequence<I...>) {
+            int expand[] = {0, (chain[JointConst<Robot, I>::chain] = (Out) (JointConst<Robot, I>::sign * joint[I]), 0)...};
+            (void) expand;
+        }
+        template <class Drive, class F, size_t... I>
+        static inline void toJoint(const Drive *chain, F Drive::*field, double *joint, std::index_sequence<I...>) {
+            int expand[] = {0, (joint[I] = (double) (chain[JointConst<Robot, I>::chain].*field) * JointConst<Robot, I>::scale, 0)...};
+            (void) expand;
+        }
+        template <class Drive, class F, class Out, size_t... I>
+        static inline void gather(const Drive *chain, F Drive::*field, Out *joint, std::index_sequence<I...>) {
+            int expand[] = {0, (joint[I] = (Out) (chain[JointConst<Robot, I>::chain].*field), 0)...};
+            (void) expand;
+        }
+        template <class In, class Drive, class F, size_t... I>
+        static inline void toChain(const In *joint, Drive *chain, F Drive::*field, std::index_sequence<I...>) {
+            int expand[] = {0, (chain[JointConst<Robot, I>::chain].*field = (F) (JointConst<Robot, I>::sign * joint[I]), 0)...};
+            (void) expand;
+        }
+        template <class Drive, class F, size_t... I>
+        static inline void fromChain(const Drive *chain, F Drive::*field, double *joint, std::index_sequence<I...>) {
+            int expand[] = {0, (joint[I] = JointConst<Robot, I>::sign * (double) (chain[JointConst<Robot, I>::chain].*field), 0)...};
+            (void) expand;
+        }
+};
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef ELMOLOGGER_H
+#define ELMOLOGGER_H
+
+// Standard headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+
+// Custom headers
+#include "ElmoChannel.hpp"
+#include "ElmoExecutor.hpp"
+
+// binary log file identification
+#define LOG_MAGIC   0x474F4C4F4D4C45ULL  // "ELMOLOG"
+#define LOG_VERSION 1
+
+// logger sizing
+#define LOG_RING_SIZE  16384   // records buffered between the control loop and the writer
+#define LOG_BATCH_SIZE 256     // records written to disk per fwrite
+#define LOG_IDLE_US    5000    // writer sleep when the ring is empty [us]
+
+// one fixed-size record per control tick, same columns as the CSV files
+struct LogRecord {
+  double time;              // time.csv
+  double data[18];          // data.csv: joint pos (6), joint vel (6), torque (6)
+  double commands[18];      // commands.csv: joint pos ref (6), joint vel ref (6), feedforward torque (6)
+  double diagnostics[18];   // diagnostics.csv: inputs (6), control words (6), status words (6)
+};
+
+// header at the start of every binary log file
+struct LogHeader {
+  uint64_t magic;           // LOG_MAGIC
+  uint32_t version;         // LOG_VERSION
+  uint32_t record_size;     // sizeof(LogRecord)
+};
+
+//  A class that moves log records off the control loop and writes them in the background
+class ELMOLogger {
+
+    public:
+
+        // constructor / desctructors
+        ELMOLogger() : ring(LOG_RING_SIZE), file(NULL), executor(NULL), handle(-1), running(false), dropped(0), written(0) {};
+        ~ELMOLogger() { this->stop(); };
+
+        // function to open the log file and start the writer thread, in the logger role of the executor if given
+        bool start(const char* path, ELMOExecutor *executor = NULL);
+
+        // function to drain the ring, close the file and join the writer thread
+        void stop();
+
+        // function to queue one record (control loop side, never blocks)
+        bool push(const LogRecord& record);
+
+        // counters
+        uint64_t getDropped() { return this->dropped.load(std::memory_order_relaxed); };
+        uint64_t getWritten() { return this->written.load(std::memory_order_relaxed); };
+
+    private:
+
+        // records waiting to be written
+        SpscRing<LogRecord> ring;
+
+        // output file and writer thread
+        FILE *file;
+        pthread_t writer;
+
+        // executor that runs the writer thread (NULL: plain thread) and its handle
+        ELMOExecutor *executor;
+        int handle;
+        std::atomic<bool> running;
+
+        // number of records dropped because the ring was full / written to disk
+        std::atomic<uint64_t> dropped;
+        std::atomic<uint64_t> written;
+
+        // writer thread
+        static void *writerThread(void *logger);
+        size_t drain(LogRecord *batch);
+};
+
+// function to convert a binary log into time.csv, data.csv, commands.csv and diagnostics.csv
+int convertLogToCSV(const char* log_path, const char* csv_dir);
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef ELMOMAILBOX_H
+#define ELMOMAILBOX_H
+
+// Standard headers
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+
+// Custom headers
+#include "ElmoBus.hpp"
+#include "ElmoCycle.hpp"
+#include "ElmoExecutor.hpp"
+
+// mailbox worker sizing
+#define MAILBOX_QUEUE      64       // max requests waiting for the worker
+#define MAILBOX_TIMEOUT_US 700000   // SDO answer timeout, same as EC_TIMEOUTRXM [us]
+#define MAILBOX_POLL_US    50       // worker sleep while it waits for a window [us]
+
+// outcome of a request
+#define SDO_OK         1   // transferred
+#define SDO_FAILED     0   // aborted by the drive or no answer within the timeout
+#define SDO_CANCELLED -1   // never sent: queue full or the mailbox was stopped
+
+// one SDO request and its result
+struct SdoResult {
+  int drive;                 // drive index (0-indexed, bus order)
+  uint16 index;              // object index
+  uint8 subindex;            // object subindex
+  bool write;                // SDO write, otherwise read
+  int size;                  // [bytes] object size, up to 4 (reads report the size the drive sent)
+  uint32 value;              // value written or read, little endian
+  int status;                // SDO_OK, SDO_FAILED or SDO_CANCELLED
+  int64 t_queued;            // time the request was queued [ns]
+  int64 t_done;              // time the request completed [ns]
+};
+
+// function called on the worker thread when a request completes
+typedef std::function<void(const SdoResult &)> SdoCallback;
+
+/*  Non-cyclic SDO access to the drives while the cyclic loop runs
+    - any thread queues requests, a worker thread at normal (non real-time) priority carries them out
+      one at a time and completes a future or calls a callback
+    - requests wait in a ring allocated up front, the callback forms do not touch the heap when the
+      callback fits in the std::function (a function pointer or a lambda capturing up to two pointers);
+      the future forms allocate the shared state of their promise
+    - a transfer only starts in a fresh window of the comm thread (CycleWindow), at most one per cycle, so
+      mailbox frames follow the cycle's frame on the wire instead of going out right before the next one
+    - the drive takes about a millisecond to answer, the transfer keeps polling its mailbox across cycles
+      with short frames that SOEM interleaves with the process data on the port
+*/
+class ELMOMailbox {
+
+    public:
+
+        // constructor / desctructors
+        ELMOMailbox();
+        ~ELMOMailbox() { this->stop(); };
+
+        // function to start the worker on an open bus, in the executor's logger role. Requests queued before are
+        // carried out from now on in the windows the comm thread opens
+        bool start(ELMOBus *bus, const CycleWindow *window, ELMOExecutor *executor);
+
+        // function to join the worker and cancel the requests left, called before the bus is closed
+        void stop();
+
+        // requests completed through a future
+        std::future<SdoResult> read(int drive, uint16 index, uint8 subindex);
+        std::future<SdoResult> write(int drive, uint16 index, uint8 subindex, int size, uint32 value);
+
+        // requests completed through a callback on the worker thread, false if the request was cancelled
+        bool read(int drive, uint16 index, uint8 subindex, SdoCallback done);
+        bool write(int drive, uint16 index, uint8 subindex, int size, uint32 value, SdoCallback done);
+
+        // counters
+        uint64_t getCompleted() { return this->completed.load(std::memory_order_relaxed); };
+        uint64_t getFailed() { return this->failed.load(std::memory_order_relaxed); };
+        uint64_t getCancelled() { return this->cancelled.load(std::memory_order_relaxed); };
+
+    private:
+
+        // one queued request, completes either the promise (future forms) or the callback
+        struct Request {
+          SdoResult sdo;
+          std::unique_ptr<std::promise<SdoResult>> promise;
+          SdoCallback callback;
+        };
+
+        // ring of requests waiting for the worker: oldest one and number waiting
+        std::vector<Request> queue;
+        size_t head;
+        size_t waiting;
+        std::mutex lock;
+        std::condition_variable wake;
+
+        // bus the transfers go out on, and the executor that started the worker thread and its handle
+        ELMOBus *bus;
+        ELMOExecutor *executor;
+        int worker;
+        bool started;
+
+        // false once stopped, new requests are cancelled
+        bool accepting;
+        std::atomic<bool> running;
+
+        // idle time after every cycle's frame, opened by the comm thread
+        const CycleWindow *window;
+
+        // number of requests transferred / failed / cancelled
+        std::atomic<uint64_t> completed;
+        std::atomic<uint64_t> failed;
+        std::atomic<uint64_t> cancelled;
+
+        // function to build a request
+        static SdoResult request(int drive, uint16 index, uint8 subindex, bool write, int size, uint32 value);
+
+        // function to queue a request, cancels it when the queue is full or the mailbox is stopped
+        bool submit(Request &req);
+
+        // function to fill in the outcome and complete the promise or call the callback
+        void complete(Request &req, int status);
+
+        // worker thread
+        static void *workerThread(void *mailbox);
+};
+
+#endif
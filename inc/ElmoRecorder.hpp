@@ -0,0 +1,118 @@
+#ifndef ELMORECORDER_H
+#define ELMORECORDER_H
+
+// Standard headers
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Custom headers
+#include "ElmoComm.hpp"
+#include "ElmoExecutor.hpp"
+
+// events that freeze the recorder (bit mask)
+#define RECORD_FAULT  0x01   // a drive went to FAULT
+#define RECORD_WKC    0x02   // the working counter dropped
+#define RECORD_LIMIT  0x04   // a joint left its limits
+#define RECORD_MANUAL 0x08   // requested by the app
+#define RECORD_STALE  0x80   // not an event: the inputs of this cycle were not refreshed (working counter low)
+
+// dump thread sleep while there is nothing to write [us]
+#define RECORDER_IDLE_US 10000
+
+// struct for the flight recorder configuration
+struct RecorderConfig {
+  bool enabled;              // record every bus cycle
+  double window_s;           // [sec] history kept in memory
+  double post_s;             // [sec] recorded after an event before the recorder freezes
+  std::string dir;           // directory the recordings are written to
+};
+
+// per cycle fields of a record
+struct RecordHead {
+  uint64 cycle;              // bus cycle counter
+  int64 deadline_ns;         // scheduled release time [ns]
+  int64 t_recv;              // time the frame was received [ns]
+  int32 wkc;                 // working counter
+  uint32 events;             // RECORD_* raised in this cycle
+};
+
+/*  Flight recorder of the last window_s seconds of process data
+    - a preallocated ring of one record per bus cycle: the cycle fields and the drive records (process data
+      in and out, control and status words) of the comm thread's snapshot, copied with one memcpy
+    - a fault, a working counter drop or a limit violation arms it, post_s seconds later the ring freezes and
+      a background thread writes it to <dir>/flight_<cycle>.csv, oldest cycle first, then recording resumes
+    - cycles that pass while the ring is frozen are not recorded, events in them are counted as missed
+*/
+class ELMORecorder {
+
+    public:
+
+        // constructor / desctructors
+        ELMORecorder(RecorderConfig config, double freq);
+        ~ELMORecorder() { this->finish(); };
+
+        // function to allocate the ring for the drives found and start the dump thread in the executor's logger
+        // role, before the main loop
+        bool init(int drives, ELMOExecutor *executor);
+
+        // function to record one cycle, comm thread only. drive is the cycle's snapshot (NULL: zeros)
+        void record(const RecordHead &head, const DriveState *drive);
+
+        // function to raise an event from any thread, recorded with the next cycle
+        void trigger(uint32 event) { this->pending.fetch_or(event, std::memory_order_relaxed); };
+
+        // function to write an armed recording and join the dump thread, after the main loop
+        void finish();
+
+        // counters
+        uint64_t getDumps() { return this->dumps.load(std::memory_order_relaxed); };
+        uint64_t getMissed() { return this->missed.load(std::memory_order_relaxed); };
+
+    private:
+
+        // configuration and sizing
+        RecorderConfig config;
+        double freq;
+        int drives;
+        size_t slot_bytes;
+        size_t capacity;
+        int64_t post_cycles;
+
+        // ring of records, next slot to write and number of records since the last dump
+        std::vector<uint8_t> ring;
+        size_t next;
+        size_t count;
+
+        // armed recording: cycles left before freezing (-1: not armed), its events and first cycle
+        int64_t post_left;
+        uint32 events;
+        uint64 trigger_cycle;
+
+        // events raised by other threads
+        std::atomic<uint32_t> pending;
+
+        // true from the freeze until the dump is written, the comm thread skips the ring meanwhile
+        std::atomic<bool> frozen;
+
+        // executor running the dump thread, and its handle
+        ELMOExecutor *executor;
+        int dumper;
+        bool started;
+        std::atomic<bool> running;
+
+        // number of recordings written / events lost while frozen
+        std::atomic<uint64_t> dumps;
+        std::atomic<uint64_t> missed;
+
+        // function to write the frozen ring as CSV
+        void dump();
+
+        // dump thread
+        static void *dumpThread(void *recorder);
+};
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef ELMORELOAD_H
+#define ELMORELOAD_H
+
+// Standard headers
+#include <string>
+#include <atomic>
+
+// Custom headers
+#include "ElmoInterface.hpp"
+#include "ElmoExecutor.hpp"
+
+// watcher timing
+#define RELOAD_POLL_MS   100   // [ms] longest wait for a file event before the stop flag is checked
+#define RELOAD_SETTLE_MS 50    // [ms] quiet time after the last event before the file is parsed
+#define RELOAD_SWAP_S    1.0   // [sec] time a swap waits for the previous one to leave the loops
+
+// struct for the config reload
+struct ReloadConfig {
+  bool enabled;              // watch the config file while running
+  double ramp_s;             // [sec] time reloaded gains are blended in over, 0 switches at once
+};
+
+/*  Reloads the joint gains and limits from the config file while the loops run
+    - a background thread (executor logger role) waits on inotify for the file to be written or replaced
+      (editors save through a rename), parses it, checks the gains and limits and hands them to
+      ELMOInterface::setParams, which swaps them without locking (RCU)
+    - a file that does not parse or holds bad values is reported and the loops keep what they have
+    - the app tick and the comm cycle pick the new values up at their next boundary, the gains are blended in
+      over ramp_s so a retune does not step the torque
+*/
+class ELMOConfigWatcher {
+
+    public:
+
+        // constructor / desctructors
+        ELMOConfigWatcher() : elmo(NULL), executor(NULL), handle(-1), running(false), reloads(0), rejected(0) {};
+        ~ELMOConfigWatcher() { this->stop(); };
+
+        // function to start watching the config file, the gains and limits go to elmo
+        bool start(const char *path, ReloadConfig config, ELMOInterface *elmo, ELMOExecutor *executor);
+
+        // function to stop watching and join the thread
+        void stop();
+
+        // counters
+        uint64_t getReloads() { return this->reloads.load(std::memory_order_relaxed); };
+        uint64_t getRejected() { return this->rejected.load(std::memory_order_relaxed); };
+
+    private:
+
+        // watched file, its directory and name in it
+        std::string path;
+        std::string dir;
+        std::string name;
+
+        // reload configuration and the interface the values go to
+        ReloadConfig config;
+        ELMOInterface *elmo;
+
+        // gains and limits in use
+        JointParams params;
+
+        // executor that runs the watcher thread and its handle
+        ELMOExecutor *executor;
+        int handle;
+        std::atomic<bool> running;
+
+        // number of swaps / of files rejected
+        std::atomic<uint64_t> reloads;
+        std::atomic<uint64_t> rejected;
+
+        // function to parse and check the file and swap the values in
+        void reload();
+
+        // watcher thread
+        static void *watcherThread(void *arg);
+};
+
+// function to check gains and limits, prints what is wrong and returns false
+bool checkParams(const JointParams &params);
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef ELMOSETPOINT_H
+#define ELMOSETPOINT_H
+
+// Standard headers
+#include <stdint.h>
+
+// Custom headers
+#include "ElmoControl.hpp"
+
+// how the references are interpolated between two setpoints
+#define INTERP_ZOH     0   // hold each setpoint until the next one
+#define INTERP_LINEAR  1   // straight line between the setpoints
+#define INTERP_HERMITE 2   // cubic Hermite spline through the positions and velocities
+
+// what the references fall back to once the newest setpoint is older than the horizon
+#define FALLBACK_HOLD 0    // hold the last position, zero velocity and feedforward
+#define FALLBACK_DAMP 1    // zero position gain, velocity reference and feedforward: the joints are only damped
+
+// result of sampling the references
+#define SETPOINT_NONE         0   // no setpoint received yet
+#define SETPOINT_INTERPOLATED 1   // between two setpoints (or holding the only one)
+#define SETPOINT_EXTRAPOLATED 2   // past the newest setpoint, within the horizon
+#define SETPOINT_EXPIRED      3   // past the horizon, fallback references
+
+// struct for the setpoint interpolation configuration
+struct InterpConfig {
+  int mode;            // INTERP_ZOH, INTERP_LINEAR or INTERP_HERMITE
+  double delay_us;     // references are played back this late, ~one app period keeps two setpoints around [us]
+  double horizon_us;   // max time past the newest setpoint before falling back [us]
+  int fallback;        // FALLBACK_HOLD or FALLBACK_DAMP
+};
+
+// setpoint streamed by the app to the in-cycle PD law, joint order
+struct JointSetpoint {
+  uint64_t seq;              // setpoint counter, 0 until the app sent one
+  int64_t timestamp;         // time the references apply to [ns]
+  JointArray q_ref;          // joint position reference [rad]
+  JointArray qd_ref;         // joint velocity reference [rad/s]
+  JointArray tau_ff;         // feedforward torque
+  JointGains gains;          // gains used with this setpoint
+};
+
+/*  Resamples the setpoints streamed by a slower app loop at the bus rate
+    - keeps the two newest setpoints and plays the references back delay_us late, so the
+      bus time normally falls between them
+    - past the newest setpoint the references are extrapolated with its velocity for at most
+      horizon_us, then they fall back to holding or damping the joints
+    - the gains always come from the newest setpoint
+*/
+class SetpointInterpolator {
+
+    public:
+
+        // constructor / desctructors
+        SetpointInterpolator() : held(0) {};
+        ~SetpointInterpolator() {};
+
+        // function to set the interpolation mode, delay, horizon and fallback
+        void init(InterpConfig config);
+
+        // function to take in a new setpoint, older or repeated setpoints are ignored
+        void push(const JointSetpoint &setpoint);
+
+        // function to get the references at time t [ns], returns one of SETPOINT_*
+        int sample(int64_t t, JointSetpoint &out) const;
+
+    private:
+
+        // interpolation configuration
+        InterpConfig config;
+
+        // the two newest setpoints, newest last
+        JointSetpoint prev;
+        JointSetpoint next;
+
+        // number of setpoints held (0, 1 or 2)
+        int held;
+};
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef ELMOSHM_H
+#define ELMOSHM_H
+
+// Standard headers
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <new>
+#include <atomic>
+#include <algorithm>
+#include <string>
+
+// Custom headers
+#include "ElmoInterface.hpp"
+
+// shared memory segment
+#define SHM_MAGIC       0x4f4d4c45   // "ELMO", written last by the daemon once the segment is set up
+#define SHM_VERSION     2            // layout version, clients refuse other versions
+#define SHM_MAX_DRIVES  64           // drives the segment has room for
+
+// what the client's command carries
+#define SHM_TORQUE   0   // torque of every drive (sendTorque)
+#define SHM_SETPOINT 1   // setpoint for the PD law the daemon runs in the bus cycle (sendSetpoint)
+
+// struct for the bus daemon configuration
+struct ShmConfig {
+  std::string name;          // POSIX shared memory name (e.g. "/elmo_bus")
+  double heartbeat_s;        // [sec] zero torque once the client's newest command is older than this
+};
+
+/* Per cycle fields followed by one record per drive, fixed size so it can live in shared memory
+   - only the first count records are used, channelCopy copies just those
+*/
+template <typename Head, typename Drive>
+struct ShmFrame {
+  Head head;                         // per cycle fields
+  int32 count;                       // number of drives
+  Drive drive[SHM_MAX_DRIVES];       // one record per drive (daisy chain order)
+
+  // number of drives
+  int drives() const { return this->count; }
+};
+
+// function to copy a shared frame, only the drives in use
+template <typename Head, typename Drive>
+inline void channelCopy(ShmFrame<Head, Drive> &dst, const ShmFrame<Head, Drive> &src) {
+    dst.head = src.head;
+    dst.count = src.count;
+    memcpy(dst.drive, src.drive, src.count * sizeof(Drive));
+}
+
+// function to copy a shared frame into a drive frame, only the first copy into an unsized frame allocates
+template <typename Head, typename Drive>
+inline void channelCopy(DriveFrame<Head, Drive> &dst, const ShmFrame<Head, Drive> &src) {
+    dst.head = src.head;
+    if (dst.drive.size() != (size_t) src.count) {
+        dst.drive.resize(src.count);
+    }
+    memcpy(dst.drive.data(), src.drive, src.count * sizeof(Drive));
+}
+
+// per cycle fields of a client command
+struct ShmCommandHead {
+  uint64 seq;                // command counter (ShmBus::seq)
+  int64 timestamp;           // time the command was published [ns]
+  int32 mode;                // SHM_TORQUE or SHM_SETPOINT
+};
+
+// state, telemetry and command frames in the segment
+typedef ShmFrame<ELMOStateHead, DriveState> ShmState;
+typedef ShmFrame<ELMOTelemetryHead, DriveTelemetry> ShmTelemetry;
+struct ShmCommand {
+  ShmCommandHead head;
+  JointSetpoint setpoint;                // SHM_SETPOINT
+  DriveCommand drive[SHM_MAX_DRIVES];    // SHM_TORQUE, daisy chain order
+};
+
+/* Layout of the shared memory segment between the bus daemon and one client
+   - the daemon's comm thread writes the state every cycle (seqlock) and takes the newest client command
+     (triple buffer), the client maps the segment and reads / writes them in place
+   - the client owns the segment while client holds its pid, and keeps the drives under torque by
+     publishing commands. Without a command for heartbeat_s the daemon holds zero torque
+*/
+struct ShmBus {
+  std::atomic<uint32_t> magic;           // SHM_MAGIC once the segment is set up
+  uint32_t version;                      // SHM_VERSION
+  pid_t daemon;                          // daemon process
+  double freq;                           // bus rate [Hz]
+  std::atomic<int32_t> drives;           // drives on the chain, set once the bus is up
+  std::atomic<int32_t> online;           // 1 while the bus runs
+
+  SeqLock<ShmState> state;               // newest snapshot, written by the daemon's comm thread
+  SeqLock<ShmTelemetry> telemetry;       // newest telemetry, written by the daemon
+  TripleBuffer<ShmCommand> command;      // newest command, written by the client
+
+  std::atomic<pid_t> client;             // attached client, 0 when there is none
+  std::atomic<uint64_t> seq;             // command counter, kept across clients so a new client's setpoints
+                                         // are always newer than the ones the PD law last saw
+  std::atomic<int64_t> attached;         // time the client attached, older commands are ignored [ns]
+  std::atomic<int64_t> heartbeat;        // time of the client's newest command [ns]
+  std::atomic<int32_t> saturated;        // joints saturated / tripped by the daemon's PD law (bit masks)
+  std::atomic<int32_t> tripped;
+
+  std::atomic<uint64_t> attaches;        // number of clients attached so far
+  std::atomic<uint64_t> held;            // bus cycles held at zero torque without a client heartbeat
+};
+
+// function to create (or take over) the segment, daemon side. NULL on failure
+ShmBus *shmCreate(const char *name, double freq);
+
+// function to map an existing segment, client side. NULL if there is no daemon
+ShmBus *shmAttach(const char *name);
+
+// function to unmap the segment
+void shmDetach(ShmBus *shm);
+
+// function to unmap and remove the segment, daemon side
+void shmRemove(ShmBus *shm, const char *name);
+
+//  Torque law run by the daemon's comm thread: publishes every snapshot to the segment and applies the
+//  client's newest command, or zero torque when no client heartbeat is present
+class ELMOShmBridge : public CycleController {
+
+    public:
+
+        // constructor / desctructors
+        ELMOShmBridge(ShmBus *shm, ShmConfig config, JointLimits limits, InterpConfig interp);
+        ~ELMOShmBridge() {};
+
+        // CycleController interface
+        void init(int drives);
+        const ELMOCommand &update(const ELMOState &state);
+
+    private:
+
+        // segment and heartbeat timeout
+        ShmBus *shm;
+        int64 timeout_ns;
+
+        // PD law run on the client's setpoints (SHM_SETPOINT)
+        ELMOJointPD pd;
+
+        // newest client command forwarded to the PD law
+        uint64 setpoint_seq;
+
+        // torque of every drive from the client / zero torque, daisy chain order
+        ELMOCommand command;
+        ELMOCommand zero;
+};
+
+#endif
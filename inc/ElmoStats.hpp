@@ -0,0 +1,147 @@
+#ifndef ELMOSTATS_H
+#define ELMOSTATS_H
+
+// Standard headers
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+
+/* Log-linear (HDR-style) histogram bucket layout
+   - values below 2*HIST_SUB are counted exactly
+   - every power of two above that is split into HIST_SUB linear sub-buckets (<1% resolution)
+   - covers 0 ns up to 2^HIST_MAX_EXP ns (~17 s), larger values land in the last bucket
+*/
+#define HIST_SUB_BITS 7
+#define HIST_SUB      (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP  34
+#define HIST_BUCKETS  ((HIST_MAX_EXP - HIST_SUB_BITS + 1) * HIST_SUB + HIST_SUB)
+
+// summary of one histogram [ns]
+struct TimingSummary {
+  uint64_t count;
+  double mean;
+  int64_t min;
+  int64_t p50;
+  int64_t p99;
+  int64_t p999;
+  int64_t max;
+};
+
+// summary of the cyclic loop timing
+struct CycleStatsSummary {
+  TimingSummary period;      // time between consecutive cycle releases
+  TimingSummary wakeup;      // release time minus scheduled deadline
+  TimingSummary roundtrip;   // frame sent -> frame received (pipelined: spans the wait, the age of the inputs)
+  TimingSummary io;          // time the loop thread is blocked in send + receive
+  TimingSummary processing;  // data update + drive state machine
+  uint64_t overruns;         // wakeups that missed at least one full period
+  uint64_t skipped;          // cycles dropped by the catch-up rule
+  TimingSummary dc_offset;   // |frame DC time - (SYNC0 - lead)| (DC synchronous mode)
+  double dc_drift_ppm;       // master clock drift against the DC reference clock
+};
+
+//  A fixed-bucket latency histogram, written by one thread and readable from any thread
+class LatencyHistogram {
+
+    public:
+
+        // constructor / desctructors
+        LatencyHistogram() { this->reset(); };
+        ~LatencyHistogram() {};
+
+        // function to record one sample [ns] (writer thread only)
+        inline void record(int64_t ns) {
+            if (ns < 0) {
+                ns = 0;
+            }
+            bump(this->counts[bucketOf((uint64_t) ns)], 1);
+            bump(this->count, 1);
+            bump(this->sum, (uint64_t) ns);
+            if (ns < this->min.load(std::memory_order_relaxed)) {
+                this->min.store(ns, std::memory_order_relaxed);
+            }
+            if (ns > this->max.load(std::memory_order_relaxed)) {
+                this->max.store(ns, std::memory_order_relaxed);
+            }
+        }
+
+        // function to clear all samples (writer thread only)
+        void reset();
+
+        // function to compute min/p50/p99/p99.9/max
+        TimingSummary summary() const;
+
+        // function to get the value at a quantile in [0, 1]
+        int64_t quantile(double q) const;
+
+    private:
+
+        // bucket counters and running totals
+        std::atomic<uint64_t> counts[HIST_BUCKETS];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<int64_t> min;
+        std::atomic<int64_t> max;
+
+        // single writer increment, a plain load and store instead of a locked add
+        static inline void bump(std::atomic<uint64_t> &c, uint64_t v) {
+            c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        }
+
+        // value to bucket index
+        static inline int bucketOf(uint64_t v) {
+            if (v < 2 * HIST_SUB) {
+                return (int) v;
+            }
+            int msb = 63 - __builtin_clzll(v);
+            if (msb > HIST_MAX_EXP) {
+                return HIST_BUCKETS - 1;
+            }
+            int shift = msb - HIST_SUB_BITS;
+            return shift * HIST_SUB + (int) (v >> shift);
+        }
+
+        // bucket index to the midpoint of the values it holds
+        static inline int64_t valueOf(int idx) {
+            if (idx < 2 * HIST_SUB) {
+                return idx;
+            }
+            int shift = idx / HIST_SUB - 1;
+            int64_t lo = (int64_t) (idx - shift * HIST_SUB) << shift;
+            return lo + ((1LL << shift) >> 1);
+        }
+};
+
+//  Timing histograms for the cyclic EtherCAT loop
+class CycleStats {
+
+    public:
+
+        // constructor / desctructors
+        CycleStats() : overruns(0), skipped(0), dc_offset_ns(0), dc_drift_ppb(0) {};
+        ~CycleStats() {};
+
+        // histograms [ns]
+        LatencyHistogram period;
+        LatencyHistogram wakeup;
+        LatencyHistogram roundtrip;
+        LatencyHistogram io;
+        LatencyHistogram processing;
+        LatencyHistogram dc_offset;
+
+        // counters copied from the cycle scheduler
+        std::atomic<uint64_t> overruns;
+        std::atomic<uint64_t> skipped;
+
+        // latest DC phase error [ns] and drift estimate [ppb] from the DC controller
+        std::atomic<int64_t> dc_offset_ns;
+        std::atomic<int64_t> dc_drift_ppb;
+
+        // function to summarize all histograms
+        CycleStatsSummary summary() const;
+
+        // function to print the summary
+        void print() const;
+};
+
+#endif
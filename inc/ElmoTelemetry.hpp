@@ -0,0 +1,110 @@
+#ifndef ELMOTELEMETRY_H
+#define ELMOTELEMETRY_H
+
+// Standard headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// drive objects that can be mapped into the telemetry TxPDO
+#define TELEM_CURRENT         0   // 0x6078 current actual value, INT16 [1/1000 rated current]
+#define TELEM_DC_VOLTAGE      1   // 0x6079 DC link circuit voltage, UINT32 [mV]
+#define TELEM_TEMPERATURE     2   // 0x22A2:1 drive temperature (ELMO), INT16 [C]
+#define TELEM_FOLLOWING_ERROR 3   // 0x60F4 following error actual value, INT32 [counts]
+#define TELEM_TORQUE          4   // 0x6077 torque actual value, INT16 [1/1000 rated torque]
+#define TELEM_FIELDS          5
+
+// flexible TxPDO the telemetry objects are mapped into, assigned after 0x1A03
+#define TELEMETRY_PDO 0x1A02
+
+// bytes of the 0x1A03 image, the telemetry PDO follows it in every drive's inputs
+#define TXPDO_BYTES 14
+
+// max bytes of the telemetry PDO (all objects mapped)
+#define TELEMETRY_MAX_BYTES 14
+
+// one drive object that can be mapped
+struct TelemetryObject {
+  const char *name;          // name used in the config file
+  uint16_t index;            // object index
+  uint8_t subindex;          // object subindex
+  int size;                  // [bytes]
+  bool is_signed;            // signed integer
+};
+
+// struct for the telemetry configuration
+struct TelemetryConfig {
+  std::vector<int> objects;  // TELEM_* in PDO order, empty maps nothing
+  int decimation;            // the app channel is refreshed every this many bus cycles
+};
+
+// decoded telemetry of one drive, indexed by TELEM_*, unmapped objects read 0
+struct DriveTelemetry {
+  int32_t value[TELEM_FIELDS];
+};
+
+// objects that can be mapped, indexed by TELEM_*
+extern const TelemetryObject telemetry_objects[TELEM_FIELDS];
+
+// function to find a telemetry object by name, -1 if unknown
+int telemetryObject(const std::string &name);
+
+/*  Byte layout of the telemetry PDO of a drive
+    - objects are packed in the configured order, right after the 0x1A03 image in the drive's inputs
+    - the accessors read straight out of the process data image, no copy of the drive's inputs is made
+*/
+class TelemetryLayout {
+
+    public:
+
+        // constructor / desctructors
+        TelemetryLayout();
+        TelemetryLayout(const TelemetryConfig &config);
+        ~TelemetryLayout() {};
+
+        // number of mapped objects and bytes of the PDO
+        int count() const { return this->fields; };
+        int bytes() const { return this->size; };
+
+        // true if the object is mapped
+        bool has(int object) const { return this->offset[object] >= 0; };
+
+        // PDO mapping entry (index << 16 | subindex << 8 | bits) of the k-th mapped object
+        uint32_t mapping(int k) const;
+
+        // function to read one object from the telemetry image of a drive, 0 if not mapped
+        int32_t get(const uint8_t *image, int object) const {
+            return this->has(object) ? read(image + this->offset[object], object) : 0;
+        }
+
+        // function to write one object into a telemetry image (simulated drives)
+        void set(uint8_t *image, int object, int32_t value) const;
+
+        // function to decode every object of a drive
+        void decode(const uint8_t *image, DriveTelemetry &out) const;
+
+    private:
+
+        // mapped objects in PDO order and the byte offset of every object (-1: not mapped)
+        int order[TELEM_FIELDS];
+        int offset[TELEM_FIELDS];
+        int fields;
+        int size;
+
+        // function to read an object of its size and sign, the image is packed so the read is unaligned
+        static int32_t read(const uint8_t *p, int object) {
+            const TelemetryObject &obj = telemetry_objects[object];
+            if (obj.size == 2) {
+                uint16_t v;
+                memcpy(&v, p, sizeof(v));
+                return obj.is_signed ? (int32_t) (int16_t) v : (int32_t) v;
+            }
+            int32_t v;
+            memcpy(&v, p, sizeof(v));
+            return v;
+        }
+};
+
+#endif
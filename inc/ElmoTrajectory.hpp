@@ -0,0 +1,190 @@
+#ifndef ELMOTRAJECTORY_H
+#define ELMOTRAJECTORY_H
+
+// Standard headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+// Custom headers
+#include "ElmoControl.hpp"
+
+// trajectory file
+#define TRAJ_MAGIC   0x52544c45   // "ELTR"
+#define TRAJ_VERSION 1
+
+// streaming of mapped trajectory files
+#define TRAJ_WINDOW_S 1.0         // [sec] of samples read ahead of / dropped behind the playhead at a time
+
+// trajectory sources
+#define TRAJ_SINE  0   // offset + amplitude * sin(2 pi f t)
+#define TRAJ_CHIRP 1   // sine sweeping linearly from frequency to frequency_end over duration, then holding it
+#define TRAJ_STEP  2   // offset until duration, offset + amplitude after
+#define TRAJ_FILE  3   // samples of a trajectory file, cubic Hermite between them
+
+// joint references at one time, joint order
+struct TrajectoryPoint {
+  JointArray q;              // position [rad]
+  JointArray qd;             // velocity [rad/s]
+  JointArray tau_ff;         // feedforward torque
+};
+
+// struct for the trajectory configuration
+struct TrajectoryConfig {
+  int type;                  // TRAJ_SINE, TRAJ_CHIRP, TRAJ_STEP or TRAJ_FILE
+  JointArray amplitude;      // [rad]
+  JointArray offset;         // [rad]
+  double frequency;          // [Hz] sine frequency, chirp start frequency
+  double frequency_end;      // [Hz] chirp end frequency
+  double duration;           // [sec] chirp sweep time, step time
+  std::string file;          // trajectory file (TRAJ_FILE)
+};
+
+/* Trajectory file layout
+   - a header, then one sample per dt from t = 0: positions, velocities and feedforward torques of all
+     joints as doubles, so the sample of any time is found by index
+*/
+struct TrajectoryHeader {
+  uint32_t magic;            // TRAJ_MAGIC
+  uint32_t version;          // TRAJ_VERSION
+  uint32_t joints;           // joints per sample (NUM_JOINTS)
+  uint32_t reserved;
+  uint64_t samples;          // number of samples
+  double dt;                 // [sec] time between samples
+};
+struct TrajectorySample {
+  double q[NUM_JOINTS];
+  double qd[NUM_JOINTS];
+  double tau_ff[NUM_JOINTS];
+};
+
+//  Joint references as a function of time, evaluated every app tick without allocating
+class Trajectory {
+
+    public:
+
+        // constructor / desctructors
+        Trajectory() {};
+        virtual ~Trajectory() {};
+
+        // function to get the references at time t [sec] from the start
+        virtual void eval(double t, TrajectoryPoint &out) = 0;
+
+        // length of the trajectory [sec], references hold their last value after it (< 0: endless)
+        virtual double duration() const = 0;
+};
+
+// sine on every joint
+class SineTrajectory : public Trajectory {
+
+    public:
+        SineTrajectory(TrajectoryConfig config) : config(config) {};
+        void eval(double t, TrajectoryPoint &out);
+        double duration() const { return -1.0; };
+
+    private:
+        TrajectoryConfig config;
+};
+
+// linear chirp on every joint
+class ChirpTrajectory : public Trajectory {
+
+    public:
+        ChirpTrajectory(TrajectoryConfig config) : config(config) {};
+        void eval(double t, TrajectoryPoint &out);
+        double duration() const { return -1.0; };
+
+    private:
+        TrajectoryConfig config;
+};
+
+// step on every joint
+class StepTrajectory : public Trajectory {
+
+    public:
+        StepTrajectory(TrajectoryConfig config) : config(config) {};
+        void eval(double t, TrajectoryPoint &out);
+        double duration() const { return -1.0; };
+
+    private:
+        TrajectoryConfig config;
+};
+
+/*  Trajectory file mapped into memory
+    - the file is never read in whole: pages come in as the playhead reaches them, the next TRAJ_WINDOW_S
+      are read ahead and the ones behind are dropped, so files larger than RAM play back
+    - eval finds the sample pair by index and interpolates positions and velocities with a cubic Hermite
+      spline (feedforward linearly), before t = 0 / after the end it holds the first / last sample
+*/
+class FileTrajectory : public Trajectory {
+
+    public:
+
+        // constructor / desctructors
+        FileTrajectory() : map(NULL), map_bytes(0), samples(NULL), count(0), dt(0.0), window(0), ahead(0), behind(0) {};
+        ~FileTrajectory() { this->close(); };
+
+        // function to map a trajectory file, false if it cannot be read or has another layout
+        bool open(const char *path);
+
+        // function to unmap the file
+        void close();
+
+        void eval(double t, TrajectoryPoint &out);
+        double duration() const { return (this->count > 0) ? (this->count - 1) * this->dt : 0.0; };
+
+    private:
+
+        // mapping and the samples in it
+        void *map;
+        size_t map_bytes;
+        const TrajectorySample *samples;
+        uint64_t count;
+        double dt;
+
+        // samples per window, first sample past the window read ahead, first sample not dropped yet
+        uint64_t window;
+        uint64_t ahead;
+        uint64_t behind;
+
+        // function to read the next window ahead and drop the one behind the playhead
+        void advance(uint64_t k);
+};
+
+// function to create the trajectory of the configuration, NULL if its file cannot be opened
+Trajectory *createTrajectory(TrajectoryConfig config);
+
+//  Writes a trajectory file one sample at a time, so trajectories larger than RAM can be generated
+class TrajectoryWriter {
+
+    public:
+
+        // constructor / desctructors
+        TrajectoryWriter() : file(NULL), samples(0) {};
+        ~TrajectoryWriter() { this->close(); };
+
+        // function to create the file for samples dt apart
+        bool open(const char *path, double dt);
+
+        // function to append the next sample
+        void append(const TrajectoryPoint &point);
+
+        // function to write the sample count and close the file
+        void close();
+
+        // function to close the file without writing the sample count, for a file that is deleted
+        void discard();
+
+    private:
+        FILE *file;
+        TrajectoryHeader header;
+        uint64_t samples;
+};
+
+// function to convert a CSV trajectory (t, q1..q6, qd1..qd6, tau1..tau6, rows dt apart) into a trajectory file,
+// returns the number of samples written or -1 on error
+long convertCSVToTrajectory(const char *csv_path, const char *traj_path);
+
+#endif
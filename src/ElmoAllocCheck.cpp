@@ -0,0 +1,230 @@
+#include "../inc/ElmoAllocCheck.hpp"
+
+// Standard headers
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <execinfo.h>
+#include <sys/syscall.h>
+#include <atomic>
+
+// glibc allocator behind the wrappers
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+
+// tracked threads and whether the check is running
+static std::atomic<pid_t> tracked[ALLOC_MAX_THREADS];
+static std::atomic<int> tracked_count(0);
+static std::atomic<bool> armed(false);
+
+// heap calls counted while armed
+static std::atomic<uint64_t> calls(0);
+static std::atomic<uint64_t> bytes(0);
+
+// stacks of the first heap calls counted
+static void *traces[ALLOC_MAX_TRACES][ALLOC_TRACE_DEPTH];
+static int trace_depth[ALLOC_MAX_TRACES];
+static std::atomic<int> trace_count(0);
+
+// page faults of the tracked threads when the check started
+static long start_minflt[ALLOC_MAX_THREADS];
+static long start_majflt[ALLOC_MAX_THREADS];
+
+// kernel thread id, cached per thread (initial-exec TLS in the executable, reading it never allocates)
+static __thread pid_t self_tid = 0;
+
+// function to get the kernel thread id of the calling thread
+pid_t allocCheckSelf() {
+
+    if (self_tid == 0) {
+        self_tid = (pid_t) syscall(SYS_gettid);
+    }
+    return self_tid;
+}
+
+// function to count one heap call of the calling thread if it is tracked
+static inline void count(size_t size) {
+
+    if (!armed.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    pid_t tid = allocCheckSelf();
+    int n = tracked_count.load(std::memory_order_acquire);
+    for (int k = 0; k < n; k++) {
+        if (tracked[k].load(std::memory_order_relaxed) != tid) {
+            continue;
+        }
+
+        calls.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+
+        // keep where it came from, backtrace was loaded before arming so it does not allocate here
+        int t = trace_count.fetch_add(1, std::memory_order_relaxed);
+        if (t < ALLOC_MAX_TRACES) {
+            trace_depth[t] = backtrace(traces[t], ALLOC_TRACE_DEPTH);
+        }
+        return;
+    }
+}
+
+// allocator wrappers
+extern "C" {
+
+void *malloc(size_t size) {
+    count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count_, size_t size) {
+    count(count_ * size);
+    return __libc_calloc(count_, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    count(size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    count(size);
+    void *p = __libc_memalign(alignment, size);
+    if (p == NULL) {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+
+void *valloc(size_t size) {
+    count(size);
+    return __libc_memalign(sysconf(_SC_PAGESIZE), size);
+}
+
+void free(void *ptr) {
+    if (ptr != NULL) {
+        count(0);
+    }
+    __libc_free(ptr);
+}
+
+}
+
+// function to read the page faults of a thread, syscalls only so it does not allocate
+static bool threadFaults(pid_t tid, long &minflt, long &majflt) {
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/stat", (int) tid);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char buf[1024];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) {
+        return false;
+    }
+    buf[n] = '\0';
+
+    // the fields after the command name: state(3) ppid pgrp session tty_nr tpgid flags minflt(10) cminflt majflt(12)
+    char *p = strrchr(buf, ')');
+    if (p == NULL) {
+        return false;
+    }
+    long field[10];
+    p += 2;
+    for (int k = 0; k < 10; k++) {
+        while (*p == ' ') {
+            p++;
+        }
+        field[k] = (k == 0) ? 0 : strtol(p, NULL, 10);
+        while (*p != ' ' && *p != '\0') {
+            p++;
+        }
+    }
+    minflt = field[7];
+    majflt = field[9];
+
+    return true;
+}
+
+// function to count the heap calls and page faults of a thread from the next allocCheckBegin
+bool allocCheckThread(pid_t tid) {
+
+    int n = tracked_count.load(std::memory_order_relaxed);
+    if (n >= ALLOC_MAX_THREADS) {
+        return false;
+    }
+    tracked[n].store(tid, std::memory_order_relaxed);
+    tracked_count.store(n + 1, std::memory_order_release);
+
+    return true;
+}
+
+// function to start counting
+void allocCheckBegin() {
+
+    // backtrace loads libgcc on its first call, do it now
+    void *frame[2];
+    backtrace(frame, 2);
+
+    calls = 0;
+    bytes = 0;
+    trace_count = 0;
+    int n = tracked_count.load(std::memory_order_acquire);
+    for (int k = 0; k < n; k++) {
+        start_minflt[k] = 0;
+        start_majflt[k] = 0;
+        threadFaults(tracked[k].load(), start_minflt[k], start_majflt[k]);
+    }
+    armed.store(true, std::memory_order_release);
+}
+
+// function to stop counting and return the totals of the tracked threads
+AllocUsage allocCheckEnd() {
+
+    armed.store(false, std::memory_order_release);
+
+    AllocUsage usage = {calls.load(), bytes.load(), 0, 0};
+    int n = tracked_count.load(std::memory_order_acquire);
+    for (int k = 0; k < n; k++) {
+        long minflt = start_minflt[k], majflt = start_majflt[k];
+        threadFaults(tracked[k].load(), minflt, majflt);
+        usage.minflt += minflt - start_minflt[k];
+        usage.majflt += majflt - start_majflt[k];
+    }
+
+    return usage;
+}
+
+// function to print the stacks of the first heap calls counted
+void allocCheckTraces(FILE *out) {
+
+    int n = trace_count.load();
+    if (n > ALLOC_MAX_TRACES) {
+        n = ALLOC_MAX_TRACES;
+    }
+    for (int t = 0; t < n; t++) {
+        fprintf(out, "heap call %d:\n", t + 1);
+        fflush(out);
+        backtrace_symbols_fd(traces[t], trace_depth[t], fileno(out));
+    }
+}
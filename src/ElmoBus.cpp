@@ -0,0 +1,49 @@
+#include "../inc/ElmoBus.hpp"
+#include "../inc/ElmoBusSoem.hpp"
+#include "../inc/ElmoBusSim.hpp"
+#include "../inc/ElmoBusMulti.hpp"
+
+// function to create one chain of the configured backend
+static ELMOBus *createChain(BusConfig config, int first, int drives, double freq) {
+
+    if (config.type == BUS_SIM) {
+
+        // the simulated chain takes its part of the gear ratios
+        SimConfig sim = config.sim;
+        sim.drives = drives;
+        sim.gear_ratio.clear();
+        for (int i = first; i < first + drives && i < (int) config.sim.gear_ratio.size(); i++) {
+            sim.gear_ratio.push_back(config.sim.gear_ratio[i]);
+        }
+        return new ELMOBusSim(sim, freq);
+    }
+
+    return new ELMOBusSoem();
+}
+
+// function to create the configured bus backend
+ELMOBus *createBus(BusConfig config, double freq, ELMOExecutor *executor) {
+
+    /* drives split over several ports, every chain with its own context and thread */
+    if (!config.chains.empty()) {
+
+        printf("Using %d EtherCAT chains\n", (int) config.chains.size());
+        std::vector<ELMOBus *> chains;
+        int first = 0;
+        for (size_t c = 0; c < config.chains.size(); c++) {
+            chains.push_back(createChain(config, first, config.chains[c].drives, freq));
+            first += config.chains[c].drives;
+        }
+        return new ELMOBusMulti(chains, config.chains, executor);
+    }
+
+    switch (config.type) {
+
+        case BUS_SIM:
+            printf("Using %d simulated ELMO drives\n", config.sim.drives);
+            return new ELMOBusSim(config.sim, freq);
+
+        default:
+            return new ELMOBusSoem();
+    }
+}
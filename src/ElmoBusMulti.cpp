@@ -0,0 +1,272 @@
+#include "../inc/ElmoBusMulti.hpp"
+
+// constructor, takes ownership of the chains
+ELMOBusMulti::ELMOBusMulti(std::vector<ELMOBus *> chains, std::vector<ChainConfig> config, ELMOExecutor *executor)
+    : chains(chains.size()), executor(executor), dc_refused(false), stop(false), launch(LAUNCH_WAIT), running(false) {
+
+    for (size_t c = 0; c < chains.size(); c++) {
+
+        Chain &chain = this->chains[c];
+        chain.multi = this;
+        chain.bus = chains[c];
+        chain.config = config[c];
+        chain.index = (int) c;
+        chain.first = 0;
+        chain.wkc.store(0, std::memory_order_relaxed);
+        chain.thread = -1;
+    }
+
+    // the comm thread and every worker meet at the barriers
+    this->start.init((int) chains.size());
+    this->done.init((int) chains.size());
+}
+
+// destructor
+ELMOBusMulti::~ELMOBusMulti() {
+
+    this->stopWorkers();
+    for (size_t c = 0; c < this->chains.size(); c++) {
+        delete this->chains[c].bus;
+    }
+}
+
+// function to pin the calling thread to a core (-1 leaves it free)
+void ELMOBusMulti::pinThread(int cpu, int index) {
+
+    if (cpu < 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+        printf("WARNING : could not pin chain %d to cpu %d\n", index, cpu);
+    }
+    else {
+        printf("Chain %d: exchanged on cpu %d\n", index, cpu);
+    }
+}
+
+// worker thread of one chain: exchange the chain's process data once per cycle
+void *ELMOBusMulti::worker(void *arg) {
+
+    Chain *chain = (Chain *) arg;
+    ELMOBusMulti *multi = chain->multi;
+
+    // the barriers count every chain, so no worker enters them before all of them started
+    int launch;
+    while ((launch = multi->launch.load(std::memory_order_acquire)) == LAUNCH_WAIT) {
+        usleep(LAUNCH_POLL_US);
+    }
+    if (launch == LAUNCH_ABORT) {
+        return NULL;
+    }
+
+    while (1) {
+
+        // released by the comm thread's send
+        multi->start.wait();
+        if (multi->stop) {
+            break;
+        }
+
+        chain->bus->sendProcessdata();
+        chain->wkc.store(chain->bus->receiveProcessdata(EC_TIMEOUTRET), std::memory_order_relaxed);
+
+        // collected by the comm thread's receive
+        multi->done.wait();
+    }
+
+    return NULL;
+}
+
+// function to find the drives of every chain, map the PDOs and bring the chains to OPERATIONAL
+bool ELMOBusMulti::open(const char* /* port */, uint8 opmode) {
+
+    if (this->dc_refused) {
+        return false;
+    }
+
+    int drives = 0;
+    this->drive_chain.clear();
+
+    for (size_t c = 0; c < this->chains.size(); c++) {
+
+        Chain &chain = this->chains[c];
+        printf("Chain %d: opening %s\n", (int) c, chain.config.port.c_str());
+
+        if (!chain.bus->open(chain.config.port.c_str(), opmode)) {
+
+            printf("ERROR : chain %d on %s could not be opened\n", (int) c, chain.config.port.c_str());
+            for (size_t k = 0; k < c; k++) {
+                this->chains[k].bus->close();
+            }
+            return false;
+        }
+
+        // drives are numbered chain after chain
+        chain.first = drives;
+        drives += chain.bus->slaveCount();
+        this->drive_chain.resize(drives, (int) c);
+    }
+
+    // chain 0 is exchanged by the calling (comm) thread, the others get their own thread in the bus role,
+    // pinned to the core of their chain
+    pinThread(this->chains[0].config.cpu, 0);
+    this->stop = false;
+    this->launch.store(LAUNCH_WAIT, std::memory_order_release);
+    for (size_t c = 1; c < this->chains.size(); c++) {
+
+        char name[16];
+        snprintf(name, sizeof(name), "elmo_chain%d", (int) c);
+        Chain &chain = this->chains[c];
+        chain.thread = (this->executor != NULL) ?
+                       this->executor->spawn(ROLE_BUS, name, &ELMOBusMulti::worker, (void *) &chain, chain.config.cpu) : -1;
+        if (chain.thread < 0) {
+
+            // the workers started so far leave before the barriers, every chain is closed again
+            printf("ERROR : could not start the thread of chain %d\n", (int) c);
+            this->launch.store(LAUNCH_ABORT, std::memory_order_release);
+            for (size_t k = 1; k < c; k++) {
+                this->executor->join(this->chains[k].thread);
+            }
+            for (size_t k = 0; k < this->chains.size(); k++) {
+                this->chains[k].bus->close();
+            }
+            return false;
+        }
+    }
+    this->launch.store(LAUNCH_RUN, std::memory_order_release);
+    this->running = true;
+
+    printf("%d chains, %d drives in total\n", (int) this->chains.size(), drives);
+    return true;
+}
+
+// function to request SYNC0, refused on more than one chain: the cycle only follows chain 0's reference clock and
+// the clocks of the other chains would drift away from it
+void ELMOBusMulti::enableSync0(uint32 cycle_ns, int32 shift_ns) {
+
+    if (this->chains.size() > 1) {
+        printf("ERROR : DC synchronous mode runs on a single chain only, %d configured\n", (int) this->chains.size());
+        this->dc_refused = true;
+        return;
+    }
+    this->chains[0].bus->enableSync0(cycle_ns, shift_ns);
+}
+
+// function to request the telemetry PDO on every chain
+void ELMOBusMulti::mapTelemetry(const TelemetryLayout &layout) {
+
+    for (size_t c = 0; c < this->chains.size(); c++) {
+        this->chains[c].bus->mapTelemetry(layout);
+    }
+}
+
+// function to walk every drive through the DS402 enable sequence, chain after chain
+void ELMOBusMulti::enableDrives() {
+
+    for (size_t c = 0; c < this->chains.size(); c++) {
+        this->chains[c].bus->enableDrives();
+    }
+}
+
+// function to stop and join the worker threads
+void ELMOBusMulti::stopWorkers() {
+
+    if (!this->running) {
+        return;
+    }
+
+    // release the workers once more with the stop flag set
+    this->stop = true;
+    this->start.wait();
+    for (size_t c = 1; c < this->chains.size(); c++) {
+        this->executor->join(this->chains[c].thread);
+    }
+    this->running = false;
+}
+
+// function to return every chain to INIT and release the ports
+void ELMOBusMulti::close() {
+
+    this->stopWorkers();
+    for (size_t c = 0; c < this->chains.size(); c++) {
+        this->chains[c].bus->close();
+    }
+}
+
+// number of drives on all chains
+int ELMOBusMulti::slaveCount() {
+    return (int) this->drive_chain.size();
+}
+
+// process data images of drive i, found on its chain
+ELMOIn *ELMOBusMulti::inputs(int i) {
+    Chain &chain = this->chains[this->drive_chain[i]];
+    return chain.bus->inputs(i - chain.first);
+}
+ELMOOut *ELMOBusMulti::outputs(int i) {
+    Chain &chain = this->chains[this->drive_chain[i]];
+    return chain.bus->outputs(i - chain.first);
+}
+const uint8 *ELMOBusMulti::telemetry(int i) {
+    Chain &chain = this->chains[this->drive_chain[i]];
+    return chain.bus->telemetry(i - chain.first);
+}
+
+// cyclic process data exchange, the workers send their chains at the same time as chain 0
+int ELMOBusMulti::sendProcessdata() {
+    this->start.wait();
+    return this->chains[0].bus->sendProcessdata();
+}
+int ELMOBusMulti::receiveProcessdata(int timeout) {
+
+    Chain &first = this->chains[0];
+    first.wkc.store(first.bus->receiveProcessdata(timeout), std::memory_order_relaxed);
+
+    // wait for the other chains, their working counters add up
+    this->done.wait();
+    int wkc = 0;
+    for (size_t c = 0; c < this->chains.size(); c++) {
+        wkc += this->chains[c].wkc.load(std::memory_order_relaxed);
+    }
+    return wkc;
+}
+
+// working counter of a complete exchange on all chains
+int ELMOBusMulti::expectedWKC() {
+
+    int wkc = 0;
+    for (size_t c = 0; c < this->chains.size(); c++) {
+        wkc += this->chains[c].bus->expectedWKC();
+    }
+    return wkc;
+}
+
+// distributed clock time of chain 0's reference clock
+int64 ELMOBusMulti::dcTime() {
+    return this->chains[0].bus->dcTime();
+}
+
+// function to check the drive states, only on the chains whose working counter is low
+int ELMOBusMulti::checkState(bool wkc_low, uint8 *health) {
+
+    int down = 0;
+    for (size_t c = 0; c < this->chains.size(); c++) {
+        Chain &chain = this->chains[c];
+        down += chain.bus->checkState(wkc_low && chain.wkc.load(std::memory_order_relaxed) < chain.bus->expectedWKC(), health + chain.first);
+    }
+    return down;
+}
+
+// acyclic SDO transfers, sent on the chain of drive i
+int ELMOBusMulti::sdoRead(int i, uint16 index, uint8 subindex, int *size, void *data, int timeout) {
+    Chain &chain = this->chains[this->drive_chain[i]];
+    return chain.bus->sdoRead(i - chain.first, index, subindex, size, data, timeout);
+}
+int ELMOBusMulti::sdoWrite(int i, uint16 index, uint8 subindex, int size, const void *data, int timeout) {
+    Chain &chain = this->chains[this->drive_chain[i]];
+    return chain.bus->sdoWrite(i - chain.first, index, subindex, size, data, timeout);
+}
@@ -0,0 +1,410 @@
+#include "../inc/ElmoBusSim.hpp"
+
+// constructor, sets up the drive model for the loop frequency
+ELMOBusSim::ELMOBusSim(SimConfig config, double freq) {
+
+    this->config = config;
+    this->dt = 1.0 / freq;
+    this->dc_start_ns = 0;
+    this->dc_epoch_ns = 0;
+    this->dc_time = 0;
+    this->t_sent = 0;
+    this->seed = 1;
+    this->docheck = false;
+}
+
+// function to create the simulated drives and put them in OPERATIONAL
+bool ELMOBusSim::open(const char* /* port */, uint8 opmode) {
+
+    if (this->config.drives <= 0) {
+        printf("No slaves found!\n");
+        return false;
+    }
+
+    // power up every drive in NOT READY (the atomic state cannot be moved, so the drives are built in place)
+    this->drives = std::vector<SimDrive>(this->config.drives);
+    for (int i = 0; i < this->config.drives; i++) {
+
+        SimDrive &drive = this->drives[i];
+        memset(&drive.in, 0, sizeof(drive.in));
+        memset(&drive.out, 0, sizeof(drive.out));
+        memset(&drive.latched, 0, sizeof(drive.latched));
+        drive.state.store(SIM_NOT_READY, std::memory_order_relaxed);
+        drive.last_controlword = 0;
+        drive.boot = SIM_BOOT_CYCLES;
+        drive.gear_ratio = (i < (int) this->config.gear_ratio.size()) ? this->config.gear_ratio[i] : 1.0;
+        drive.q = 0.0;
+        drive.qd = 0.0;
+        drive.temperature = SIM_AMBIENT;
+        memset(drive.telemetry, 0, sizeof(drive.telemetry));
+    }
+
+    // every drive starts in OPERATIONAL
+    this->al_state.reset(new std::atomic<uint16>[this->config.drives]);
+    for (int i = 0; i < this->config.drives; i++) {
+        this->al_state[i].store(EC_STATE_OPERATIONAL);
+    }
+    this->docheck = false;
+
+    // stored objects of the dictionary, the DS402 and error objects are derived from the drive state
+    std::lock_guard<std::mutex> lock(this->objects_lock);
+    this->objects.assign(this->config.drives, std::map<uint32, SimObject>());
+    for (int i = 0; i < this->config.drives; i++) {
+
+        std::map<uint32, SimObject> &od = this->objects[i];
+        od[0x606000] = {opmode, 1};    // modes of operation
+        od[0x10F102] = {0, 4};         // heartbeat
+        od[0x608300] = {1, 4};         // profile acceleration
+        od[0x608400] = {1, 4};         // profile deceleration
+        od[0x608500] = {1, 4};         // quick stop deceleration
+    }
+
+    // the reference clock starts at an arbitrary phase of the master clock
+    this->dc_start_ns = cycle_now_ns();
+    this->dc_epoch_ns = 123456789;
+    this->dc_time = this->dc_epoch_ns;
+
+    printf("%d simulated slaves found and configured (OpMode %d).\n", this->config.drives, opmode);
+    printf("Calculated workcounter %d\n", this->expectedWKC());
+    printf("Operational state reached for all slaves.\n");
+
+    return true;
+}
+
+// simulated drives sample on the frame, SYNC0 only changes where the frame lands on the reference clock
+void ELMOBusSim::enableSync0(uint32 /* cycle_ns */, int32 /* shift_ns */) {
+}
+
+// function to select the objects of the simulated telemetry PDO
+void ELMOBusSim::mapTelemetry(const TelemetryLayout &layout) {
+    this->telemetry_layout = layout;
+}
+
+// function to walk every drive through the DS402 enable sequence (stands in for the SDO writes)
+void ELMOBusSim::enableDrives() {
+
+    const uint16 sequence[4] = {0, 6, 7, 15};
+
+    for (int i = 0; i < (int) this->drives.size(); i++) {
+
+        SimDrive &drive = this->drives[i];
+        drive.boot = 0;
+        if (drive.state.load(std::memory_order_relaxed) == SIM_NOT_READY) {
+            drive.state.store(SIM_SWITCH_ON_DISABLED, std::memory_order_relaxed);
+        }
+
+        // fault reset, then 0 -> 6 -> 7 -> 15
+        if (drive.state.load(std::memory_order_relaxed) == SIM_FAULT) {
+            this->applyControlword(drive, 128);
+        }
+        for (int k = 0; k < 4; k++) {
+            this->applyControlword(drive, sequence[k]);
+        }
+        drive.in.status = drive.state.load(std::memory_order_relaxed);
+        printf("Slave: %d - simulated status word: 0x%04x\n", i + 1, drive.in.status);
+    }
+}
+
+// function to release the simulated drives
+void ELMOBusSim::close() {
+
+    printf("\nRequest init state for all slaves\n");
+    std::lock_guard<std::mutex> lock(this->objects_lock);
+    this->drives.clear();
+    this->objects.clear();
+}
+
+// number of simulated drives
+int ELMOBusSim::slaveCount() {
+    return (int) this->drives.size();
+}
+
+// process data images of drive i
+ELMOIn *ELMOBusSim::inputs(int i) {
+    return &this->drives[i].in;
+}
+ELMOOut *ELMOBusSim::outputs(int i) {
+    return &this->drives[i].out;
+}
+const uint8 *ELMOBusSim::telemetry(int i) {
+    return this->drives[i].telemetry;
+}
+
+// the drives see the outputs at the time the frame is sent
+int ELMOBusSim::sendProcessdata() {
+
+    // the frame picks up the reference clock, which runs dc_drift_ppm off the master clock
+    double elapsed = (double) (cycle_now_ns() - this->dc_start_ns);
+    this->dc_time = this->dc_epoch_ns + (int64) (elapsed * (1.0 + this->config.dc_drift_ppm * 1e-6));
+
+    for (size_t i = 0; i < this->drives.size(); i++) {
+        this->drives[i].latched = this->drives[i].out;
+    }
+    this->t_sent = cycle_now_ns();
+    return 1;
+}
+
+// run one period of every drive and return the inputs with the frame
+int ELMOBusSim::receiveProcessdata(int /* timeout */) {
+
+    // emulate the frame round trip, the frame left with the last send
+    int64_t until = this->t_sent + (int64_t) (this->config.roundtrip_us * 1e3);
+    int wkc = this->expectedWKC();
+    double p_drop = this->config.dropout_rate * this->dt;
+
+    for (size_t i = 0; i < this->drives.size(); i++) {
+
+        SimDrive &drive = this->drives[i];
+
+        // a drive dropping out goes to SAFE_OP + ERROR, from then on it neither takes the outputs nor fills
+        // the inputs until it is back in OPERATIONAL. Its DS402 state is kept
+        if (p_drop > 0.0 && this->al_state[i].load(std::memory_order_relaxed) == EC_STATE_OPERATIONAL &&
+            rand_r(&this->seed) < p_drop * RAND_MAX) {
+            this->al_state[i].store(EC_STATE_SAFE_OP + EC_STATE_ERROR, std::memory_order_relaxed);
+        }
+        if (this->al_state[i].load(std::memory_order_relaxed) != EC_STATE_OPERATIONAL) {
+            wkc -= DRIVE_WKC;
+            continue;
+        }
+
+        // drives leave NOT READY on their own after booting
+        if (drive.state.load(std::memory_order_relaxed) == SIM_NOT_READY && --drive.boot <= 0) {
+            drive.state.store(SIM_SWITCH_ON_DISABLED, std::memory_order_relaxed);
+        }
+
+        // DS402 state machine and torque loop
+        this->applyControlword(drive, drive.latched.controlword);
+        uint16 state = drive.state.load(std::memory_order_relaxed);
+        int16 torque = (state == SIM_OP_ENABLED) ? drive.latched.torque : 0;
+        this->stepDynamics(drive, torque);
+        this->fillTelemetry(drive, torque);
+
+        // fill the TxPDO image
+        double counts = drive.gear_ratio * this->config.cpr / (2.0 * M_PI);
+        drive.in.position = (int32_t) lround(drive.q * counts);
+        drive.in.velocity = (int32_t) lround(drive.qd * counts);
+        drive.in.inputs = 0;
+        drive.in.status = state;
+    }
+
+    while (cycle_now_ns() < until) {}
+
+    return wkc;
+}
+
+// every drive has inputs and outputs: 2 for the write and 1 for the read
+int ELMOBusSim::expectedWKC() {
+    return DRIVE_WKC * (int) this->drives.size();
+}
+
+// reference clock time carried by the last frame
+int64 ELMOBusSim::dcTime() {
+    return this->dc_time;
+}
+
+// function to check the drive states and bring dropped drives back, the same steps as SOEM: ack
+// SAFE_OP + ERROR, then request OPERATIONAL, one step per call
+int ELMOBusSim::checkState(bool wkc_low, uint8 *health) {
+
+    int down = 0;
+    for (size_t i = 0; i < this->drives.size(); i++) {
+        health[i] = DRIVE_OK;
+    }
+
+    if (!wkc_low && !this->docheck) {
+        return 0;
+    }
+
+    // AL status of every drive
+    usleep(SIM_AL_US);
+    this->docheck = false;
+    for (size_t i = 0; i < this->drives.size(); i++) {
+
+        uint16 state = this->al_state[i].load(std::memory_order_relaxed);
+        if (state == EC_STATE_OPERATIONAL) {
+            continue;
+        }
+        health[i] = DRIVE_DOWN;
+        down++;
+        this->docheck = true;
+
+        if (state == EC_STATE_SAFE_OP + EC_STATE_ERROR) {
+            printf("ERROR : slave %d is in SAFE_OP + ERROR, attempting ack.\n", (int) i + 1);
+            usleep(SIM_AL_US);
+            this->al_state[i].store(EC_STATE_SAFE_OP, std::memory_order_relaxed);
+        }
+        else if (state == EC_STATE_SAFE_OP) {
+            printf("WARNING : slave %d is in SAFE_OP, change to OPERATIONAL.\n", (int) i + 1);
+            usleep(SIM_AL_US);
+            this->al_state[i].store(EC_STATE_OPERATIONAL, std::memory_order_relaxed);
+        }
+    }
+
+    return down;
+}
+
+// SDO read from the simulated object dictionary, answers after the emulated firmware delay
+int ELMOBusSim::sdoRead(int i, uint16 index, uint8 subindex, int *size, void *data, int /* timeout */) {
+
+    usleep(SIM_MAILBOX_US);
+
+    std::lock_guard<std::mutex> lock(this->objects_lock);
+    if (i < 0 || i >= (int) this->objects.size()) {
+        return 0;
+    }
+
+    // objects derived from the DS402 state, the rest comes from the dictionary
+    uint16 state = this->drives[i].state.load(std::memory_order_relaxed);
+    SimObject object;
+    if (index == 0x6041 && subindex == 0) {
+        object = {state, 2};
+    }
+    else if (index == 0x1001 && subindex == 0) {
+        object = {(uint32) ((state == SIM_FAULT) ? 0x01 : 0x00), 1};
+    }
+    else if (index == 0x603F && subindex == 0) {
+        object = {(uint32) ((state == SIM_FAULT) ? SIM_FAULT_CODE : 0), 2};
+    }
+    else {
+        std::map<uint32, SimObject>::iterator it = this->objects[i].find(((uint32) index << 8) | subindex);
+        if (it == this->objects[i].end()) {
+            return 0;
+        }
+        object = it->second;
+    }
+
+    // the buffer has to hold the object
+    if (*size < object.size) {
+        return 0;
+    }
+    memcpy(data, &object.value, object.size);
+    *size = object.size;
+
+    return 1;
+}
+
+// SDO write to the simulated object dictionary, only existing stored objects are writable
+int ELMOBusSim::sdoWrite(int i, uint16 index, uint8 subindex, int size, const void *data, int /* timeout */) {
+
+    usleep(SIM_MAILBOX_US);
+
+    std::lock_guard<std::mutex> lock(this->objects_lock);
+    if (i < 0 || i >= (int) this->objects.size()) {
+        return 0;
+    }
+
+    std::map<uint32, SimObject>::iterator it = this->objects[i].find(((uint32) index << 8) | subindex);
+    if (it == this->objects[i].end() || size != it->second.size) {
+        return 0;
+    }
+    it->second.value = 0;
+    memcpy(&it->second.value, data, size);
+
+    return 1;
+}
+
+// function to apply a control word to the DS402 state machine of one drive
+void ELMOBusSim::applyControlword(SimDrive &drive, uint16 controlword) {
+
+    bool reset_edge = (controlword & 0x80) && !(drive.last_controlword & 0x80);
+    drive.last_controlword = controlword;
+
+    // disable voltage (bit 1 clear) from any powered state
+    bool disable_voltage = !(controlword & 0x02);
+    bool quick_stop = (controlword & 0x02) && !(controlword & 0x04);
+    uint16 cmd = controlword & 0x8F;
+
+    uint16 state = drive.state.load(std::memory_order_relaxed);
+    switch (state) {
+
+        case SIM_NOT_READY:
+            break;
+
+        case SIM_SWITCH_ON_DISABLED:
+            if ((controlword & 0x87) == 0x06) {
+                state = SIM_READY_SWITCH_ON;
+            }
+            break;
+
+        case SIM_READY_SWITCH_ON:
+            if (disable_voltage || quick_stop) {
+                state = SIM_SWITCH_ON_DISABLED;
+            }
+            else if (cmd == 0x07) {
+                state = SIM_SWITCHED_ON;
+            }
+            else if (cmd == 0x0F) {
+                state = SIM_OP_ENABLED;
+            }
+            break;
+
+        case SIM_SWITCHED_ON:
+            if (disable_voltage || quick_stop) {
+                state = SIM_SWITCH_ON_DISABLED;
+            }
+            else if ((controlword & 0x87) == 0x06) {
+                state = SIM_READY_SWITCH_ON;
+            }
+            else if (cmd == 0x0F) {
+                state = SIM_OP_ENABLED;
+            }
+            break;
+
+        case SIM_OP_ENABLED:
+            if (disable_voltage) {
+                state = SIM_SWITCH_ON_DISABLED;
+            }
+            else if (quick_stop) {
+                state = SIM_QUICK_STOP;
+            }
+            else if ((controlword & 0x87) == 0x06) {
+                state = SIM_READY_SWITCH_ON;
+            }
+            else if (cmd == 0x07) {
+                state = SIM_SWITCHED_ON;
+            }
+            break;
+
+        case SIM_QUICK_STOP:
+            if (disable_voltage) {
+                state = SIM_SWITCH_ON_DISABLED;
+            }
+            break;
+
+        case SIM_FAULT:
+            if (reset_edge) {
+                state = SIM_SWITCH_ON_DISABLED;
+            }
+            break;
+    }
+
+    drive.state.store(state, std::memory_order_relaxed);
+}
+
+// function to advance the motor + gear model of one drive by one period
+void ELMOBusSim::stepDynamics(SimDrive &drive, int16 torque) {
+
+    // torque command is in thousandths of the motor rated torque
+    double tau = torque / 1000.0 * this->config.rated_torque * drive.gear_ratio;
+
+    // joint side inertia with viscous damping, semi-implicit Euler
+    double qdd = (tau - this->config.damping * drive.qd) / this->config.inertia;
+    drive.qd += qdd * this->dt;
+    drive.q += drive.qd * this->dt;
+}
+
+// function to fill the telemetry PDO image of one drive, the current follows the torque (1/1000 rated)
+void ELMOBusSim::fillTelemetry(SimDrive &drive, int16 torque) {
+
+    // winding losses heat the drive towards its steady state temperature
+    double current = torque / 1000.0;
+    double steady = SIM_AMBIENT + SIM_TEMP_RISE * current * current;
+    drive.temperature += this->dt / SIM_THERMAL_TAU * (steady - drive.temperature);
+
+    const TelemetryLayout &layout = this->telemetry_layout;
+    layout.set(drive.telemetry, TELEM_CURRENT, torque);
+    layout.set(drive.telemetry, TELEM_DC_VOLTAGE, SIM_DC_VOLTAGE);
+    layout.set(drive.telemetry, TELEM_TEMPERATURE, (int32) lround(drive.temperature));
+    layout.set(drive.telemetry, TELEM_FOLLOWING_ERROR, 0);
+    layout.set(drive.telemetry, TELEM_TORQUE, torque);
+}
@@ -0,0 +1,464 @@
+#include "../inc/ElmoBusSoem.hpp"
+
+#define EC_TIMEOUTMON 500
+
+
+// **************************************************************************************************************************
+
+
+
+// Service Data Object (SDO) READ macro. 
+#define READ(slaveId, idx, sub, buf, comment)    \
+    {   \
+        buf=0;  \
+        int __s = sizeof(buf);    \
+        int __ret = ecx_SDOread(&this->context, slaveId, idx, sub, FALSE, &__s, &buf, EC_TIMEOUTRXM);   \
+        printf("Slave: %d - Read at 0x%04x:%d => wkc: %d; data: 0x%.*x (%d)\t[%s]\n", slaveId, idx, sub, __ret, __s,(unsigned int)buf, (unsigned int)buf, comment);    \
+    }
+
+// Service Data Object (SDO) WRITE macro
+#define WRITE(slaveId, idx, sub, buf, value, comment) \
+    {   \
+        int __s = sizeof(buf);  \
+        buf = value;    \
+        int __ret = ecx_SDOwrite(&this->context, slaveId, idx, sub, FALSE, __s, &buf, EC_TIMEOUTRXM);  \
+        printf("Slave: %d - Write at 0x%04x:%d => wkc: %d; data: 0x%.*x\t{%s}\n", slaveId, idx, sub, __ret, __s, (unsigned int)buf, comment);    \
+    }
+
+// Check for errors macro
+#define CHECKERROR(slaveId)   \
+{   \
+    ecx_readstate(&this->context);\
+    printf("EC> \"%s\" %x - %x [%s] \n", (char*)ecx_elist2string(&this->context), this->slave[slaveId].state, this->slave[slaveId].ALstatuscode, (char*)ec_ALstatuscode2string(this->slave[slaveId].ALstatuscode));    \
+}
+
+
+
+// **************************************************************************************************************************
+
+// constructor, points the SOEM context at the chain's own slave list, groups and buffers
+ELMOBusSoem::ELMOBusSoem() : expected_wkc(0), needlf(FALSE), currentgroup(0), sync0_cycle_ns(0), sync0_shift_ns(0) {
+
+    memset(&this->context, 0, sizeof(this->context));
+    this->slavecount = 0;
+    this->ecaterror = FALSE;
+    this->DCtime = 0;
+
+    this->context.port = &this->port;
+    this->context.slavelist = this->slave;
+    this->context.slavecount = &this->slavecount;
+    this->context.maxslave = EC_MAXSLAVE;
+    this->context.grouplist = this->group;
+    this->context.maxgroup = EC_MAXGROUP;
+    this->context.esibuf = this->esibuf;
+    this->context.esimap = this->esimap;
+    this->context.esislave = 0;
+    this->context.elist = &this->elist;
+    this->context.idxstack = &this->idxstack;
+    this->context.ecaterror = &this->ecaterror;
+    this->context.DCtime = &this->DCtime;
+    this->context.SMcommtype = this->SMcommtype;
+    this->context.PDOassign = this->PDOassign;
+    this->context.PDOdesc = this->PDOdesc;
+    this->context.eepSM = &this->eepSM;
+    this->context.eepFMMU = &this->eepFMMU;
+    this->context.manualstatechange = 0;
+}
+
+// function to find the drives, map the PDOs and bring the chain to OPERATIONAL
+bool ELMOBusSoem::open(const char* port, uint8 opmode) {
+
+    // useful variables
+    int i, chk;
+    uint32 buf32;
+    uint16 buf16;
+    uint8 buf8;
+    char ifname[1028];                  // ethernet port name container
+    strcpy(ifname, port);               // copy the port name to the container
+
+    /* initialise SOEM, bind socket to ifname */
+    if (!ecx_init(&this->context, ifname))
+    {
+        printf("No socket connection on %s\nExcecute as root\n",ifname);
+        return false;
+    }
+
+    // if we was able to bind the socket print success message
+    printf("ec_init on %s succeeded.\n",ifname);
+
+    /* find and auto-config slaves */
+
+    /** network discovery */
+    if ( ecx_config_init(&this->context, FALSE) <= 0 )
+    {
+        printf("No slaves found!\n");
+        printf("End simple test, close socket\n");
+
+        /* stop SOEM, close socket */
+        ecx_close(&this->context);
+        return false;
+    }
+
+    printf("%d slaves found and configured.\n", this->slavecount);
+
+    for (int i=1; i<=this->slavecount; i++) {
+        printf("Slave %d has CA? %s\n", i, this->slave[i].CoEdetails & ECT_COEDET_SDOCA ? "true":"false" );
+
+        /** CompleteAccess disabled for Elmo driver */
+        this->slave[i].CoEdetails ^= ECT_COEDET_SDOCA;
+    }
+    
+    ecx_statecheck(&this->context, 0, EC_STATE_PRE_OP,  EC_TIMEOUTSTATE);
+
+    /** opMode: 8   => Cyclic position 
+        opMode: 10  => Cyclic Synchronous Torque */
+    for (int i=1; i<=this->slavecount; i++) {
+
+        // Operation Mode
+        WRITE(i, 0x6060, 0, buf8, opmode, "OpMode"); // <--- TODO: resolve 
+                                                     // having to change this to 8 and then 10 to work
+
+        // Operation Mode Display
+        READ(i, 0x6061, 0, buf8, "OpMode display");
+
+        READ(i, 0x1c12, 0, buf32, "rxPDO:0");
+        READ(i, 0x1c13, 0, buf32, "txPDO:0");
+
+        READ(i, 0x1c12, 1, buf32, "rxPDO:1");
+        READ(i, 0x1c13, 1, buf32, "txPDO:1");
+    }
+    
+    /** set PDO mapping */
+    int32 ob2;int os;
+    for (int i=1; i<=this->slavecount; i++) {                
+
+        //  set to 'Target Torque'
+        os=sizeof(ob2); ob2 = 0x16020001;            
+        ecx_SDOwrite(&this->context, i, 0x1c12, 0, TRUE, os, &ob2, EC_TIMEOUTRXM);
+        
+        //  set to 'Position/Velocity Actual Values'
+        os=sizeof(ob2); ob2 = 0x1a030001;             
+        ecx_SDOwrite(&this->context, i, 0x1c13, 0, TRUE, os, &ob2, EC_TIMEOUTRXM);
+
+        //  telemetry objects in the flexible TxPDO, assigned after 'Position/Velocity Actual Values'
+        if (this->telemetry_layout.count() > 0) {
+
+            buf8 = 0;
+            ecx_SDOwrite(&this->context, i, TELEMETRY_PDO, 0, FALSE, sizeof(buf8), &buf8, EC_TIMEOUTRXM);
+            for (int k = 0; k < this->telemetry_layout.count(); k++) {
+                buf32 = this->telemetry_layout.mapping(k);
+                ecx_SDOwrite(&this->context, i, TELEMETRY_PDO, k + 1, FALSE, sizeof(buf32), &buf32, EC_TIMEOUTRXM);
+            }
+            buf8 = (uint8) this->telemetry_layout.count();
+            ecx_SDOwrite(&this->context, i, TELEMETRY_PDO, 0, FALSE, sizeof(buf8), &buf8, EC_TIMEOUTRXM);
+
+            uint16 txpdo[3] = {2, 0x1a03, TELEMETRY_PDO};
+            os=sizeof(txpdo);
+            ecx_SDOwrite(&this->context, i, 0x1c13, 0, TRUE, os, txpdo, EC_TIMEOUTRXM);
+        }
+
+        READ(i, 0x1c12, 0, buf32, "rxPDO:0");
+        READ(i, 0x1c13, 0, buf32, "txPDO:0");
+
+        READ(i, 0x1c12, 1, buf32, "rxPDO:1");
+        READ(i, 0x1c13, 1, buf32, "txPDO:1");
+    }
+    
+    /** if CA disable => automapping works */
+    ecx_config_map_group(&this->context, &this->IOmap, 0); 
+    ecx_configdc(&this->context); 
+
+    /** SYNC0 on every drive with a distributed clock, the drives sample and actuate on it */
+    if (this->sync0_cycle_ns > 0) {
+        for (int i=1; i<=this->slavecount; i++) {
+            if (this->slave[i].hasdc) {
+                ecx_dcsync0(&this->context, i, TRUE, this->sync0_cycle_ns, this->sync0_shift_ns);
+                printf("Slave: %d - SYNC0 every %u ns (shift %d ns)\n", i, this->sync0_cycle_ns, this->sync0_shift_ns);
+            }
+            else {
+                printf("WARNING : slave %d has no distributed clock, it stays free running\n", i);
+            }
+        }
+    }
+
+    // show slave info
+    for (int i=1; i<=this->slavecount; i++) {
+        printf("\nSlave:%d\n Name:%s\n Output size: %dbits\n Input size: %dbits\n State: %d\n Delay: %d[ns]\n Has DC: %d\n",
+        i, this->slave[i].name, this->slave[i].Obits, this->slave[i].Ibits,
+        this->slave[i].state, this->slave[i].pdelay, this->slave[i].hasdc);
+    }
+
+    /** disable heartbeat alarm */
+    for (int i=1; i<=this->slavecount; i++) {
+        READ(i, 0x10F1, 2, buf32, "Heartbeat?");
+        WRITE(i, 0x10F1, 2, buf32, 1, "Heartbeat");
+
+        WRITE(i, 0x60c2, 1, buf8, 2, "Time period");
+        WRITE(i, 0x2f75, 0, buf16, 2, "Interpolation timeout");
+    }           
+
+    printf("Slaves mapped, state to SAFE_OP.\n");
+
+    /* wait for all slaves to reach SAFE_OP state */
+    ecx_statecheck(&this->context, 0, EC_STATE_SAFE_OP,  EC_TIMEOUTSTATE * 4);
+
+    printf("segments : %d : %d %d %d %d\n",this->group[0].nsegments ,this->group[0].IOsegment[0],this->group[0].IOsegment[1],this->group[0].IOsegment[2],this->group[0].IOsegment[3]);
+
+    printf("Request operational state for all slaves\n");
+    this->expected_wkc = (this->group[0].outputsWKC * 2) + this->group[0].inputsWKC;
+    printf("Calculated workcounter %d\n", this->expected_wkc);
+
+    /** going operational */
+    this->slave[0].state = EC_STATE_OPERATIONAL;
+
+    /* send one valid process data to make outputs in slaves happy*/
+    ecx_send_processdata(&this->context);
+    ecx_receive_processdata(&this->context, EC_TIMEOUTRET);
+
+    // see what the max and min acceleration and deceleration values are set to
+    for (int i=1; i<=this->slavecount; i++) {
+        READ(i, 0x6083, 0, buf32, "Profile acceleration");    // read and it says (1)
+        READ(i, 0x6084, 0, buf32, "Profile deceleration");    // read and it says (1)
+        READ(i, 0x6085, 0, buf32, "Quick stop deceleration"); // read and it says (1)
+    }
+    
+    /* request OP state for all slaves */
+    ecx_writestate(&this->context, 0);
+    chk = 40;
+    
+    /* wait for all slaves to reach OP state */
+    do
+    {
+        ecx_send_processdata(&this->context);
+        ecx_receive_processdata(&this->context, EC_TIMEOUTRET);
+        ecx_statecheck(&this->context, 0, EC_STATE_OPERATIONAL, 50000);
+    }
+    while (chk-- && (this->slave[0].state != EC_STATE_OPERATIONAL));
+
+    if (this->slave[0].state == EC_STATE_OPERATIONAL )
+    {
+        printf("Operational state reached for all slaves.\n");
+        return true;
+    }
+
+    printf("Not all slaves reached operational state.\n");
+    ecx_readstate(&this->context);
+    for(i = 1; i<=this->slavecount ; i++)
+    {
+        if(this->slave[i].state != EC_STATE_OPERATIONAL)
+        {
+            printf("Slave %d State=0x%2.2x StatusCode=0x%4.4x : %s\n",
+                i, this->slave[i].state, this->slave[i].ALstatuscode, ec_ALstatuscode2string(this->slave[i].ALstatuscode));
+        }
+    }
+
+    // release the chain
+    this->close();
+    return false;
+}
+
+// function to request the telemetry PDO on every drive, applied when the chain is opened
+void ELMOBusSoem::mapTelemetry(const TelemetryLayout &layout) {
+    this->telemetry_layout = layout;
+}
+
+// function to request SYNC0 on every drive, applied when the chain is opened
+void ELMOBusSoem::enableSync0(uint32 cycle_ns, int32 shift_ns) {
+    this->sync0_cycle_ns = cycle_ns;
+    this->sync0_shift_ns = shift_ns;
+}
+
+// function to walk every drive through the DS402 enable sequence
+void ELMOBusSoem::enableDrives() {
+
+    uint16 buf16;
+    uint8 buf8;
+
+    /**
+     * Drive state machine transitions
+     *   0 -> 6 -> 7 -> 15
+     */
+    for (int i=1; i<=this->slavecount; i++) {
+        READ(i, 0x6041, 0, buf16, "*status word*");
+        if(buf16 == 0x218)
+        {
+            WRITE(i, 0x6040, 0, buf16, 128, "*control word*"); usleep(100000);
+            READ(i, 0x6041, 0, buf16, "*status word*");
+        }
+
+        WRITE(i, 0x6040, 0, buf16, 0, "*control word*"); usleep(100000);
+        READ(i, 0x6041, 0, buf16, "*status word*"); 
+
+        WRITE(i, 0x6040, 0, buf16, 6, "*control word*"); usleep(100000);
+        READ(i, 0x6041, 0, buf16, "*status word*"); 
+
+        WRITE(i, 0x6040, 0, buf16, 7, "*control word*"); usleep(100000);
+        READ(i, 0x6041, 0, buf16, "*status word*"); 
+
+        WRITE(i, 0x6040, 0, buf16, 15, "*control word*"); usleep(100000);
+        READ(i, 0x6041, 0, buf16, "*status word*"); 
+
+        CHECKERROR(i);
+        READ(i, 0x1a0b, 0, buf8, "OpMode Display");
+
+        READ(i, 0x1001, 0, buf8, "Error");
+    }   
+}
+
+// function to request INIT on all drives after the heartbeat is turned back on
+void ELMOBusSoem::requestInit() {
+
+    uint32 buf32;
+
+    printf("\nRequest init state for all slaves\n");
+    for (int i=1; i<=this->slavecount; i++) {
+        WRITE(i, 0x10F1, 2, buf32, 0, "Heartbeat");
+    }
+   
+    this->slave[0].state = EC_STATE_INIT;
+    /* request INIT state for all slaves */
+    ecx_writestate(&this->context, 0);
+}
+
+// function to return the chain to INIT and release the port
+void ELMOBusSoem::close() {
+
+    this->requestInit();
+    printf("End simple test, close socket\n");
+    
+    /* stop SOEM, close socket */
+    ecx_close(&this->context);
+}
+
+// number of drives found on the chain
+int ELMOBusSoem::slaveCount() {
+    return this->slavecount;
+}
+
+// process data images of drive i, "i+1" b/c slaves are 1-indexed
+ELMOIn *ELMOBusSoem::inputs(int i) {
+    return (struct ELMOIn *)(this->slave[i+1].inputs);
+}
+ELMOOut *ELMOBusSoem::outputs(int i) {
+    return (struct ELMOOut *)(this->slave[i+1].outputs);
+}
+
+// telemetry PDO image of drive i, right after its 0x1A03 image
+const uint8 *ELMOBusSoem::telemetry(int i) {
+    return this->slave[i+1].inputs + TXPDO_BYTES;
+}
+
+// cyclic process data exchange
+int ELMOBusSoem::sendProcessdata() {
+    return ecx_send_processdata(&this->context);
+}
+int ELMOBusSoem::receiveProcessdata(int timeout) {
+    this->needlf = TRUE;
+    return ecx_receive_processdata(&this->context, timeout);
+}
+
+// working counter of a complete exchange
+int ELMOBusSoem::expectedWKC() {
+    return this->expected_wkc;
+}
+
+// distributed clock time of the reference clock, updated by every frame
+int64 ELMOBusSoem::dcTime() {
+    return this->DCtime;
+}
+
+// function to check the drive states and recover lost drives
+int ELMOBusSoem::checkState(bool wkc_low, uint8 *health) {
+
+    int slave;
+    int down = 0;
+
+    for (slave = 1; slave <= this->slavecount; slave++)
+    {
+       health[slave - 1] = DRIVE_OK;
+    }
+
+    if (wkc_low || this->group[this->currentgroup].docheckstate)
+    {
+        if (this->needlf)
+        {
+           this->needlf = FALSE;
+           printf("\n");
+        }
+        /* one ore more slaves are not responding */
+        this->group[this->currentgroup].docheckstate = FALSE;
+        ecx_readstate(&this->context);
+        for (slave = 1; slave <= this->slavecount; slave++)
+        {
+           /* state as read, before the recovery below changes it */
+           if (this->slave[slave].group == this->currentgroup &&
+               (this->slave[slave].islost || this->slave[slave].state != EC_STATE_OPERATIONAL))
+           {
+              health[slave - 1] = (this->slave[slave].islost || !this->slave[slave].state) ? DRIVE_LOST : DRIVE_DOWN;
+              down++;
+           }
+           if ((this->slave[slave].group == this->currentgroup) && (this->slave[slave].state != EC_STATE_OPERATIONAL))
+           {
+              this->group[this->currentgroup].docheckstate = TRUE;
+              if (this->slave[slave].state == (EC_STATE_SAFE_OP + EC_STATE_ERROR))
+              {
+                 printf("ERROR : slave %d is in SAFE_OP + ERROR, attempting ack.\n", slave);
+                 this->slave[slave].state = (EC_STATE_SAFE_OP + EC_STATE_ACK);
+                 ecx_writestate(&this->context, slave);
+              }
+              else if(this->slave[slave].state == EC_STATE_SAFE_OP)
+              {
+                printf("WARNING : slave %d is in SAFE_OP, change to OPERATIONAL.\n", slave);
+                this->slave[slave].state = EC_STATE_OPERATIONAL;
+                ecx_writestate(&this->context, slave);
+              }
+              else if(this->slave[slave].state > 0)
+              {
+                 if (ecx_reconfig_slave(&this->context, slave, EC_TIMEOUTMON))
+                 {
+                    this->slave[slave].islost = FALSE;
+                    printf("MESSAGE : slave %d reconfigured\n",slave);
+                 }
+              }
+              else if(!this->slave[slave].islost)
+              {
+                 /* re-check state */
+                 ecx_statecheck(&this->context, slave, EC_STATE_OPERATIONAL, EC_TIMEOUTRET);
+                 if (!this->slave[slave].state)
+                 {
+                    this->slave[slave].islost = TRUE;
+                    printf("ERROR : slave %d lost\n",slave);
+                 }
+              }
+           }
+           if (this->slave[slave].islost)
+           {
+              if(!this->slave[slave].state)
+              {
+                 if (ecx_recover_slave(&this->context, slave, EC_TIMEOUTMON))
+                 {
+                    this->slave[slave].islost = FALSE;
+                    printf("MESSAGE : slave %d recovered\n",slave);
+                 }
+              }
+              else
+              {
+                 this->slave[slave].islost = FALSE;
+                 printf("MESSAGE : slave %d found\n",slave);
+              }
+           }
+        }
+        if(!this->group[this->currentgroup].docheckstate)
+           printf(".");
+    }
+
+    return down;
+}
+
+// acyclic SDO transfers, "i+1" b/c slaves are 1-indexed. SOEM serializes the frames of the two threads on the port
+int ELMOBusSoem::sdoRead(int i, uint16 index, uint8 subindex, int *size, void *data, int timeout) {
+    return ecx_SDOread(&this->context, i + 1, index, subindex, FALSE, size, data, timeout);
+}
+int ELMOBusSoem::sdoWrite(int i, uint16 index, uint8 subindex, int size, const void *data, int timeout) {
+    return ecx_SDOwrite(&this->context, i + 1, index, subindex, FALSE, size, data, timeout);
+}
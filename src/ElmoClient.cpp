@@ -0,0 +1,204 @@
+#include "../inc/ElmoClient.hpp"
+
+// function to attach to the daemon's segment
+bool ELMOClient::attach(const char *name, double timeout) {
+
+    if (this->shm != NULL) {
+        return true;
+    }
+
+    // wait for the daemon and its bus
+    int64 t_end = cycle_now_ns() + (int64) (timeout * 1e9);
+    while (true) {
+        this->shm = shmAttach(name);
+        if (this->shm != NULL && this->shm->online.load(std::memory_order_acquire) == 1) {
+            break;
+        }
+        shmDetach(this->shm);
+        this->shm = NULL;
+        if (cycle_now_ns() >= t_end) {
+            printf("ERROR : no bus daemon on %s\n", name);
+            return false;
+        }
+        usleep(10000);
+    }
+
+    // claim the segment, a client that is gone is taken over (a live one we may not signal is not gone)
+    pid_t me = getpid();
+    pid_t owner = 0;
+    while (!this->shm->client.compare_exchange_strong(owner, me)) {
+        if (owner == me || kill(owner, 0) == 0 || errno != ESRCH) {
+            printf("ERROR : the bus daemon on %s is in use by process %d\n", name, (int) owner);
+            shmDetach(this->shm);
+            this->shm = NULL;
+            return false;
+        }
+    }
+    this->shm->attached.store(cycle_now_ns(), std::memory_order_release);
+    this->shm->attaches.fetch_add(1, std::memory_order_relaxed);
+
+    // size the snapshots for the drives on the chain
+    this->shm->state.read(this->snapshot);
+    this->shm->telemetry.read(this->telemetry);
+    if (this->snapshot.drives() < LegJointMap::drives()) {
+        printf("ERROR : the joint map needs %d drives, %d found on the chain\n", LegJointMap::drives(), this->snapshot.drives());
+        this->detach();
+        return false;
+    }
+
+    return true;
+}
+
+// function to hand the drives back to zero torque and release the segment
+void ELMOClient::detach() {
+
+    if (this->shm == NULL) {
+        return;
+    }
+
+    // without a client the daemon holds zero torque from its next cycle on
+    pid_t me = getpid();
+    this->shm->client.compare_exchange_strong(me, 0);
+    shmDetach(this->shm);
+    this->shm = NULL;
+}
+
+// function to keep the current command alive without sending a new one
+void ELMOClient::heartbeat() {
+
+    if (this->shm == NULL) {
+        return;
+    }
+
+    this->shm->heartbeat.store(cycle_now_ns(), std::memory_order_release);
+}
+
+// function to set the low level control gains
+void ELMOClient::setGains(JointGains gains) {
+
+    // set the gains
+    this->gains = gains;
+}
+
+// function to set the joint limits
+void ELMOClient::setLimits(JointLimits limits) {
+
+    // set the limits
+    this->limits = limits;
+}
+
+// function to get a consistent snapshot of all drives (daisy chain order)
+const ELMOState &ELMOClient::getState() {
+
+    // copy the newest snapshot the daemon's comm thread put in the segment into the preallocated one,
+    // detached the last one stays
+    if (this->shm != NULL) {
+        this->shm->state.read(this->snapshot);
+    }
+
+    return this->snapshot;
+}
+
+// function to get the newest telemetry of all drives
+const ELMOTelemetry &ELMOClient::getTelemetry() {
+
+    if (this->shm != NULL) {
+        this->shm->telemetry.read(this->telemetry);
+    }
+
+    return this->telemetry;
+}
+
+// function to get the ELMO status (reordered)
+ELMOStatus ELMOClient::getELMOStatus() {
+
+    // take one snapshot so all drives come from the same bus cycle
+    return jointStatus(this->getState());
+}
+
+// function to get the raw encoder data from ELMO
+JointVec ELMOClient::getEncoderData() {
+
+    // take one snapshot so all drives come from the same bus cycle
+    return jointEncoders(this->getState());
+}
+
+// function to compute the torque command
+JointTorque ELMOClient::computeTorque(JointVec joint_ref, JointTorque tau_ff) {
+
+    // get the current joint state
+    JointVec joint_data = this->getEncoderData();
+
+    // saturation, PD + feedforward and limit masking of all joints in one pass
+    int saturated, tripped;
+    JointTorque tau = jointPD(this->gains, this->limits, joint_ref, tau_ff, joint_data, saturated, tripped);
+
+    // only report joints that just went out of bounds
+    reportJoints(saturated, tripped, this->ref_saturated, this->joint_tripped);
+
+    // return the torque vector
+    return tau;
+}
+
+// function to get the command buffer of the segment
+ShmCommand &ELMOClient::beginCommand(int mode) {
+
+    ShmCommand &command = this->shm->command.writeBuffer();
+    command.head.mode = mode;
+
+    return command;
+}
+
+// function to stamp and publish the command, it is also the heartbeat
+void ELMOClient::endCommand(ShmCommand &command) {
+
+    int64 now = cycle_now_ns();
+    command.head.seq = this->shm->seq.fetch_add(1, std::memory_order_relaxed) + 1;
+    command.head.timestamp = now;
+    command.setpoint.seq = command.head.seq;
+    command.setpoint.timestamp = now;
+    this->shm->command.publish();
+    this->shm->heartbeat.store(now, std::memory_order_release);
+}
+
+// function to send target torque to the ELMO
+void ELMOClient::sendTorque(JointTorque torque) {
+
+    if (this->shm == NULL) {
+        printf("ERROR : the client is not attached to a bus daemon\n");
+        return;
+    }
+
+    // fill the command with the torques in daisy chain order and publish all drives at once
+    ShmCommand &command = this->beginCommand(SHM_TORQUE);
+    LegJointMap::toChain(torque.data(), command.drive, &DriveCommand::torque);
+    this->endCommand(command);
+}
+
+// function to stream a setpoint to the daemon's in-cycle PD law
+void ELMOClient::sendSetpoint(JointVec joint_ref, JointTorque tau_ff) {
+
+    if (this->shm == NULL) {
+        printf("ERROR : the client is not attached to a bus daemon\n");
+        return;
+    }
+
+    // fill the setpoint and publish it, the daemon's comm thread picks it up in its next cycle
+    ShmCommand &command = this->beginCommand(SHM_SETPOINT);
+    JointSetpoint &setpoint = command.setpoint;
+    setpoint.q_ref = joint_ref.head<NUM_JOINTS>().array();
+    setpoint.qd_ref = joint_ref.tail<NUM_JOINTS>().array();
+    setpoint.tau_ff = tau_ff.array();
+    setpoint.gains = this->gains;
+    this->endCommand(command);
+
+    // only report joints that just went out of bounds in the bus cycle
+    int saturated = this->shm->saturated.load(std::memory_order_relaxed);
+    int tripped = this->shm->tripped.load(std::memory_order_relaxed);
+    reportJoints(saturated, tripped, this->ref_saturated, this->joint_tripped);
+}
+
+// function to get the torques sent to the drives in the newest snapshot
+JointTorque ELMOClient::getTorque() {
+    return jointTorques(this->getState());
+}
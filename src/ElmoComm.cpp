@@ -1,4 +1,5 @@
 #include "../inc/ElmoComm.hpp"
+#include "../inc/ElmoRecorder.hpp"
 
 /* ELMO order of joints (physical daisy chain order)
   1. HFL  (Hip Frontal Left)
@@ -9,57 +10,89 @@
   6. KR   (Knee Right)
 */ 
 
-#define EC_TIMEOUTMON 500
+// **************************************************************************************************************************
 
-char IOmap[4096];
-int expectedWKC;
-boolean needlf;
-volatile int wkc;
-boolean inOP;
-uint8 currentgroup = 0;
+// function to bring all drives to OPERATION ENABLED in parallel through the control word PDO
+static bool enableDrivesPDO(ELMOBus *bus, ELMOData *data_pointer) {
 
+    int slavecount = bus->slaveCount();
+    int64 timeout_ns = (int64) (data_pointer->enable.timeout * 1e9);
+    int expectedWKC = bus->expectedWKC();
 
-// **************************************************************************************************************************
+    // time each drive reached OPERATION ENABLED (-1 while it has not) and its last status word
+    std::vector<int64> t_enabled(slavecount, -1);
+    std::vector<uint16> last_status(slavecount, 0);
+    int enabled = 0;
 
+    printf("Enabling %d drives through the control word PDO\n", slavecount);
 
-// Service Data Object (SDO) READ macro. 
-#define READ(slaveId, idx, sub, buf, comment)    \
-    {   \
-        buf=0;  \
-        int __s = sizeof(buf);    \
-        int __ret = ec_SDOread(slaveId, idx, sub, FALSE, &__s, &buf, EC_TIMEOUTRXM);   \
-        printf("Slave: %d - Read at 0x%04x:%d => wkc: %d; data: 0x%.*x (%d)\t[%s]\n", slaveId, idx, sub, __ret, __s,(unsigned int)buf, (unsigned int)buf, comment);    \
+    // start from "disable voltage" with zero torque
+    for (int i = 0; i < slavecount; i++) {
+        bus->outputs(i)->torque = 0;
+        bus->outputs(i)->controlword = 0;
     }
 
-// Service Data Object (SDO) WRITE macro
-#define WRITE(slaveId, idx, sub, buf, value, comment) \
-    {   \
-        int __s = sizeof(buf);  \
-        buf = value;    \
-        int __ret = ec_SDOwrite(slaveId, idx, sub, FALSE, __s, &buf, EC_TIMEOUTRXM);  \
-        printf("Slave: %d - Write at 0x%04x:%d => wkc: %d; data: 0x%.*x\t{%s}\n", slaveId, idx, sub, __ret, __s, (unsigned int)buf, comment);    \
+    // exchange at the loop frequency until every drive is enabled or the timeout expires
+    CycleScheduler scheduler;
+    scheduler.init(data_pointer->freq, data_pointer->cycle);
+    int64 t_start = cycle_now_ns();
+
+    while (enabled < slavecount && cycle_now_ns() - t_start < timeout_ns) {
+
+        scheduler.wait();
+        bus->sendProcessdata();
+        int wkc = bus->receiveProcessdata(EC_TIMEOUTRET);
+        int64 t_recv = cycle_now_ns();
+
+        // status words are only valid with a complete exchange
+        if (wkc < expectedWKC) {
+            continue;
+        }
+
+        for (int i = 0; i < slavecount; i++) {
+
+            ELMOIn *in = bus->inputs(i);
+            ELMOOut *out = bus->outputs(i);
+            const ds402_entry_t *entry = ds402_lookup(in->status);
+            last_status[i] = in->status;
+
+            // each drive advances as soon as its status word confirms the last transition
+            if (entry->state == DS402_FAULT) {
+                // fault reset on the rising edge of bit 7
+                out->controlword = (out->controlword & 0x80) ? 0 : 0x80;
+            }
+            else {
+                out->controlword = entry->controlword;
+            }
+            out->torque = 0;
+
+            if (entry->state == DS402_OP_ENABLED && t_enabled[i] < 0) {
+                t_enabled[i] = t_recv - t_start;
+                enabled++;
+            }
+        }
     }
 
-// Check for errors macro
-#define CHECKERROR(slaveId)   \
-{   \
-    ec_readstate();\
-    printf("EC> \"%s\" %x - %x [%s] \n", (char*)ec_elist2string(), ec_slave[slaveId].state, ec_slave[slaveId].ALstatuscode, (char*)ec_ALstatuscode2string(ec_slave[slaveId].ALstatuscode));    \
-}
+    // report every drive
+    for (int i = 0; i < slavecount; i++) {
 
+        if (t_enabled[i] >= 0) {
+            printf("Slave: %d - OPERATION ENABLED after %.1f ms (status word 0x%04x)\n", 
+                   i + 1, t_enabled[i] * 1e-6, last_status[i]);
+        }
+        else {
+            printf("ERROR : slave %d did not reach OPERATION ENABLED within %.0f ms, drive is %s (status word 0x%04x)\n",
+                   i + 1, data_pointer->enable.timeout * 1e3, ds402_state_name(ds402_lookup(last_status[i])->state), last_status[i]);
+        }
+    }
 
-// **************************************************************************************************************************
+    return enabled == slavecount;
+}
 
 // ELMO communication function. Setup and stream data
 void *ELMOcommunication(void *data) {
 
     // useful variables
-    int i, chk;
-    needlf = FALSE;
-    inOP = FALSE;
-    uint32 buf32;
-    uint16 buf16;
-    uint8 buf8;
     ELMOData * data_pointer;
 
     // Funky pointer stuff to cast void* data correctly
@@ -67,457 +100,391 @@ void *ELMOcommunication(void *data) {
     char ifname[1028];                  // ethernet port name container
     strcpy(ifname,data_pointer->port);  // copy the port name to the container
 
-    // ELMO structs
-    struct ELMOIn *val[6];              // ELMO --> Laptop
-    struct ELMOOut *target[6];          // Laptop --> ELMO
-    
+    // EtherCAT chain backend (SOEM or simulated)
+    ELMOBus *bus = data_pointer->bus;
+
     printf("Starting ELMO communication\n");
 
-    /* initialise SOEM, bind socket to ifname */
-    if (ec_init(ifname))
-    {
-        // if we was able to bind the socket print success message
-        printf("ec_init on %s succeeded.\n",ifname);
+    /* drives sample and actuate on SYNC0 of their distributed clock in DC synchronous mode */
+    if (data_pointer->cycle.mode == CYCLE_DC_SYNC) {
+        bus->enableSync0((uint32) (1e9 / data_pointer->freq), 0);
+    }
 
-        /* find and auto-config slaves */
+    /* extra objects mapped after 0x1A03, read every cycle but handed to the app every few cycles */
+    TelemetryLayout telemetry(data_pointer->telemetry_config);
+    bus->mapTelemetry(telemetry);
 
-        /** network discovery */
-        if ( ec_config_init(FALSE) > 0 )
-        {
-            printf("%d slaves found and configured.\n", ec_slavecount);
+    /* find the drives, map the PDOs and bring the chain to OPERATIONAL */
+    if (!bus->open(ifname, data_pointer->OpMode))
+    {
+        data_pointer->mailbox.stop();
+        data_pointer->health.stop();
+        data_pointer->commStatus = -1;
+        return NULL;
+    }
 
-            for (int i=1; i<=ec_slavecount; i++) {
-                printf("Slave %d has CA? %s\n", i, ec_slave[i].CoEdetails & ECT_COEDET_SDOCA ? "true":"false" );
+    /* the drive count comes from the chain, a configured count has to match it */
+    int slavecount = bus->slaveCount();
+    if (data_pointer->drives > 0 && slavecount != data_pointer->drives) {
+        printf("ERROR : %d drives found on the chain, the configuration expects %d\n", slavecount, data_pointer->drives);
+        bus->close();
+        data_pointer->mailbox.stop();
+        data_pointer->health.stop();
+        data_pointer->commStatus = -1;
+        return NULL;
+    }
 
-                /** CompleteAccess disabled for Elmo driver */
-                ec_slave[i].CoEdetails ^= ECT_COEDET_SDOCA;
-            }
-            
-            ec_statecheck(0, EC_STATE_PRE_OP,  EC_TIMEOUTSTATE);
+    // working counter of a complete exchange
+    int expectedWKC = bus->expectedWKC();
 
-            /** opMode: 8   => Cyclic position 
-                opMode: 10  => Cyclic Synchronous Torque */
-            uint8 opmode = data_pointer->OpMode;
-            for (int i=1; i<=ec_slavecount; i++) {
+    /* Drive state machine transitions 0 -> 6 -> 7 -> 15 */
+    if (data_pointer->enable.mode == ENABLE_PDO) {
 
-                // Operation Mode
-                WRITE(i, 0x6060, 0, buf8, opmode, "OpMode"); // <--- TODO: resolve 
-                                                             // having to change this to 8 and then 10 to work
+        // all drives in parallel through the control word PDO
+        if (!enableDrivesPDO(bus, data_pointer)) {
+            bus->close();
+            data_pointer->mailbox.stop();
+            data_pointer->health.stop();
+            data_pointer->commStatus = -1;
+            return NULL;
+        }
+    }
+    else {
 
-                // Operation Mode Display
-                READ(i, 0x6061, 0, buf8, "OpMode display");
+        // one drive after the other through SDO writes
+        bus->enableDrives();
+    }
 
-                READ(i, 0x1c12, 0, buf32, "rxPDO:0");
-                READ(i, 0x1c13, 0, buf32, "txPDO:0");
+    // per drive storage, allocated once here so the main loop never allocates
+    std::vector<ELMOIn *> val(slavecount);       // ELMO --> Laptop
+    std::vector<ELMOOut *> target(slavecount);   // Laptop --> ELMO
+    std::vector<const uint8 *> telem(slavecount); // telemetry PDO images, ELMO --> Laptop
+
+    // size the state and command channels for the drives found
+    ELMOState state_init = {};
+    state_init.drive.resize(slavecount);
+    data_pointer->state.init(state_init);
+    ELMOCommand command_init = {};
+    command_init.drive.resize(slavecount);
+    data_pointer->command.init(command_init);
+    ELMOTelemetry telemetry_init = {};
+    telemetry_init.drive.resize(slavecount);
+    data_pointer->telemetry.init(telemetry_init);
+
+    // torque law run in the bus cycle, NULL streams the app's torque commands
+    CycleController *controller = data_pointer->controller;
+    if (controller != NULL) {
+        controller->init(slavecount);
+    }
 
-                READ(i, 0x1c12, 1, buf32, "rxPDO:1");
-                READ(i, 0x1c13, 1, buf32, "txPDO:1");
-            }
-            
-            /** set PDO mapping */
-            int32 ob2;int os;
-            for (int i=1; i<=ec_slavecount; i++) {                
-
-                //  set to 'Target Torque'
-                os=sizeof(ob2); ob2 = 0x16020001;            
-                ec_SDOwrite(i, 0x1c12, 0, TRUE, os, &ob2, EC_TIMEOUTRXM);
-                
-                //  set to 'Position/Velocity Actual Values'
-                os=sizeof(ob2); ob2 = 0x1a030001;             
-                ec_SDOwrite(i, 0x1c13, 0, TRUE, os, &ob2, EC_TIMEOUTRXM);
-
-                READ(i, 0x1c12, 0, buf32, "rxPDO:0");
-                READ(i, 0x1c13, 0, buf32, "txPDO:0");
-
-                READ(i, 0x1c12, 1, buf32, "rxPDO:1");
-                READ(i, 0x1c13, 1, buf32, "txPDO:1");
-            }
-            
-            /** if CA disable => automapping works */
-            ec_config_map(&IOmap); 
-            ec_configdc(); 
-
-            // show slave info
-            for (int i=1; i<=ec_slavecount; i++) {
-                printf("\nSlave:%d\n Name:%s\n Output size: %dbits\n Input size: %dbits\n State: %d\n Delay: %d[ns]\n Has DC: %d\n",
-                i, ec_slave[i].name, ec_slave[i].Obits, ec_slave[i].Ibits,
-                ec_slave[i].state, ec_slave[i].pdelay, ec_slave[i].hasdc);
-            }
+    // flight recorder, its ring is allocated here for the drives found
+    ELMORecorder *recorder = data_pointer->recorder;
+    if (recorder != NULL && !recorder->init(slavecount, data_pointer->executor)) {
+        recorder = NULL;
+    }
 
-            /** disable heartbeat alarm */
-            for (int i=1; i<=ec_slavecount; i++) {
-                READ(i, 0x10F1, 2, buf32, "Heartbeat?");
-                WRITE(i, 0x10F1, 2, buf32, 1, "Heartbeat");
+    // drives in FAULT / OPERATION ENABLED and working counter in the last cycle, events fire on the transitions.
+    // The status word of a drive that lost its inputs is stale, so it is not known to be enabled after that
+    std::vector<char> in_fault(slavecount, 0);
+    std::vector<char> enabled(slavecount, 1);
+    bool wkc_low = false;
+
+    // drives whose inputs were not refreshed in this cycle, and their loss accounting
+    std::vector<char> lost(slavecount, 0);
+    LinkStats &link = data_pointer->link;
+    link.init(slavecount, data_pointer->freq);
+    bool degraded_mode = data_pointer->degraded;
+
+    // working counter of the current loss and the receive time it was first seen with, a state check has to
+    // start after that before the loss is put on the drives it names
+    int wkc_loss = -1;
+    int64 t_loss = 0;
+
+    // assign the ElmoIn and ElmoOut structs to each ELMO motor controller
+    for (int j = 0; j < slavecount; j++) {
+
+      target[j] = bus->outputs(j); // data struct to send to ELMO    
+      val[j] = bus->inputs(j);     // data struct to receive from ELMO
+      telem[j] = bus->telemetry(j);
+    }
 
-                WRITE(i, 0x60c2, 1, buf8, 2, "Time period");
-                WRITE(i, 0x2f75, 0, buf16, 2, "Interpolation timeout");
-            }           
+    // telemetry is decoded only in the cycles it is handed to the app
+    int decimation = std::max(data_pointer->telemetry_config.decimation, 1);
+    bool publish_telemetry = (telemetry.count() > 0);
 
-            printf("Slaves mapped, state to SAFE_OP.\n");
+    //----------------------------------------- MAIN LOOP ------------------------------------------
 
-            /* wait for all slaves to reach SAFE_OP state */
-            ec_statecheck(0, EC_STATE_SAFE_OP,  EC_TIMEOUTSTATE * 4);
+    // SDO requests and state checks go out from here on, in the windows this loop opens
+    ELMOHealth &health = data_pointer->health;
+    data_pointer->window.init(data_pointer->freq, CYCLE_WINDOW);
+    data_pointer->mailbox.start(bus, &data_pointer->window, data_pointer->executor);
+    health.start(bus, &data_pointer->window, slavecount);
 
-            printf("segments : %d : %d %d %d %d\n",ec_group[0].nsegments ,ec_group[0].IOsegment[0],ec_group[0].IOsegment[1],ec_group[0].IOsegment[2],ec_group[0].IOsegment[3]);
+    // set the communication status to operating
+    data_pointer->commStatus = 1;
 
-            printf("Request operational state for all slaves\n");
-            expectedWKC = (ec_group[0].outputsWKC * 2) + ec_group[0].inputsWKC;
-            printf("Calculated workcounter %d\n", expectedWKC);
+    // cycle scheduler for maintaining the loop frequency
+    CycleScheduler scheduler;
+    scheduler.init(data_pointer->freq, data_pointer->cycle);
 
-            /** going operational */
-            ec_slave[0].state = EC_STATE_OPERATIONAL;
+    // phase controller that locks the wakeups to the distributed clock
+    DCSync dcsync;
+    dcsync.init(data_pointer->freq, data_pointer->cycle);
+    bool dc_sync = (data_pointer->cycle.mode == CYCLE_DC_SYNC);
 
-            /* send one valid process data to make outputs in slaves happy*/
-            ec_send_processdata();
-            ec_receive_processdata(EC_TIMEOUTRET);
+    // cycle timing instrumentation
+    CycleStats &stats = data_pointer->stats;
+    int64 t_prev = 0, t_io, t_recv;
 
-            // see what the max and min acceleration and deceleration values are set to
-            for (int i=1; i<=ec_slavecount; i++) {
-                READ(i, 0x6083, 0, buf32, "Profile acceleration");    // read and it says (1)
-                READ(i, 0x6084, 0, buf32, "Profile deceleration");    // read and it says (1)
-                READ(i, 0x6085, 0, buf32, "Quick stop deceleration"); // read and it says (1)
-            }
-            
-            /* request OP state for all slaves */
-            ec_writestate(0);
-            chk = 40;
-            
-            /* wait for all slaves to reach OP state */
-            do
-            {
-                ec_send_processdata();
-                ec_receive_processdata(EC_TIMEOUTRET);
-                ec_statecheck(0, EC_STATE_OPERATIONAL, 50000);
-            }
-            while (chk-- && (ec_slave[0].state != EC_STATE_OPERATIONAL));
+    // frame in flight: its send time and the deadline of the cycle that sent it (-1: not from a cycle)
+    int64 t_sent = 0, sent_deadline = -1;
 
-            if (ec_slave[0].state == EC_STATE_OPERATIONAL )
-            {
-                printf("Operational state reached for all slaves.\n");
-                inOP = TRUE;
+    // pipelined cycles receive the frame sent at the end of the previous cycle, prime the pipeline
+    bool pipeline = (data_pointer->cycle.pipeline == PIPELINE_ON);
+    if (pipeline) {
+        t_sent = cycle_now_ns();
+        bus->sendProcessdata();
+    }
 
-                /**
-                 * Drive state machine transitions
-                 *   0 -> 6 -> 7 -> 15
-                 */
-                for (int i=1; i<=ec_slavecount; i++) {
-                    READ(i, 0x6041, 0, buf16, "*status word*");
-                    if(buf16 == 0x218)
-                    {
-                        WRITE(i, 0x6040, 0, buf16, 128, "*control word*"); usleep(100000);
-                        READ(i, 0x6041, 0, buf16, "*status word*");
-                    }
+    // main loop
+    while(1) {
 
-                    WRITE(i, 0x6040, 0, buf16, 0, "*control word*"); usleep(100000);
-                    READ(i, 0x6041, 0, buf16, "*status word*"); 
+        // check if the motor state is switched ot off
+        if (data_pointer->motor_control_switch == false) {
+            break;
+        }
 
-                    WRITE(i, 0x6040, 0, buf16, 6, "*control word*"); usleep(100000);
-                    READ(i, 0x6041, 0, buf16, "*status word*"); 
+        // wait until the next cycle is due
+        scheduler.wait();
 
-                    WRITE(i, 0x6040, 0, buf16, 7, "*control word*"); usleep(100000);
-                    READ(i, 0x6041, 0, buf16, "*status word*"); 
+        // record the cycle period and wakeup latency
+        if (t_prev != 0) {
+            stats.period.record(scheduler.wakeup_ns - t_prev);
+        }
+        t_prev = scheduler.wakeup_ns;
+        stats.wakeup.record(scheduler.wakeup_ns - scheduler.deadline_ns);
+        stats.overruns.store(scheduler.overruns, std::memory_order_relaxed);
+        stats.skipped.store(scheduler.skipped, std::memory_order_relaxed);
+
+        /** PDO I/O refresh, pipelined cycles only collect the frame sent at the end of the last cycle */
+        t_io = cycle_now_ns();
+        if (!pipeline) {
+            t_sent = t_io;
+            sent_deadline = scheduler.deadline_ns;
+            bus->sendProcessdata();
+        }
+        int wkc = bus->receiveProcessdata(EC_TIMEOUTRET);
+        t_recv = cycle_now_ns();
+        int64 t_blocked = t_recv - t_io;
+        if (sent_deadline >= 0) {
+            stats.roundtrip.record(t_recv - t_sent);
+        }
+
+        // a working counter drop freezes the flight recorder and wakes the health monitor, the inputs of some
+        // or all drives are stale
+        uint32 record_events = 0;
+        bool complete = (wkc >= expectedWKC);
+        if (!complete) {
+            record_events = wkc_low ? RECORD_STALE : (RECORD_STALE | RECORD_WKC);
+            if (!wkc_low) {
+                health.post(HEALTH_WKC_LOW, -1, scheduler.cycles, t_recv, wkc);
+            }
+        }
+        else if (wkc_low) {
+            health.post(HEALTH_WKC_OK, -1, scheduler.cycles, t_recv, wkc);
+        }
+        wkc_low = !complete;
+
+        // degraded mode: a partial frame whose missing working counter the drives named down by the health
+        // monitor account for, the other drives exchanged and run on. The frame carries no per drive working
+        // counter, so the names only count once a state check (AL status of every drive) started after the
+        // loss took its current size. Until then, and for any other loss, every drive is stale
+        bool degraded = false;
+        if (complete) {
+            std::fill(lost.begin(), lost.end(), 0);
+            wkc_loss = -1;
+        }
+        else {
+            if (wkc != wkc_loss) {
+                wkc_loss = wkc;
+                t_loss = t_recv;
+            }
+            int named = 0;
+            if (degraded_mode && wkc > 0 && health.checked() > t_loss) {
+                for (int j = 0; j < slavecount; j++) {
+                    lost[j] = health.down(j);
+                    named += lost[j];
+                }
+            }
+            degraded = (named > 0 && expectedWKC - wkc <= named * DRIVE_WKC);
+            if (!degraded) {
+                std::fill(lost.begin(), lost.end(), 1);
+            }
+        }
+        link.update(wkc, expectedWKC, degraded, lost.data());
+
+        // publish a consistent snapshot of all drives for this cycle, drives that lost their inputs keep their
+        // last values and count how stale they are
+        ELMOState &state = data_pointer->state.beginWrite();
+        state.head.cycle = scheduler.cycles;
+        state.head.timestamp = t_recv;
+        DriveState *drive = state.drive.data();
+        for (int j = 0; j < slavecount; j++) {
+
+            const ELMOIn *in = val[j];
+            const ELMOOut *out = target[j];
+
+            // update torque and control word sent to ELMO
+            drive[j].torque = out->torque;
+            drive[j].controlword = out->controlword;
+
+            if (lost[j]) {
+                drive[j].stale += (drive[j].stale < 0xFFFF);
+                enabled[j] = 0;
+                continue;
+            }
+            drive[j].stale = 0;
 
-                    WRITE(i, 0x6040, 0, buf16, 15, "*control word*"); usleep(100000);
-                    READ(i, 0x6041, 0, buf16, "*status word*"); 
+            // update encoder data
+            drive[j].pos = in->position;  
+            drive[j].vel = in->velocity;
 
-                    CHECKERROR(i);
-                    READ(i, 0x1a0b, 0, buf8, "OpMode Display");
+            // update diagnostic data
+            drive[j].inputs = in->inputs;
+            drive[j].statusword = in->status;
+        }
+        data_pointer->state.endWrite();
 
-                    READ(i, 0x1001, 0, buf8, "Error");
-                }   
+        if (complete || degraded) {
 
-                // assign the ElmoIn and ElmoOut structs to each ELMO motor controller
-                /* cyclic loop for all slaves, "j+1" b/c slaves are 1-indexed*/
-                for (int j = 0; j <ec_slavecount; j++) {
+            // steer the next wakeup to a fixed offset before SYNC0, the frame DC time is taken 
+            // back to the deadline of the cycle that sent it so wakeup jitter does not move the time grid
+            if (dc_sync && complete && sent_deadline >= 0) {
+                scheduler.adjust(dcsync.update(bus->dcTime() - (t_sent - sent_deadline)));
+                stats.dc_offset.record(std::abs(dcsync.offset_ns));
+                stats.dc_offset_ns.store(dcsync.offset_ns, std::memory_order_relaxed);
+                stats.dc_drift_ppb.store((int64) (dcsync.drift_ppm * 1e3), std::memory_order_relaxed);
+            }
 
-                  target[j] = (struct ELMOOut *)(ec_slave[j+1].outputs); // data struct to send to ELMO    
-                  val[j] = (struct ELMOIn *)(ec_slave[j+1].inputs);      // data struct to receive from ELMO
+            // decimated telemetry, decoded straight out of the process data image
+            if (publish_telemetry && scheduler.cycles % decimation == 0) {
+                ELMOTelemetry &frame = data_pointer->telemetry.writeBuffer();
+                frame.head.cycle = scheduler.cycles;
+                frame.head.timestamp = t_recv;
+                for (int j = 0; j < slavecount; j++) {
+                    telemetry.decode(telem[j], frame.drive[j]);
                 }
+                data_pointer->telemetry.publish();
+            }
+
+            // torque from the in-cycle controller on the fresh snapshot, or the newest app command
+            const ELMOCommand &command = (controller != NULL) ? controller->update(state) 
+                                                               : data_pointer->command.read();
 
-                //----------------------------------------- MAIN LOOP ------------------------------------------
-
-                // set the communication status to operating
-                data_pointer->commStatus = 1;
-
-                // for maintaining the loop frequency
-                auto t1 = std::chrono::high_resolution_clock::now();
-                double dt = 0.0;
-
-                // main loop
-                while(1) {
-
-                    // check if the motor state is switched ot off
-                    if (data_pointer->motor_control_switch == false) {
-                        break;
-                    }
-
-                    // for maintaining the loop frequency
-                    auto t2 = std::chrono::high_resolution_clock::now();
-                    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1);
-                    dt = duration.count() / 1'000'000.0; // convert to seconds
-                    
-                    // execute this block of code every 1/freq seconds
-                    if (dt >= (1.0 / data_pointer->freq)) {
-
-                        // update the time
-                        t1 = t2;
-
-                        /** PDO I/O refresh */
-                        ec_send_processdata();
-                        wkc = ec_receive_processdata(EC_TIMEOUTRET);
-
-                        if(wkc >= expectedWKC) {
-
-                            // update the data pointer with newest ELMO encoder data
-                            for (int j = 0; j < ec_slavecount; j++) {
-
-                                // update torque sent to ELMO
-                                data_pointer->torque[j] = target[j]->torque;
-                                
-                                // update encoder data
-                                data_pointer->pos[j] = val[j]->position;  
-                                data_pointer->vel[j] = val[j]->velocity;
-
-                                // update diagnostic data
-                                data_pointer->inputs[j] = val[j]->inputs;
-                                data_pointer->controlword[j] = target[j]->controlword; 
-                                data_pointer->statusword[j] = val[j]->status;
-                            }
-                            
-                            // std::cout << "-----------------------------------" << std::endl;
-                            
-                            for (int i = 0; i < ec_slavecount; i++)  {        
-
-                                // Do it for the first elmo slave
-                                uint16_t ctrlWord_tmp = 0;
-                                uint16 statusWord = val[i]->status;
-                                // std::cout << "\nStatus "<< i+1 <<": " << statusWord << std::endl;
-
-                                if(!((statusWord >> 0) & 1) && !((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && !((statusWord >> 6) & 1)){    
-                                    // NOT READY
-                                    // std::cout << "Drive " << i+1 <<" NOT ready." << std::endl;
-                                    target[i]->torque = (int16) 0;
-                                } 
-                                else if (!((statusWord >> 0) & 1) && !((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 6) & 1)){
-                                    // SOD
-                                    // std::cout << "Drive " << i+1 << " is in SOD." << std::endl;
-                                    ctrlWord_tmp = (1 << 1) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 2) | ctrlWord_tmp;    
-                                    target[i]->controlword = ctrlWord_tmp; 
-                                    // std::cout << "Control word: " << target[i]->controlword << std::endl;
-                                    target[i]->torque = (int16) 0;
-                                }
-                                else if (((statusWord >> 0) & 1) && !((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)) {
-                                    // RSO
-                                    // std::cout << "Drive " << i+1 << " is in RSO." << std::endl;
-                                    ctrlWord_tmp = (1 << 0) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 1) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 2) | ctrlWord_tmp; 
-                                    target[i]->controlword = ctrlWord_tmp; 
-                                    // std::cout << "Control word: " << target[i]->controlword << std::endl;
-                                    target[i]->torque = (int16) 0;
-                                }
-                                else if (((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)) {
-                                    // SO
-                                    // std::cout << "Drive " << i+1 << " in SO." << std::endl;
-                                    ctrlWord_tmp = (1 << 0) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 1) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 2) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 3) | ctrlWord_tmp; 
-                                    target[i]->controlword = ctrlWord_tmp;
-                                    // std::cout << "Control word: " << target[i]->controlword << std::endl;
-                                    target[i]->torque = (int16) 0;
-                                }
-                                else if (((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && ((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)) {
-                                    // ARMED
-                                    // std::cout << "Drive " << i+1 << " ARMED." << std::endl;
-                                    ctrlWord_tmp = (1 << 0) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 1) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 2) | ctrlWord_tmp; 
-                                    ctrlWord_tmp = (1 << 3) | ctrlWord_tmp;
-                                    target[i]->controlword = ctrlWord_tmp;
-                                    // std::cout << "Control word: " << target[i]->controlword << std::endl;
-
-                                    // Apply the desired torque
-                                    target[i]->torque = data_pointer->torque[i];
-                                }
-                                else if (((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && ((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && !((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)){
-                                    // FAILED
-                                    // std::cout << "Drive " << i+1 << " QUICK STOPPED." << std::endl;
-                                    target[i]->torque = (int16) 0;
-                                }
-                                else if (((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && ((statusWord >> 2) & 1) && ((statusWord >> 3) & 1) && !((statusWord >> 6) & 1)){
-                                    // FAILED
-                                    // std::cout << "Drive " << i+1 << " FAILED: fault reaction active." << std::endl;
-                                    target[i]->torque = (int16) 0;
-                                }
-                                else if (!((statusWord >> 0) & 1) && !((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && ((statusWord >> 3) & 1) && !((statusWord >> 6) & 1)){
-                                    // FAILED
-                                    // std::cout << "Drive " << i+1 << " FAILED: fault." << std::endl;
-                                    target[i]->torque = (int16) 0;
-                                }
-                                else{
-                                    // unknown state
-                                    // std::cout << "Drive " << i+1 << " FAILED: unknown state." << std::endl;
-                                    target[i]->torque = (int16) 0;
-                                }
-
-                                // send the control word to the ELMO based on what status word was read
-                                target[i]->controlword = ctrlWord_tmp;
-                            }
-                        }
-                        needlf = TRUE;
-                    }
-                    // usleep(10);
+            for (int j = 0; j < slavecount; j++) {
+
+                // a drive that lost its inputs is held at zero torque, its control word is left as it is
+                if (lost[j]) {
+                    target[j]->torque = 0;
+                    continue;
                 }
 
-                //----------------------------------------- SHUTDOWN ------------------------------------------
-                
-                std::cout << "-----------------------------------" << std::endl;
-                
-                if (data_pointer->motor_control_switch == false) {
-                    
-                    // send zero torque and status word to all motors
-                    for (int i=0; i<ec_slavecount; i++) {
-                        target[i]->torque = (int16) 0;
-                        target[i]->controlword = 0;
-                    }
-                    usleep(500);
-
-                    // check the status of the motors
-                    for (int i=0; i<ec_slavecount; i++) {
-
-                        uint16 statusWord = val[i]->status;
-                        std::cout << "\nStatus " << i+1 <<": " << statusWord << std::endl;
-
-                        if (((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && ((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)) {
-                            // SHUTDOWN
-                            std::cout << "Drive " << i+1 << " is SHUTDOWN." << std::endl;
-                        }
-                        else {
-                            // NOT ARMED
-                            std::cout << "Drive " << i+1 << " was not ARMED." << std::endl;
-                        }
-                    }
+                // DS402 state machine: next control word and torque enable
+                const ds402_entry_t *entry = ds402_lookup(drive[j].statusword);
+
+                // a drive entering FAULT freezes the flight recorder, the health monitor times how long it is out
+                char fault = (entry->state == DS402_FAULT);
+                if (fault && !in_fault[j]) {
+                    record_events |= RECORD_FAULT;
+                    health.post(HEALTH_DRIVE_FAULT, j, scheduler.cycles, t_recv, wkc);
                 }
-                
-                inOP = FALSE;
-            }
-            else
-            {
-                printf("Not all slaves reached operational state.\n");
-                ec_readstate();
-                for(i = 1; i<=ec_slavecount ; i++)
-                {
-                    if(ec_slave[i].state != EC_STATE_OPERATIONAL)
-                    {
-                        printf("Slave %d State=0x%2.2x StatusCode=0x%4.4x : %s\n",
-                            i, ec_slave[i].state, ec_slave[i].ALstatuscode, ec_ALstatuscode2string(ec_slave[i].ALstatuscode));
-                    }
+                in_fault[j] = fault;
+                char on = (entry->state == DS402_OP_ENABLED);
+                if (on && !enabled[j]) {
+                    health.post(HEALTH_DRIVE_ENABLED, j, scheduler.cycles, t_recv, wkc);
                 }
-            }
+                enabled[j] = on;
+
+                // apply the desired torque only to ARMED drives
+                target[j]->torque = entry->enable ? command.drive[j].torque : (int16) 0;
 
-            printf("\nRequest init state for all slaves\n");
-            for (int i=1; i<=ec_slavecount; i++) {
-                WRITE(i, 0x10F1, 2, buf32, 0, "Heartbeat");
+                // send the control word to the ELMO based on what status word was read
+                target[j]->controlword = entry->controlword;
             }
-           
-            ec_slave[0].state = EC_STATE_INIT;
-            /* request INIT state for all slaves */
-            ec_writestate(0);
         }
-        else
-        {
-            printf("No slaves found!\n");
+
+        // one record of this cycle's frame
+        if (recorder != NULL) {
+            RecordHead head = {scheduler.cycles, scheduler.deadline_ns, t_recv, (int32) wkc, record_events};
+            recorder->record(head, drive);
         }
-        printf("End simple test, close socket\n");
-        
-        /* stop SOEM, close socket */
-        ec_close();
-        data_pointer->commStatus = -1;
+
+        // record the data update and state machine time
+        int64 t_done = cycle_now_ns();
+        stats.processing.record(t_done - t_recv);
+
+        // pipelined: the outputs leave right away and the frame travels while the thread sleeps
+        if (pipeline) {
+            t_sent = t_done;
+            sent_deadline = scheduler.deadline_ns;
+            bus->sendProcessdata();
+            t_blocked += cycle_now_ns() - t_done;
+        }
+        stats.io.record(t_blocked);
+
+        // the cycle's frame is out, mailbox transfers and state checks may start behind it
+        data_pointer->window.open(scheduler.deadline_ns);
     }
-    else
-    {
-        printf("No socket connection on %s\nExcecute as root\n",ifname);
+
+    // no more windows, finish the running transfer and state check and cancel the rest
+    data_pointer->mailbox.stop();
+    health.stop();
+
+    // write a recording the loop stopped in the middle of
+    if (recorder != NULL) {
+        recorder->finish();
     }
-}
 
-// **************************************************************************************************************************
+    // collect the frame still in flight
+    if (pipeline) {
+        bus->receiveProcessdata(EC_TIMEOUTRET);
+    }
 
+    //----------------------------------------- SHUTDOWN ------------------------------------------
+    
+    std::cout << "-----------------------------------" << std::endl;
+
+    printf("Cycles: %llu\n", (unsigned long long) scheduler.cycles);
+    
+    if (data_pointer->motor_control_switch == false) {
+        
+        // send zero torque and status word to all motors
+        for (int i=0; i<slavecount; i++) {
+            target[i]->torque = (int16) 0;
+            target[i]->controlword = 0;
+        }
+        usleep(500);
 
-// callback function to check for ethercat comm errors
-void *ecatcheck(void* why) {
+        // check the status of the motors
+        for (int i=0; i<slavecount; i++) {
 
-    int slave;
+            uint16 statusWord = val[i]->status;
+            std::cout << "\nStatus " << i+1 <<": " << statusWord << std::endl;
 
-    while(1)
-    {
-        if( inOP && ((wkc < expectedWKC) || ec_group[currentgroup].docheckstate))
-        {
-            if (needlf)
-            {
-               needlf = FALSE;
-               printf("\n");
+            if (ds402_lookup(statusWord)->state == DS402_OP_ENABLED) {
+                // SHUTDOWN
+                std::cout << "Drive " << i+1 << " is SHUTDOWN." << std::endl;
             }
-            /* one ore more slaves are not responding */
-            ec_group[currentgroup].docheckstate = FALSE;
-            ec_readstate();
-            for (slave = 1; slave <= ec_slavecount; slave++)
-            {
-               if ((ec_slave[slave].group == currentgroup) && (ec_slave[slave].state != EC_STATE_OPERATIONAL))
-               {
-                  ec_group[currentgroup].docheckstate = TRUE;
-                  if (ec_slave[slave].state == (EC_STATE_SAFE_OP + EC_STATE_ERROR))
-                  {
-                     printf("ERROR : slave %d is in SAFE_OP + ERROR, attempting ack.\n", slave);
-                     ec_slave[slave].state = (EC_STATE_SAFE_OP + EC_STATE_ACK);
-                     ec_writestate(slave);
-                  }
-                  else if(ec_slave[slave].state == EC_STATE_SAFE_OP)
-                  {
-                    printf("WARNING : slave %d is in SAFE_OP, change to OPERATIONAL.\n", slave);
-                    ec_slave[slave].state = EC_STATE_OPERATIONAL;
-                    ec_writestate(slave);
-                  }
-                  else if(ec_slave[slave].state > 0)
-                  {
-                     if (ec_reconfig_slave(slave, EC_TIMEOUTMON))
-                     {
-                        ec_slave[slave].islost = FALSE;
-                        printf("MESSAGE : slave %d reconfigured\n",slave);
-                     }
-                  }
-                  else if(!ec_slave[slave].islost)
-                  {
-                     /* re-check state */
-                     ec_statecheck(slave, EC_STATE_OPERATIONAL, EC_TIMEOUTRET);
-                     if (!ec_slave[slave].state)
-                     {
-                        ec_slave[slave].islost = TRUE;
-                        printf("ERROR : slave %d lost\n",slave);
-                     }
-                  }
-               }
-               if (ec_slave[slave].islost)
-               {
-                  if(!ec_slave[slave].state)
-                  {
-                     if (ec_recover_slave(slave, EC_TIMEOUTMON))
-                     {
-                        ec_slave[slave].islost = FALSE;
-                        printf("MESSAGE : slave %d recovered\n",slave);
-                     }
-                  }
-                  else
-                  {
-                     ec_slave[slave].islost = FALSE;
-                     printf("MESSAGE : slave %d found\n",slave);
-                  }
-               }
+            else {
+                // NOT ARMED
+                std::cout << "Drive " << i+1 << " was not ARMED." << std::endl;
             }
-            if(!ec_group[currentgroup].docheckstate)
-               printf(".");
         }
-        usleep(1000);
     }
+
+    /* return the chain to INIT and release the port */
+    bus->close();
+    data_pointer->commStatus = -1;
+
+    return NULL;
 }
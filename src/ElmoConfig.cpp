@@ -0,0 +1,168 @@
+#include "../inc/ElmoConfig.hpp"
+
+// Other imports
+#include <yaml-cpp/yaml.h>
+
+// function to load the configuration file
+ELMOConfig loadConfig(const std::string &file) {
+
+    // instantiate yaml config object
+    YAML::Node config = YAML::LoadFile(file);
+    ELMOConfig params;
+
+    // load in the config parameters
+    params.port = config["ethernet"].as<std::string>();
+
+    // operation mode (TODO: fix bug, need to start at 8 then go to 10)
+    params.opmode = (uint8) config["OpMode"].as<int>();
+
+    // operating frequency
+    params.freq = config["frequency"].as<double>();
+
+    // cycle scheduler configuration
+    CycleConfig &cycle = params.cycle;
+    std::string cycle_mode = config["cycle"]["mode"].as<std::string>();
+    std::string cycle_catchup = config["cycle"]["catchup"].as<std::string>();
+    cycle.mode = (cycle_mode == "dc")       ? CYCLE_DC_SYNC
+               : (cycle_mode == "deadline") ? CYCLE_ABS_DEADLINE
+               : CYCLE_BUSY_POLL;
+    cycle.spin_us = config["cycle"]["spin_us"].as<double>();
+    cycle.catchup = (cycle_catchup == "burst")  ? CATCHUP_BURST
+                  : (cycle_catchup == "resync") ? CATCHUP_RESYNC
+                  : CATCHUP_SKIP;
+    cycle.max_burst = config["cycle"]["max_burst"].as<int>();
+    cycle.dc_lead_us = config["cycle"]["dc_lead_us"].as<double>();
+    cycle.dc_kp = config["cycle"]["dc_kp"].as<double>();
+    cycle.dc_ki = config["cycle"]["dc_ki"].as<double>();
+    cycle.pipeline = config["cycle"]["pipeline"].as<bool>() ? PIPELINE_ON : PIPELINE_OFF;
+
+    // drive enable sequence
+    std::string enable_mode = config["enable"]["mode"].as<std::string>();
+    params.enable.mode = (enable_mode == "pdo") ? ENABLE_PDO : ENABLE_SDO;
+    params.enable.timeout = config["enable"]["timeout"].as<double>();
+
+    // where the joint torques are computed and how fast the app loop runs
+    std::string control_mode = config["control"]["mode"].as<std::string>();
+    params.control = (control_mode == "cycle_pd") ? CONTROL_CYCLE_PD : CONTROL_APP;
+    params.app_freq = config["control"]["frequency"].as<double>();
+
+    // interpolation of the streamed setpoints to the bus rate ("cycle_pd" mode)
+    InterpConfig &interp = params.interp;
+    std::string interp_mode = config["control"]["interp"].as<std::string>();
+    interp.mode = (interp_mode == "hermite") ? INTERP_HERMITE : (interp_mode == "linear") ? INTERP_LINEAR : INTERP_ZOH;
+    interp.delay_us = config["control"]["delay_us"].as<double>();
+    interp.horizon_us = config["control"]["horizon_us"].as<double>();
+    std::string fallback = config["control"]["fallback"].as<std::string>();
+    interp.fallback = (fallback == "damp") ? FALLBACK_DAMP : FALLBACK_HOLD;
+
+    // number of drives expected on the chain (0 accepts any)
+    params.drives = config["drives"].as<int>();
+
+    // EtherCAT backend, real drives or simulated ones
+    BusConfig &bus = params.bus;
+    std::string bus_type = config["bus"]["type"].as<std::string>();
+    bus.type = (bus_type == "sim") ? BUS_SIM : BUS_SOEM;
+    bus.degraded = config["bus"]["degraded"].as<bool>();
+    bus.sim.drives = config["bus"]["sim"]["drives"].as<int>();
+    bus.sim.gear_ratio = config["bus"]["sim"]["gear_ratio"].as<std::vector<double>>();
+    bus.sim.cpr = config["bus"]["sim"]["cpr"].as<double>();
+    bus.sim.rated_torque = config["bus"]["sim"]["rated_torque"].as<double>();
+    bus.sim.inertia = config["bus"]["sim"]["inertia"].as<double>();
+    bus.sim.damping = config["bus"]["sim"]["damping"].as<double>();
+    bus.sim.roundtrip_us = config["bus"]["sim"]["roundtrip_us"].as<double>();
+    bus.sim.dc_drift_ppm = config["bus"]["sim"]["dc_drift_ppm"].as<double>();
+    bus.sim.dropout_rate = config["bus"]["sim"]["dropout_rate"].as<double>();
+
+    // drives split over several ports, one chain per port
+    for (const YAML::Node &node : config["bus"]["chains"]) {
+        ChainConfig chain;
+        chain.port = node["port"].as<std::string>();
+        chain.cpu = node["cpu"].as<int>();
+        chain.drives = node["drives"].as<int>();
+        bus.chains.push_back(chain);
+    }
+
+    // only chain 0's reference clock is steered, the clocks of the other chains would run free
+    if (cycle.mode == CYCLE_DC_SYNC && bus.chains.size() > 1) {
+        throw YAML::Exception(config["bus"]["chains"].Mark(), "cycle mode \"dc\" runs on a single chain only");
+    }
+
+    // telemetry PDO objects read every bus cycle, handed to the app every few cycles
+    for (const YAML::Node &node : config["telemetry"]["objects"]) {
+        int object = telemetryObject(node.as<std::string>());
+        if (object < 0) {
+            printf("WARNING : unknown telemetry object %s\n", node.as<std::string>().c_str());
+            continue;
+        }
+        params.telemetry.objects.push_back(object);
+    }
+    params.telemetry.decimation = config["telemetry"]["decimation"].as<int>();
+
+    // flight recorder of the last seconds of process data, written on a fault, a WKC drop or a limit violation
+    RecorderConfig &recorder = params.recorder;
+    recorder.enabled = config["recorder"]["enabled"].as<bool>();
+    recorder.window_s = config["recorder"]["window"].as<double>();
+    recorder.post_s = config["recorder"]["post"].as<double>();
+    recorder.dir = "../data";
+
+    // drive diagnostics polled through the mailbox while the loop runs (0 turns it off)
+    params.diag_rate = config["diagnostics"]["rate"].as<double>();
+
+    // real-time scheduling of every thread and memory locking
+    ExecutorConfig &realtime = params.realtime;
+    realtime.lock_memory = config["realtime"]["lock_memory"].as<bool>();
+    realtime.prefault_stack_kb = config["realtime"]["prefault_stack_kb"].as<int>();
+    realtime.prefault_heap_mb = config["realtime"]["prefault_heap_mb"].as<int>();
+    const char *role_keys[ROLE_COUNT] = {"bus", "check", "logger", "app"};
+    for (int r = 0; r < ROLE_COUNT; r++) {
+        const YAML::Node &node = config["realtime"]["threads"][role_keys[r]];
+        realtime.role[r].policy = schedPolicy(node["policy"].as<std::string>().c_str());
+        realtime.role[r].priority = node["priority"].as<int>();
+        realtime.role[r].cpu = node["cpu"].as<int>();
+    }
+
+    // bus daemon shared memory and client heartbeat timeout
+    params.daemon.name = config["daemon"]["name"].as<std::string>();
+    params.daemon.heartbeat_s = config["daemon"]["heartbeat_ms"].as<double>() * 1e-3;
+
+    // joint references of the app loop: a generator or a trajectory file, joint order
+    TrajectoryConfig &trajectory = params.trajectory;
+    std::string trajectory_type = config["trajectory"]["type"].as<std::string>();
+    trajectory.type = (trajectory_type == "file")  ? TRAJ_FILE
+                    : (trajectory_type == "step")  ? TRAJ_STEP
+                    : (trajectory_type == "chirp") ? TRAJ_CHIRP
+                    : TRAJ_SINE;
+    std::vector<double> amplitude = config["trajectory"]["amplitude"].as<std::vector<double>>();
+    std::vector<double> offset = config["trajectory"]["offset"].as<std::vector<double>>();
+    if (amplitude.size() != NUM_JOINTS || offset.size() != NUM_JOINTS) {
+        throw YAML::Exception(config["trajectory"].Mark(), "trajectory amplitude and offset need one entry per joint");
+    }
+    trajectory.amplitude = Eigen::Map<JointArray>(amplitude.data());
+    trajectory.offset = Eigen::Map<JointArray>(offset.data());
+    trajectory.frequency = config["trajectory"]["frequency"].as<double>();
+    trajectory.frequency_end = config["trajectory"]["frequency_end"].as<double>();
+    trajectory.duration = config["trajectory"]["duration"].as<double>();
+    trajectory.file = config["trajectory"]["file"].as<std::string>();
+
+    // gains and limits reloaded from this file while running
+    params.reload.enabled = config["reload"]["enabled"].as<bool>();
+    params.reload.ramp_s = config["reload"]["ramp"].as<double>();
+
+    // max program time
+    params.max_time = config["max_prog_time"].as<double>();
+
+    // set up the joint gains and limits, joint order
+    for (int i = 0; i < NUM_JOINTS; i++) {
+
+        params.gains.Kp(i) = config["gains"][JOINT_NAMES[i]]["Kp"].as<double>();
+        params.gains.Kd(i) = config["gains"][JOINT_NAMES[i]]["Kd"].as<double>();
+        params.gains.Kff(i) = config["gains"][JOINT_NAMES[i]]["Kff"].as<double>();
+
+        params.limits.q_min(i) = config["limits"][JOINT_NAMES[i]]["q_min"].as<double>();
+        params.limits.q_max(i) = config["limits"][JOINT_NAMES[i]]["q_max"].as<double>();
+        params.limits.qd_min(i) = config["limits"][JOINT_NAMES[i]]["qd_min"].as<double>();
+        params.limits.qd_max(i) = config["limits"][JOINT_NAMES[i]]["qd_max"].as<double>();
+    }
+
+    return params;
+}
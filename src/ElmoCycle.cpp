@@ -0,0 +1,182 @@
+#include "../inc/ElmoCycle.hpp"
+
+// function to set the loop frequency and scheduling mode
+void CycleScheduler::init(double freq, CycleConfig config) {
+
+    // store the configuration
+    this->config = config;
+    if (this->config.max_burst < 1) {
+        this->config.max_burst = 1;
+    }
+
+    // cycle period and spin window
+    this->period_ns = (int64_t) (1e9 / freq);
+    this->spin_ns = (int64_t) (config.spin_us * 1e3);
+    if (this->spin_ns > this->period_ns) {
+        this->spin_ns = this->period_ns;
+    }
+
+    // reset the counters
+    this->cycles = 0;
+    this->overruns = 0;
+    this->skipped = 0;
+    this->burst_left = 0;
+
+    // the first cycle is due one period from now
+    this->wakeup_ns = cycle_now_ns();
+    this->deadline_ns = this->wakeup_ns;
+    this->next_ns = this->wakeup_ns + this->period_ns;
+}
+
+// function that blocks until the next cycle is due
+int CycleScheduler::wait() {
+
+    int skipped_now;
+
+    if (this->config.mode == CYCLE_ABS_DEADLINE || this->config.mode == CYCLE_DC_SYNC) {
+        skipped_now = this->waitDeadline();
+    }
+    else {
+        skipped_now = this->waitBusyPoll();
+    }
+
+    this->cycles++;
+    this->skipped += skipped_now;
+
+    return skipped_now;
+}
+
+// function to shift the time grid by ns from the next deadline on
+void CycleScheduler::adjust(int64_t ns) {
+    this->next_ns += ns;
+}
+
+// legacy mode: spin on the clock until one period has passed since the last cycle
+int CycleScheduler::waitBusyPoll() {
+
+    int64_t now = cycle_now_ns();
+    while (now - this->wakeup_ns < this->period_ns) {
+        now = cycle_now_ns();
+    }
+
+    // every late wakeup shifts the following cycles, nothing is caught up
+    if (now - this->wakeup_ns >= 2 * this->period_ns) {
+        this->overruns++;
+    }
+
+    this->deadline_ns = this->wakeup_ns + this->period_ns;
+    this->wakeup_ns = now;
+
+    return 0;
+}
+
+// absolute deadline mode: sleep until shortly before the deadline, then spin the rest
+int CycleScheduler::waitDeadline() {
+
+    // sleep until the spin window opens
+    int64_t sleep_until = this->next_ns - this->spin_ns;
+    if (cycle_now_ns() < sleep_until) {
+        struct timespec ts;
+        ts.tv_sec = sleep_until / 1000000000LL;
+        ts.tv_nsec = sleep_until % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+    }
+
+    // spin until the deadline
+    int64_t now = cycle_now_ns();
+    while (now < this->next_ns) {
+        now = cycle_now_ns();
+    }
+
+    // release this cycle and schedule the next one on the same grid
+    this->deadline_ns = this->next_ns;
+    this->wakeup_ns = now;
+    this->next_ns += this->period_ns;
+
+    // cycles released back-to-back are not re-evaluated
+    if (this->burst_left > 0) {
+        this->burst_left--;
+        return 0;
+    }
+
+    // check if we missed at least one full period
+    int64_t late = now - this->deadline_ns;
+    if (late < this->period_ns) {
+        return 0;
+    }
+    this->overruns++;
+
+    // apply the catch-up rule
+    int64_t missed = late / this->period_ns;
+    switch (this->config.catchup) {
+
+        case CATCHUP_BURST:
+            // run up to max_burst missed cycles immediately, drop the rest
+            if (missed > this->config.max_burst) {
+                this->next_ns += (missed - this->config.max_burst) * this->period_ns;
+                this->burst_left = this->config.max_burst;
+                return (int) (missed - this->config.max_burst);
+            }
+            this->burst_left = (int) missed;
+            return 0;
+
+        case CATCHUP_RESYNC:
+            // start a new time grid from the late wakeup
+            this->next_ns = now + this->period_ns;
+            return (int) missed;
+
+        default:
+            // skip to the next deadline on the original grid
+            this->next_ns += missed * this->period_ns;
+            return (int) missed;
+    }
+}
+
+// function to set the loop frequency and controller gains
+void DCSync::init(double freq, CycleConfig config) {
+
+    this->period_ns = (int64_t) (1e9 / freq);
+    this->lead_ns = (int64_t) (config.dc_lead_us * 1e3);
+    this->kp = config.dc_kp;
+    this->ki = config.dc_ki;
+
+    // never move a deadline by more than 5% of the period in one cycle
+    this->max_step_ns = this->period_ns / 20;
+
+    this->integral = 0.0;
+    this->offset_ns = 0;
+    this->drift_ppm = 0.0;
+}
+
+// function to update the controller with the DC time of the last frame
+int64_t DCSync::update(int64_t dc_time) {
+
+    // SYNC0 fires on every multiple of the period in DC time, the frame should pass lead_ns before it
+    int64_t phase = (dc_time + this->lead_ns) % this->period_ns;
+    if (phase < 0) {
+        phase += this->period_ns;
+    }
+    if (phase >= this->period_ns / 2) {
+        phase -= this->period_ns;
+    }
+    this->offset_ns = phase;
+
+    // integrator with anti-windup, its output is the steady correction per cycle (clock drift)
+    if (this->ki > 0.0) {
+        double limit = (double) this->max_step_ns / this->ki;
+        this->integral += (double) phase;
+        this->integral = (this->integral > limit) ? limit : ((this->integral < -limit) ? -limit : this->integral);
+    }
+    this->drift_ppm = this->ki * this->integral / (double) this->period_ns * 1e6;
+
+    // a late frame (positive phase) moves the next wakeup earlier
+    double correction = -(this->kp * (double) phase + this->ki * this->integral);
+    if (correction > (double) this->max_step_ns) {
+        correction = (double) this->max_step_ns;
+    }
+    if (correction < (double) -this->max_step_ns) {
+        correction = (double) -this->max_step_ns;
+    }
+
+    return (int64_t) llround(correction);
+}
@@ -0,0 +1,22 @@
+#include "../inc/ElmoDS402.h"
+
+/* printable name of a DS402_* state */
+const char *ds402_state_name(int state) {
+
+    static const char *names[DS402_NUM_STATES] = {
+        "NOT READY",
+        "SOD",
+        "RSO",
+        "SO",
+        "ARMED",
+        "QUICK STOPPED",
+        "FAILED: fault reaction active",
+        "FAILED: fault",
+        "FAILED: unknown state"
+    };
+
+    if (state < 0 || state >= DS402_NUM_STATES) {
+        return names[DS402_UNKNOWN];
+    }
+    return names[state];
+}
@@ -0,0 +1,277 @@
+#include "../inc/ElmoExecutor.hpp"
+
+// names of the roles and policies in the report
+static const char *role_names[ROLE_COUNT] = {"bus", "check", "logger", "app"};
+
+static const char *policyName(int policy) {
+    return (policy == SCHED_FIFO) ? "fifo" : (policy == SCHED_RR) ? "rr" : "other";
+}
+
+// function to parse a scheduling policy name
+int schedPolicy(const char *name) {
+    return (strcmp(name, "fifo") == 0) ? SCHED_FIFO : (strcmp(name, "rr") == 0) ? SCHED_RR : SCHED_OTHER;
+}
+
+// constructor
+ELMOExecutor::ELMOExecutor(ExecutorConfig config) : config(config), count(0) {
+}
+
+// function to lock the process memory and prefault the heap
+bool ELMOExecutor::lockMemory() {
+
+    bool locked = false;
+    if (this->config.lock_memory) {
+
+        // current and future pages stay resident. Mappings made after this are locked as their pages are touched
+        // rather than read in whole, so a thread stack only takes what is prefaulted and a mapped trajectory file
+        // is streamed instead of loaded
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            locked = true;
+#ifdef MCL_ONFAULT
+            mlockall(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT);
+#endif
+        }
+        else {
+            printf("WARNING : could not lock the process memory (%s)\n", strerror(errno));
+        }
+
+        // freed heap stays in the process, large blocks come from the heap instead of new mappings and every
+        // thread allocates from the main (prefaulted) arena, so memory touched once is never faulted in again
+        mallopt(M_TRIM_THRESHOLD, -1);
+        mallopt(M_MMAP_MAX, 0);
+        mallopt(M_ARENA_MAX, 1);
+    }
+
+    // touch the heap once, the pages are kept after the free
+    size_t bytes = (size_t) this->config.prefault_heap_mb * 1024 * 1024;
+    if (bytes > 0) {
+        long page = sysconf(_SC_PAGESIZE);
+        volatile char *heap = (volatile char *) malloc(bytes);
+        if (heap != NULL) {
+            for (size_t i = 0; i < bytes; i += page) {
+                heap[i] = 0;
+            }
+            free((void *) heap);
+        }
+    }
+
+    printf("Memory %s, %d MB heap and %d kB of every thread stack prefaulted\n", locked ? "locked" : "not locked",
+           this->config.prefault_heap_mb, this->config.prefault_stack_kb);
+
+    return locked || !this->config.lock_memory;
+}
+
+// function to start a thread in a role
+int ELMOExecutor::spawn(int role, const char *name, void *(*fn)(void *), void *arg, int cpu) {
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->count >= EXECUTOR_MAX_THREADS) {
+        printf("ERROR : no room for thread %s\n", name);
+        return -1;
+    }
+
+    Thread &t = this->threads[this->count];
+    const ThreadConfig &tc = this->config.role[role];
+    t.executor = this;
+    snprintf(t.name, sizeof(t.name), "%s", name);
+    t.role = role;
+    t.policy = tc.policy;
+    t.cpu = (cpu == CPU_ROLE) ? tc.cpu : cpu;
+    t.fn = fn;
+    t.arg = arg;
+    t.tid = 0;
+    t.adopted = false;
+    t.joined = false;
+    t.done = false;
+
+    // policy and priority are set at creation, the core and the name by the thread itself
+    pthread_attr_t attr;
+    struct sched_param param;
+    pthread_attr_init(&attr);
+    pthread_attr_setschedpolicy(&attr, tc.policy);
+    param.sched_priority = (tc.policy == SCHED_OTHER) ? 0 : tc.priority;
+    pthread_attr_setschedparam(&attr, &param);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+
+    int err = pthread_create(&t.thread, &attr, &ELMOExecutor::trampoline, (void *) &t);
+
+    // without real-time privileges fall back to the default scheduling (e.g. simulated drives as a normal user)
+    if (err == EPERM && tc.policy != SCHED_OTHER) {
+        printf("WARNING : no real-time privileges for thread %s, using default scheduling\n", name);
+        t.policy = SCHED_OTHER;
+        pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+        param.sched_priority = 0;
+        pthread_attr_setschedparam(&attr, &param);
+        err = pthread_create(&t.thread, &attr, &ELMOExecutor::trampoline, (void *) &t);
+    }
+    pthread_attr_destroy(&attr);
+
+    if (err != 0) {
+        printf("ERROR : could not create thread %s (%s)\n", name, strerror(err));
+        return -1;
+    }
+
+    return this->count++;
+}
+
+// function to give the calling thread a role
+int ELMOExecutor::adopt(int role, const char *name) {
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->count >= EXECUTOR_MAX_THREADS) {
+        printf("ERROR : no room for thread %s\n", name);
+        return -1;
+    }
+
+    Thread &t = this->threads[this->count];
+    const ThreadConfig &tc = this->config.role[role];
+    t.executor = this;
+    snprintf(t.name, sizeof(t.name), "%s", name);
+    t.role = role;
+    t.policy = tc.policy;
+    t.cpu = tc.cpu;
+    t.fn = NULL;
+    t.arg = NULL;
+    t.thread = pthread_self();
+    t.tid = 0;
+    t.adopted = true;
+    t.joined = false;
+    t.done = false;
+
+    struct sched_param param;
+    param.sched_priority = (tc.policy == SCHED_OTHER) ? 0 : tc.priority;
+    if (pthread_setschedparam(t.thread, tc.policy, &param) != 0 && tc.policy != SCHED_OTHER) {
+        printf("WARNING : no real-time privileges for thread %s, using default scheduling\n", name);
+        t.policy = SCHED_OTHER;
+    }
+
+    this->configure(t);
+    t.start = usage();
+
+    return this->count++;
+}
+
+// function to wait for a started thread to return
+bool ELMOExecutor::join(int handle) {
+
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (handle < 0 || handle >= this->count) {
+            return false;
+        }
+    }
+
+    Thread &t = this->threads[handle];
+    if (t.adopted || t.joined) {
+        return false;
+    }
+    pthread_join(t.thread, NULL);
+    t.joined = true;
+
+    return true;
+}
+
+// function to wait for every started thread, last started first
+void ELMOExecutor::joinAll() {
+
+    int count;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        count = this->count;
+    }
+    for (int i = count - 1; i >= 0; i--) {
+        this->join(i);
+    }
+}
+
+// function to get the kernel thread id of a thread by name
+pid_t ELMOExecutor::threadId(const char *name) {
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    for (int i = 0; i < this->count; i++) {
+        if (strcmp(this->threads[i].name, name) == 0) {
+            return this->threads[i].tid.load(std::memory_order_acquire);
+        }
+    }
+    return 0;
+}
+
+// function to print the scheduling, page faults and context switches of every thread
+void ELMOExecutor::report() {
+
+    printf("Threads (page faults and context switches since the thread started its work):\n");
+    printf("  %-15s %-7s %-6s %4s %4s %8s %8s %9s %9s\n", "name", "role", "policy", "prio", "cpu",
+           "minflt", "majflt", "vol csw", "invol csw");
+
+    for (int i = 0; i < this->count; i++) {
+
+        Thread &t = this->threads[i];
+        const ThreadConfig &tc = this->config.role[t.role];
+        int prio = (t.policy == SCHED_OTHER) ? 0 : tc.priority;
+        printf("  %-15s %-7s %-6s %4d %4d", t.name, role_names[t.role], policyName(t.policy), prio, t.cpu);
+
+        // usage of returned threads, and of the calling thread if it was adopted
+        ThreadUsage end;
+        if (t.done.load(std::memory_order_acquire)) {
+            end = t.end;
+        }
+        else if (t.adopted && pthread_equal(t.thread, pthread_self())) {
+            end = usage();
+        }
+        else {
+            printf(" %8s\n", "running");
+            continue;
+        }
+        printf(" %8ld %8ld %9ld %9ld\n", end.minflt - t.start.minflt, end.majflt - t.start.majflt,
+               end.nvcsw - t.start.nvcsw, end.nivcsw - t.start.nivcsw);
+    }
+}
+
+// function to set the core and name of the calling thread and prefault its stack
+void ELMOExecutor::configure(Thread &t) {
+
+    if (t.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(t.cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            printf("WARNING : could not pin thread %s to cpu %d\n", t.name, t.cpu);
+        }
+    }
+    pthread_setname_np(pthread_self(), t.name);
+    t.tid.store((pid_t) syscall(SYS_gettid), std::memory_order_release);
+
+    // touch the stack the thread will use, the pages stay mapped after this frame returns
+    size_t bytes = (size_t) this->config.prefault_stack_kb * 1024;
+    if (bytes > 0) {
+        long page = sysconf(_SC_PAGESIZE);
+        volatile char *stack = (volatile char *) alloca(bytes);
+        for (size_t i = 0; i < bytes; i += page) {
+            stack[i] = 0;
+        }
+    }
+}
+
+// function to read the usage of the calling thread
+ThreadUsage ELMOExecutor::usage() {
+
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+
+    ThreadUsage u = {ru.ru_minflt, ru.ru_majflt, ru.ru_nvcsw, ru.ru_nivcsw};
+    return u;
+}
+
+// thread entry: configure, run the work, record the usage
+void *ELMOExecutor::trampoline(void *thread) {
+
+    Thread *t = (Thread *) thread;
+    t->executor->configure(*t);
+
+    t->start = usage();
+    void *ret = t->fn(t->arg);
+    t->end = usage();
+    t->done.store(true, std::memory_order_release);
+
+    return ret;
+}
@@ -0,0 +1,397 @@
+#include "../inc/ElmoHealth.hpp"
+
+// constructor, the event ring is allocated here so posting never allocates
+ELMOHealth::ELMOHealth() : events(HEALTH_QUEUE), signal(0), sleepers(0), dropped(0), bus(NULL), window(NULL), count(0),
+                           running(false), done(false), busy(false), t_checked(0), wkc_low(false), t_wkc_low(0), wkc_drops(0) {
+}
+
+// function to start monitoring an open bus
+void ELMOHealth::start(ELMOBus *bus, const CycleWindow *window, int drives) {
+
+    this->bus = bus;
+    this->window = window;
+    this->count = drives;
+
+    this->drive.reset(new DriveHealth[drives]);
+    this->health.reset(new uint8[drives]);
+    this->named.reset(new std::atomic<uint8>[drives]);
+    for (int i = 0; i < drives; i++) {
+        DriveHealth &d = this->drive[i];
+        d.state = DRIVE_OK;
+        d.episode = false;
+        d.enabled = false;
+        d.t_onset = 0;
+        d.t_ok = 0;
+        d.t_enabled = 0;
+        d.dropouts.store(0);
+        d.faults.store(0);
+        this->health[i] = DRIVE_OK;
+        this->named[i].store(DRIVE_OK);
+    }
+    this->t_checked.store(0);
+
+    this->running.store(true, std::memory_order_seq_cst);
+}
+
+// function to stop monitoring, returns once the monitor is off the bus
+void ELMOHealth::stop() {
+
+    this->running.store(false, std::memory_order_seq_cst);
+    this->done.store(true, std::memory_order_seq_cst);
+
+    // wake the monitor so it exits, then wait for a state check in progress to finish
+    this->signal.fetch_add(1, std::memory_order_seq_cst);
+    syscall(SYS_futex, &this->signal, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    while (this->busy.load(std::memory_order_seq_cst)) {
+        usleep(HEALTH_POLL_US);
+    }
+}
+
+// function to apply one event
+void ELMOHealth::apply(const HealthEvent &event) {
+
+    switch (event.type) {
+
+        case HEALTH_WKC_LOW:
+            if (!this->wkc_low) {
+                this->wkc_low = true;
+                this->t_wkc_low = event.t;
+                this->wkc_drops.store(this->wkc_drops.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+            break;
+
+        case HEALTH_WKC_OK:
+            if (this->wkc_low) {
+                this->wkc_low = false;
+                this->wkc_recover.record(event.t - this->t_wkc_low);
+            }
+            break;
+
+        case HEALTH_DRIVE_FAULT: {
+            if (event.drive < 0 || event.drive >= this->count) {
+                break;
+            }
+
+            // a fault of a drive that is still OPERATIONAL starts an anomaly, the cycle named the drive already
+            DriveHealth &d = this->drive[event.drive];
+            if (!d.episode) {
+                d.episode = true;
+                d.t_onset = event.t;
+                d.t_ok = 0;
+                d.detect.record(cycle_now_ns() - event.t);
+                d.faults.store(d.faults.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                printf("WARNING : drive %d entered FAULT\n", event.drive + 1);
+            }
+            d.enabled = false;
+            break;
+        }
+
+        case HEALTH_DRIVE_ENABLED: {
+            if (event.drive < 0 || event.drive >= this->count) {
+                break;
+            }
+            DriveHealth &d = this->drive[event.drive];
+            if (d.episode && event.t >= d.t_onset) {
+                d.enabled = true;
+                d.t_enabled = event.t;
+                this->settle(event.drive);
+            }
+            break;
+        }
+    }
+}
+
+// function to read the drive states in a window and bring the drives back
+bool ELMOHealth::check() {
+
+    // the comm thread may be closing the bus, stop waits for the flag before it does
+    this->busy.store(true, std::memory_order_seq_cst);
+    if (!this->running.load(std::memory_order_seq_cst)) {
+        this->busy.store(false, std::memory_order_seq_cst);
+        return false;
+    }
+
+    // right after a cycle's frame, so the state check frames never go out ahead of the next one
+    int64_t last_close = 0;
+    if (!this->window->wait(last_close, this->running, HEALTH_POLL_US)) {
+        this->busy.store(false, std::memory_order_seq_cst);
+        return false;
+    }
+    int64 t_check = cycle_now_ns();
+    int down = this->bus->checkState(this->wkc_low, this->health.get());
+    int64 now = cycle_now_ns();
+    this->busy.store(false, std::memory_order_seq_cst);
+
+    for (int i = 0; i < this->count; i++) {
+
+        DriveHealth &d = this->drive[i];
+        uint8 state = this->health[i];
+
+        // a drive found out of OPERATIONAL, the anomaly started with the working counter drop
+        if (state != DRIVE_OK && d.state == DRIVE_OK) {
+            if (!d.episode) {
+                d.episode = true;
+                d.enabled = false;
+                d.t_onset = (this->t_wkc_low > 0) ? this->t_wkc_low : now;
+                d.detect.record(now - d.t_onset);
+            }
+            d.dropouts.store(d.dropouts.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            printf("WARNING : drive %d is %s\n", i + 1, (state == DRIVE_LOST) ? "lost" : "out of OPERATIONAL");
+        }
+
+        // and back in it
+        if (state == DRIVE_OK && d.state != DRIVE_OK) {
+            d.t_ok = now;
+        }
+        d.state = state;
+        this->named[i].store(state, std::memory_order_relaxed);
+        this->settle(i);
+    }
+    this->t_checked.store(t_check, std::memory_order_release);
+
+    return down > 0;
+}
+
+// function to close the anomaly of drive i once it is back
+void ELMOHealth::settle(int i) {
+
+    DriveHealth &d = this->drive[i];
+    if (!d.episode || d.state != DRIVE_OK || !d.enabled) {
+        return;
+    }
+
+    int64 t_back = std::max(d.t_ok, d.t_enabled);
+    d.recover.record(t_back - d.t_onset);
+    d.episode = false;
+    printf("MESSAGE : drive %d back after %.1f ms\n", i + 1, (t_back - d.t_onset) * 1e-6);
+}
+
+// function to sleep until an event comes in or timeout_ms pass
+void ELMOHealth::sleep(uint32_t seen, int timeout_ms) {
+
+    struct timespec timeout;
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = (long) (timeout_ms % 1000) * 1000000L;
+
+    this->sleepers.fetch_add(1, std::memory_order_seq_cst);
+    if (this->signal.load(std::memory_order_seq_cst) == seen) {
+        syscall(SYS_futex, &this->signal, FUTEX_WAIT_PRIVATE, seen, &timeout, NULL, 0);
+    }
+    this->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+}
+
+// monitor thread, sleeps until the comm thread posts an event
+void *ELMOHealth::monitorThread(void *health) {
+
+    ELMOHealth *self = (ELMOHealth *) health;
+    bool down = false;
+
+    while (!self->done.load(std::memory_order_seq_cst)) {
+
+        uint32_t seen = self->signal.load(std::memory_order_seq_cst);
+
+        if (self->running.load(std::memory_order_seq_cst)) {
+
+            // everything the comm thread saw since the last pass
+            HealthEvent event;
+            while (self->events.pop(event)) {
+                self->apply(event);
+            }
+
+            // bring the drives back while the working counter is low or a drive has not come back yet
+            if (self->wkc_low || down) {
+                down = self->check();
+            }
+        }
+
+        self->sleep(seen, (self->wkc_low || down) ? HEALTH_RETRY_MS : HEALTH_IDLE_MS);
+    }
+
+    return NULL;
+}
+
+// function to get the metrics of drive i
+DriveHealthSummary ELMOHealth::summary(int i) const {
+
+    const DriveHealth &d = this->drive[i];
+
+    DriveHealthSummary s;
+    s.dropouts = d.dropouts.load(std::memory_order_relaxed);
+    s.faults = d.faults.load(std::memory_order_relaxed);
+    s.detect = d.detect.summary();
+    s.recover = d.recover.summary();
+
+    return s;
+}
+
+// function to print the metrics of the drives that had an anomaly
+void ELMOHealth::print() const {
+
+    uint64_t drops = this->wkc_drops.load(std::memory_order_relaxed);
+    uint64_t lost = this->dropped.load(std::memory_order_relaxed);
+    if (drops == 0 && lost == 0) {
+        return;
+    }
+
+    TimingSummary wkc = this->wkc_recover.summary();
+    printf("  bus health: %llu working counter drops, complete again after %.2f ms (p50) / %.2f ms (max), "
+           "%llu events dropped\n", (unsigned long long) drops, wkc.p50 * 1e-6, wkc.max * 1e-6,
+           (unsigned long long) lost);
+
+    for (int i = 0; i < this->count; i++) {
+        DriveHealthSummary s = this->summary(i);
+        if (s.dropouts + s.faults == 0) {
+            continue;
+        }
+        printf("  drive %d: %llu dropouts, %llu faults, detected after %.2f / %.2f ms, back after %.2f / %.2f ms "
+               "(p50 / max)\n", i + 1, (unsigned long long) s.dropouts, (unsigned long long) s.faults,
+               s.detect.p50 * 1e-6, s.detect.max * 1e-6, s.recover.p50 * 1e-6, s.recover.max * 1e-6);
+    }
+}
+
+// constructor, nothing is counted before init
+LinkStats::LinkStats() : count(0), cycles(0), frames_lost(0), partial(0), degraded(0), unattributed(0), bucket_cycles(1),
+                         in_bucket(0), current(0) {
+    this->init(0, 1.0);
+}
+
+// function to size the counters for the drives found at the bus rate
+void LinkStats::init(int drives, double freq) {
+
+    // readers see the drives once their counters are there
+    this->count.store(0, std::memory_order_release);
+    this->link.reset(new DriveLink[drives]);
+    for (int i = 0; i < drives; i++) {
+        DriveLink &l = this->link[i];
+        l.lost.store(0);
+        l.bursts.store(0);
+        l.burst_max.store(0);
+        l.burst.store(0);
+        l.degraded.store(0);
+        memset(l.window.bucket, 0, sizeof(l.window.bucket));
+        l.window.total.store(0);
+    }
+    memset(this->window_cycles.bucket, 0, sizeof(this->window_cycles.bucket));
+    memset(this->window_loss.bucket, 0, sizeof(this->window_loss.bucket));
+    this->window_cycles.total.store(0);
+    this->window_loss.total.store(0);
+
+    this->bucket_cycles = std::max((uint32_t) (LINK_WINDOW_S * freq / LINK_BUCKETS), (uint32_t) 1);
+    this->in_bucket = 0;
+    this->current = 0;
+    this->count.store(drives, std::memory_order_release);
+}
+
+// function to account one exchange
+void LinkStats::update(int wkc, int expected, bool degraded, const char *lost) {
+
+    // move the window on, the oldest bucket is dropped
+    if (this->in_bucket == this->bucket_cycles) {
+        this->in_bucket = 0;
+        this->current = (this->current + 1) % LINK_BUCKETS;
+        drop(this->window_cycles, this->current);
+        drop(this->window_loss, this->current);
+        for (int i = 0; i < this->drives(); i++) {
+            drop(this->link[i].window, this->current);
+        }
+    }
+    this->in_bucket++;
+
+    // bus
+    bump(this->cycles, 1);
+    add(this->window_cycles, this->current, 1);
+    if (wkc < expected) {
+        add(this->window_loss, this->current, 1);
+        bump((wkc <= 0) ? this->frames_lost : this->partial, 1);
+        if (wkc > 0) {
+            bump(degraded ? this->degraded : this->unattributed, 1);
+        }
+    }
+
+    // drives, a burst is a run of lost cycles
+    for (int i = 0; i < this->drives(); i++) {
+
+        DriveLink &l = this->link[i];
+        uint64_t burst = l.burst.load(std::memory_order_relaxed);
+        if (!lost[i]) {
+            if (burst > 0) {
+                l.burst.store(0, std::memory_order_relaxed);
+            }
+            continue;
+        }
+
+        bump(l.lost, 1);
+        add(l.window, this->current, 1);
+        if (burst == 0) {
+            bump(l.bursts, 1);
+        }
+        l.burst.store(++burst, std::memory_order_relaxed);
+        if (burst > l.burst_max.load(std::memory_order_relaxed)) {
+            l.burst_max.store(burst, std::memory_order_relaxed);
+        }
+        if (degraded) {
+            bump(l.degraded, 1);
+        }
+    }
+}
+
+// function to get the counters of drive i
+DriveLinkSummary LinkStats::drive(int i) const {
+
+    // no counters for a drive that is not on the bus
+    DriveLinkSummary s = {};
+    if (i < 0 || i >= this->drives()) {
+        return s;
+    }
+
+    const DriveLink &l = this->link[i];
+    uint64_t window = this->window_cycles.total.load(std::memory_order_relaxed);
+
+    s.lost = l.lost.load(std::memory_order_relaxed);
+    s.loss_rate = (window > 0) ? (double) l.window.total.load(std::memory_order_relaxed) / window : 0.0;
+    s.bursts = l.bursts.load(std::memory_order_relaxed);
+    s.burst_max = l.burst_max.load(std::memory_order_relaxed);
+    s.burst = l.burst.load(std::memory_order_relaxed);
+    s.degraded = l.degraded.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+// function to get the counters of the bus
+LinkStatsSummary LinkStats::summary() const {
+
+    uint64_t window = this->window_cycles.total.load(std::memory_order_relaxed);
+
+    LinkStatsSummary s;
+    s.cycles = this->cycles.load(std::memory_order_relaxed);
+    s.frames_lost = this->frames_lost.load(std::memory_order_relaxed);
+    s.partial = this->partial.load(std::memory_order_relaxed);
+    s.degraded = this->degraded.load(std::memory_order_relaxed);
+    s.unattributed = this->unattributed.load(std::memory_order_relaxed);
+    s.loss_rate = (window > 0) ? (double) this->window_loss.total.load(std::memory_order_relaxed) / window : 0.0;
+
+    return s;
+}
+
+// function to print the counters of the bus and of the drives that lost cycles
+void LinkStats::print() const {
+
+    LinkStatsSummary s = this->summary();
+    if (s.frames_lost + s.partial == 0) {
+        return;
+    }
+
+    printf("  frames: %llu lost, %llu partial (%llu degraded, %llu unattributed) of %llu, %.3f %% lost in the last %.0f s\n",
+           (unsigned long long) s.frames_lost, (unsigned long long) s.partial, (unsigned long long) s.degraded,
+           (unsigned long long) s.unattributed, (unsigned long long) s.cycles, s.loss_rate * 100.0, LINK_WINDOW_S);
+
+    for (int i = 0; i < this->drives(); i++) {
+        DriveLinkSummary d = this->drive(i);
+        if (d.lost == 0) {
+            continue;
+        }
+        printf("  drive %d: %llu cycles lost in %llu bursts (longest %llu), %llu degraded, %.3f %% lost in the last %.0f s\n",
+               i + 1, (unsigned long long) d.lost, (unsigned long long) d.bursts, (unsigned long long) d.burst_max,
+               (unsigned long long) d.degraded, d.loss_rate * 100.0, LINK_WINDOW_S);
+    }
+}
@@ -10,10 +10,10 @@
 */ 
 
 // function to intialize the ELMO motor controllers
-void ELMOInterface::initELMO(uint8 opmode, double freq, char* port, pthread_t thread1, pthread_t thread2) {
+void ELMOInterface::initELMO(uint8 opmode, double freq, char* port, ELMOExecutor &executor) {
 
-    // Initialize the ELMO data struct
-    this->data = (struct ELMOData *)malloc(sizeof(struct ELMOData));
+    // Initialize the ELMO data struct (state and command channels start zeroed)
+    this->data = new ELMOData();
 
     // set the operation mode
     this->data->OpMode = opmode;
@@ -21,46 +21,65 @@ void ELMOInterface::initELMO(uint8 opmode, double freq, char* port, pthread_t th
     // set the frequency of the control loop
     this->data->freq = freq;
 
+    // set the number of drives expected on the chain
+    this->data->drives = this->drives;
+
+    // set the cycle scheduler configuration
+    this->data->cycle = this->cycle;
+
+    // set the drive enable sequence
+    this->data->enable = this->enable;
+
+    // set the telemetry PDO objects and decimation
+    this->data->telemetry_config = this->telemetry;
+
+    // keep the drives that exchange running while others are out
+    this->data->degraded = this->bus.degraded;
+
     // flip the motor switch to be on
     this->data->motor_control_switch = true;
 
-    // Inital values to populate the ELMO data struct
-    int32 pos0[6] = {0,0,0,0,0,0};
-    int32 vel0[6] = {0,0,0,0,0,0};
-    int32 torque0[6] = {0,0,0,0,0,0};
+    // attach the ethernet port
+    strcpy(this->data->port, port);
 
-    // Populate the ELMO data struct with the intial values
-    memcpy(this->data->pos, pos0, sizeof(pos0));          // set the position to zero
-    memcpy(this->data->vel, vel0, sizeof(vel0));          // set the velocity to zero
-    memcpy(this->data->torque, torque0, sizeof(torque0)); // set the torque to zero
-    strcpy(this->data->port, port);                       // attach the ethernet port
+    // create the EtherCAT chain backend (SOEM or simulated)
+    this->data->bus = createBus(this->bus, freq, &executor);
 
-    printf("SOEM (Simple Open EtherCAT Master)\nSetting Up ELMO drivers...\n");
-    
-    // Threading stuff to set each thread to the highest priority
-    pthread_attr_t attr;
-    struct sched_param param;
-    
-    // intialize the thread attribute
-    pthread_attr_init(&attr);
-    
-    // set the thread to be FIFO
-    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    // the comm thread starts the mailbox worker in its executor role
+    this->data->executor = &executor;
 
-    // set the thread priority to the maximum
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    pthread_attr_setschedparam(&attr, &param);
+    // gains and limits the loops start with, swapped by setParams from then on
+    this->params.publish({this->gains, this->limits, 0.0});
 
-    // set the thread to be inheritable
-    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    // run an external torque law, or the PD law on streamed setpoints, in the bus cycle
+    if (this->controller != NULL) {
+        this->data->controller = this->controller;
+    }
+    else if (this->control_mode == CONTROL_CYCLE_PD) {
+        this->pd = new ELMOJointPD(this->limits, this->interp);
+        this->pd->setParams(&this->params);
+        this->data->controller = this->pd;
+        printf("Joint PD law runs in the bus cycle.\n");
+    }
 
-    /* Thread to catch ELMO errors and act appropriately */
-    pthread_create(&thread1, &attr, &ecatcheck, (void (*)) &ctime);
-    
-    // /* Thread to communicate with ELMO. Send and receive data */
-    pthread_create(&thread2, &attr, &ELMOcommunication, (void (*)) &this->data);
+    // record the last seconds of process data in the comm thread
+    if (this->recorder_config.enabled) {
+        this->recorder = new ELMORecorder(this->recorder_config, freq);
+        this->data->recorder = this->recorder;
+    }
+
+    printf("SOEM (Simple Open EtherCAT Master)\nSetting Up ELMO drivers...\n");
+
+    // health monitor thread to bring drives back on working counter drops, and thread to send and receive the process data
+    this->executor = &executor;
+    this->check_thread = executor.spawn(ROLE_CHECK, "elmo_health", &ELMOHealth::monitorThread, (void *) &this->data->health);
+    this->bus_thread = executor.spawn(ROLE_BUS, "elmo_bus", &ELMOcommunication, (void *) &this->data);
+    if (this->check_thread < 0 || this->bus_thread < 0) {
+        std::cout << "Could not create the ELMO threads. Exiting..." << std::endl;
+        exit(2);
+    }
 
-    std::cout << "Created threads for ELMO communication and error checking." << std::endl;
+    std::cout << "Created threads for ELMO communication and health monitoring." << std::endl;
 
     // Wait for communication to be set up
     while(this->data->commStatus != 1) {
@@ -71,15 +90,26 @@ void ELMOInterface::initELMO(uint8 opmode, double freq, char* port, pthread_t th
         }
     };
 
+    // size the snapshot for the drives found, the joint map has to fit on the chain
+    this->data->state.read(this->snapshot);
+    if (this->snapshot.drives() < LegJointMap::drives()) {
+        printf("ERROR : the joint map needs %d drives, %d found on the chain\n", LegJointMap::drives(), this->snapshot.drives());
+        exit(2);
+    }
+
     printf("Ready.\n");
     usleep(3000);
 }
 
-// function to that flips the motor control switch to off
+// function to that flips the motor control switch to off and waits for the ELMO threads
 void ELMOInterface::shutdownELMO() {
 
     // turn the desired motor switch to be off
     this->data->motor_control_switch = false;
+
+    // the comm thread brings the drives down, stops the health monitor and closes the bus
+    this->executor->join(this->bus_thread);
+    this->executor->join(this->check_thread);
 }
 
 // function to set the low level control gains
@@ -96,210 +126,402 @@ void ELMOInterface::setLimits(JointLimits limits) {
     this->limits = limits;
 }
 
-// function to get the ELMO status (reordered)
-ELMOStatus ELMOInterface::getELMOStatus() {
+// function to swap the gains and limits while the loops run
+bool ELMOInterface::setParams(const JointParams &params) {
 
-    // declare variables for the incoming data
-    uint16 joint_input[6];
-    uint16 joint_control[6];
-    uint16 joint_status[6];
-    ELMOStatus tmp;
+    if (!this->params.publish(params)) {
+        return false;
+    }
+    this->gains = params.gains;
+    this->limits = params.limits;
 
-    // copy the incoming data to the declared variables
-    memcpy(joint_input, this->data->inputs, sizeof(joint_input));
-    memcpy(joint_control, this->data->controlword, sizeof(joint_control));
-    memcpy(joint_status, this->data->statusword, sizeof(joint_status));
-
-    // poulate the Eigen vector with reordered data
-    tmp << joint_input[0],   // (HFL) Hip Frontal Left
-           joint_input[1],   // (HSL) Hip Sagittal Left
-           joint_input[3],   // (KL) Knee Left
-           joint_input[4],   // (HFR) Hip Frontal Right
-           joint_input[2],   // (HSR) Hip Sagittal Right
-           joint_input[5],   // (KR) Knee Right
-           joint_control[0], // (HFL) Hip Frontal Left
-           joint_control[1], // (HSL) Hip Sagittal Left
-           joint_control[3], // (KL) Knee Left
-           joint_control[4], // (HFR) Hip Frontal Right
-           joint_control[2], // (HSR) Hip Sagittal Right
-           joint_control[5], // (KR) Knee Right
-           joint_status[0],  // (HFL) Hip Frontal Left
-           joint_status[1],  // (HSL) Hip Sagittal Left
-           joint_status[3],  // (KL) Knee Left
-           joint_status[4],  // (HFR) Hip Frontal Right
-           joint_status[2],  // (HSR) Hip Sagittal Right
-           joint_status[5];  // (KR) Knee Right
+    return true;
+}
 
-    return tmp;
+// function to pick up swapped gains and limits at the start of an app tick
+void ELMOInterface::updateParams() {
+
+    // a new copy starts a ramp from the gains in use, the limits switch at once
+    const JointParams *params = this->params.read(PARAM_READER_APP);
+    if (params != this->active) {
+        if (this->active == NULL) {
+            this->ramp.reset(params->gains);
+        }
+        else {
+            this->ramp.start(params->gains, params->ramp_s, cycle_now_ns());
+        }
+        this->active = params;
+    }
+    this->ramp.at(cycle_now_ns());
 }
 
-// function to get the raw encoder data from ELMO
-JointVec ELMOInterface::getEncoderData() {
+// function to select the EtherCAT backend
+void ELMOInterface::setBusConfig(BusConfig bus) {
 
-    // declare variables for the incoming data
-    int32 pos[6];
-    int32 vel[6];
-    JointVec tmp(12);
-
-    // copy the incoming data to the declared variables
-    memcpy(pos, this->data->pos, sizeof(pos));
-    memcpy(vel, this->data->vel, sizeof(vel));
-
-    // populate the Eigen vector with reordered data
-    tmp.setZero();
-    tmp <<  pos[0] * HIP_CONVERSION,  // (HFL) Hip Frontal Left
-            pos[1] * HIP_CONVERSION,  // (HSL) Hip Sagittal Left
-            pos[3] * KNEE_CONVERSION, // (KL) Knee Left
-            pos[4] * HIP_CONVERSION,  // (HFR) Hip Frontal Right
-            pos[2] * HIP_CONVERSION,  // (HSR) Hip Sagittal Right
-            pos[5] * KNEE_CONVERSION, // (KR) Knee Right
-            vel[0] * HIP_CONVERSION,  // (HFL) Hip Frontal Left
-            vel[1] * HIP_CONVERSION,  // (HSL) Hip Sagittal Left
-            vel[3] * KNEE_CONVERSION, // (KL) Knee Left
-            vel[4] * HIP_CONVERSION,  // (HFR) Hip Frontal Right
-            vel[2] * HIP_CONVERSION,  // (HSR) Hip Sagittal Right
-            vel[5] * KNEE_CONVERSION; // (KR) Knee Right
+    // set the bus configuration
+    this->bus = bus;
+}
 
-    return tmp;
+// function to set the cyclic loop scheduling mode
+void ELMOInterface::setCycleConfig(CycleConfig cycle) {
+
+    // set the cycle configuration
+    this->cycle = cycle;
 }
 
-// function to compute the torque command
-JointTorque ELMOInterface::computeTorque(JointVec joint_ref, JointTorque tau_ff) {
+// function to set the drive enable sequence
+void ELMOInterface::setEnableConfig(EnableConfig enable) {
 
-    // get the current joint state
-    JointVec joint_data = this->getEncoderData();
+    // set the enable configuration
+    this->enable = enable;
+}
 
-    // intialize the torque vector
-    JointTorque tau;
-    double tau_HFL, tau_HSL, tau_KL, tau_HFR, tau_HSR, tau_KR;
+// function to set the number of drives expected on the chain
+void ELMOInterface::setDriveCount(int drives) {
 
-    // saturate the reference joint angles
-    if (joint_ref(0) < this->limits.q_min_HFL || joint_ref(0) > this->limits.q_max_HFL) {
-        std::cout << "[WARNING] Joint HFL reference is out of bounds! Saturating." << std::endl;
-        joint_ref(0) = std::min(std::max(joint_ref(0), this->limits.q_min_HFL), this->limits.q_max_HFL);
-    }
-    if (joint_ref(1) < this->limits.q_min_HSL || joint_ref(1) > this->limits.q_max_HSL) {
-        std::cout << "[WARNING] Joint HSL reference is out of bounds! Saturating." << std::endl;
-        joint_ref(1) = std::min(std::max(joint_ref(1), this->limits.q_min_HSL), this->limits.q_max_HSL);
-    }
-    if (joint_ref(2) < this->limits.q_min_KL || joint_ref(2) > this->limits.q_max_KL) {
-        std::cout << "[WARNING] Joint KL reference is out of bounds! Saturating." << std::endl;
-        joint_ref(2) = std::min(std::max(joint_ref(2), this->limits.q_min_KL), this->limits.q_max_KL);
-    }
-    if (joint_ref(3) < this->limits.q_min_HFR || joint_ref(3) > this->limits.q_max_HFR) {
-        std::cout << "[WARNING] Joint HFR reference is out of bounds! Saturating." << std::endl;
-        joint_ref(3) = std::min(std::max(joint_ref(3), this->limits.q_min_HFR), this->limits.q_max_HFR);
-    }
-    if (joint_ref(4) < this->limits.q_min_HSR || joint_ref(4) > this->limits.q_max_HSR) {
-        std::cout << "[WARNING] Joint HSR reference is out of bounds! Saturating." << std::endl;
-        joint_ref(4) = std::min(std::max(joint_ref(4), this->limits.q_min_HSR), this->limits.q_max_HSR);
-    }
-    if (joint_ref(5) < this->limits.q_min_KR || joint_ref(5) > this->limits.q_max_KR) {
-        std::cout << "[WARNING] Joint KR reference is out of bounds! Saturating." << std::endl;
-        joint_ref(5) = std::min(std::max(joint_ref(5), this->limits.q_min_KR), this->limits.q_max_KR);
-    }
+    // set the drive count
+    this->drives = drives;
+}
 
-    // // saturate the reference joint velocities
-    // if (joint_ref(6) < this->limits.qd_min_HFL || joint_ref(6) > this->limits.qd_max_HFL) {
-    //     std::cout << "[WARNING] Joint HFL reference velocity is out of bounds! Saturating." << std::endl;
-    //     joint_ref(6) = std::min(std::max(joint_ref(6), this->limits.qd_min_HFL), this->limits.qd_max_HFL);
-    // }
-    // if (joint_ref(7) < this->limits.qd_min_HSL || joint_ref(7) > this->limits.qd_max_HSL) {
-    //     std::cout << "[WARNING] Joint HSL reference velocity is out of bounds! Saturating." << std::endl;
-    //     joint_ref(7) = std::min(std::max(joint_ref(7), this->limits.qd_min_HSL), this->limits.qd_max_HSL);
-    // }
-    // if (joint_ref(8) < this->limits.qd_min_KL || joint_ref(8) > this->limits.qd_max_KL) {
-    //     std::cout << "[WARNING] Joint KL reference velocity is out of bounds! Saturating." << std::endl;
-    //     joint_ref(8) = std::min(std::max(joint_ref(8), this->limits.qd_min_KL), this->limits.qd_max_KL);
-    // }
-    // if (joint_ref(9) < this->limits.qd_min_HFR || joint_ref(9) > this->limits.qd_max_HFR) {
-    //     std::cout << "[WARNING] Joint HFR reference velocity is out of bounds! Saturating." << std::endl;
-    //     joint_ref(9) = std::min(std::max(joint_ref(9), this->limits.qd_min_HFR), this->limits.qd_max_HFR);
-    // }
-    // if (joint_ref(10) < this->limits.qd_min_HSR || joint_ref(10) > this->limits.qd_max_HSR) {
-    //     std::cout << "[WARNING] Joint HSR reference velocity is out of bounds! Saturating." << std::endl;
-    //     joint_ref(10) = std::min(std::max(joint_ref(10), this->limits.qd_min_HSR), this->limits.qd_max_HSR);
-    // }
-    // if (joint_ref(11) < this->limits.qd_min_KR || joint_ref(11) > this->limits.qd_max_KR) {
-    //     std::cout << "[WARNING] Joint KR reference velocity is out of bounds! Saturating." << std::endl;
-    //     joint_ref(11) = std::min(std::max(joint_ref(11), this->limits.qd_min_KR), this->limits.qd_max_KR);
-    // }
-    
-    // compute the torque for each joint
-    tau_HFL = this->gains.Kp_HFL * (joint_ref(0) - joint_data(0)) 
-            + this->gains.Kd_HFL * (joint_ref(6) - joint_data(6)) 
-            + this->gains.Kff_HFL * tau_ff(0);
-
-    tau_HSL = this->gains.Kp_HSL * (joint_ref(1) - joint_data(1))
-            + this->gains.Kd_HSL * (joint_ref(7) - joint_data(7))
-            + this->gains.Kff_HSL * tau_ff(1);
-
-    tau_KL =  this->gains.Kp_KL * (joint_ref(2) - joint_data(2))
-            + this->gains.Kd_KL * (joint_ref(8) - joint_data(8))
-            + this->gains.Kff_KL * tau_ff(2);
-
-    tau_HFR = this->gains.Kp_HFR * (joint_ref(3) - joint_data(3))
-            + this->gains.Kd_HFR * (joint_ref(9) - joint_data(9))
-            + this->gains.Kff_HFR * tau_ff(3);
-
-    tau_HSR = this->gains.Kp_HSR * (joint_ref(4) - joint_data(4))
-            + this->gains.Kd_HSR * (joint_ref(10) - joint_data(10))
-            + this->gains.Kff_HSR * tau_ff(4);
-
-    tau_KR =  this->gains.Kp_KR * (joint_ref(5) - joint_data(5))
-            + this->gains.Kd_KR * (joint_ref(11) - joint_data(11))
-            + this->gains.Kff_KR * tau_ff(5); 
-
-    // check that we have not exceeded the joint limits 
-    if (joint_data(0) < this->limits.q_min_HFL || joint_data(0) > this->limits.q_max_HFL) {
-        std::cout << "[WARNING] Joint HFL is out of bounds! Setting torque to zero." << std::endl;
-        tau_HFL = 0.0;
+// function to set the telemetry PDO objects and decimation
+void ELMOInterface::setTelemetryConfig(TelemetryConfig telemetry) {
+
+    // set the telemetry configuration
+    this->telemetry = telemetry;
+}
+
+// function to set the flight recorder configuration
+void ELMOInterface::setRecorderConfig(RecorderConfig recorder) {
+
+    // set the flight recorder configuration
+    this->recorder_config = recorder;
+}
+
+// function to freeze the flight recorder and write the last seconds of process data
+void ELMOInterface::triggerRecorder() {
+
+    if (this->recorder != NULL) {
+        this->recorder->trigger(RECORD_MANUAL);
     }
-    if (joint_data(1) < this->limits.q_min_HSL || joint_data(1) > this->limits.q_max_HSL) {
-        std::cout << "[WARNING] Joint HFL is out of bounds! Setting torque to zero." << std::endl;
-        tau_HSL = 0.0;
+}
+
+// function to run an external torque law in every bus cycle
+void ELMOInterface::setCycleController(CycleController *controller) {
+
+    // set the cycle controller
+    this->controller = controller;
+}
+
+// function to set how streamed setpoints are interpolated to the bus rate
+void ELMOInterface::setInterpConfig(InterpConfig interp) {
+
+    // set the interpolation configuration
+    this->interp = interp;
+}
+
+// function to select where the joint torques are computed
+void ELMOInterface::setControlMode(int mode) {
+
+    // set the control mode
+    this->control_mode = mode;
+}
+
+// function to get the cyclic loop timing statistics
+CycleStatsSummary ELMOInterface::getCycleStats() {
+
+    return this->data->stats.summary();
+}
+
+// function to get the bus health metrics of drive i (dropouts, faults, time to detect and to recover)
+DriveHealthSummary ELMOInterface::getHealthStats(int drive) {
+
+    return this->data->health.summary(drive);
+}
+
+// function to get the frame loss counters of the bus / of drive i
+LinkStatsSummary ELMOInterface::getLinkStats() {
+
+    return this->data->link.summary();
+}
+DriveLinkSummary ELMOInterface::getLinkStats(int drive) {
+
+    // empty for a drive that is not on the bus
+    if (drive < 0 || drive >= this->getDriveCount()) {
+        DriveLinkSummary none = {};
+        return none;
     }
-    if (joint_data(2) < this->limits.q_min_KL || joint_data(2) > this->limits.q_max_KL) {
-        std::cout << "[WARNING] Joint KL is out of bounds! Setting torque to zero." << std::endl;
-        tau_KL = 0.0;
+    return this->data->link.drive(drive);
+}
+
+// function to print the cyclic loop timing statistics
+void ELMOInterface::printCycleStats() {
+
+    this->data->stats.print();
+
+    // how often the in-cycle PD law ran ahead of the streamed setpoints
+    if (this->pd != NULL) {
+        printf("  setpoints: %llu interpolated, %llu extrapolated, %llu expired cycles\n",
+               (unsigned long long) this->pd->interpolated.load(std::memory_order_relaxed),
+               (unsigned long long) this->pd->extrapolated.load(std::memory_order_relaxed),
+               (unsigned long long) this->pd->expired.load(std::memory_order_relaxed));
     }
-    if (joint_data(3) < this->limits.q_min_HFR || joint_data(3) > this->limits.q_max_HFR) {
-        std::cout << "[WARNING] Joint HFR is out of bounds! Setting torque to zero." << std::endl;
-        tau_HFR = 0.0;
+
+    // flight recordings written
+    if (this->recorder != NULL) {
+        printf("  flight recorder: %llu recordings, %llu events while frozen\n",
+               (unsigned long long) this->recorder->getDumps(), (unsigned long long) this->recorder->getMissed());
     }
-    if (joint_data(4) < this->limits.q_min_HSR || joint_data(4) > this->limits.q_max_HSR) {
-        std::cout << "[WARNING] Joint HSR is out of bounds! Setting torque to zero." << std::endl;
-        tau_HSR = 0.0;
+
+    // SDO traffic next to the cyclic loop
+    ELMOMailbox &mailbox = this->data->mailbox;
+    if (mailbox.getCompleted() + mailbox.getFailed() + mailbox.getCancelled() > 0) {
+        printf("  mailbox: %llu transferred, %llu failed, %llu cancelled\n",
+               (unsigned long long) mailbox.getCompleted(), (unsigned long long) mailbox.getFailed(),
+               (unsigned long long) mailbox.getCancelled());
     }
-    if (joint_data(5) < this->limits.q_min_KR || joint_data(5) > this->limits.q_max_KR) {
-        std::cout << "[WARNING] Joint KR is out of bounds! Setting torque to zero." << std::endl;
-        tau_KR = 0.0;
+
+    // frames lost or partial, working counter drops and drives brought back by the health monitor
+    this->data->link.print();
+    this->data->health.print();
+}
+
+// functions to read / write an object of a drive through the mailbox worker
+std::future<SdoResult> ELMOInterface::sdoRead(int drive, uint16 index, uint8 subindex) {
+    return this->data->mailbox.read(drive, index, subindex);
+}
+std::future<SdoResult> ELMOInterface::sdoWrite(int drive, uint16 index, uint8 subindex, int size, uint32 value) {
+    return this->data->mailbox.write(drive, index, subindex, size, value);
+}
+bool ELMOInterface::sdoRead(int drive, uint16 index, uint8 subindex, SdoCallback done) {
+    return this->data->mailbox.read(drive, index, subindex, done);
+}
+bool ELMOInterface::sdoWrite(int drive, uint16 index, uint8 subindex, int size, uint32 value, SdoCallback done) {
+    return this->data->mailbox.write(drive, index, subindex, size, value, done);
+}
+
+// function to get a consistent snapshot of all drives (daisy chain order)
+const ELMOState &ELMOInterface::getState() {
+
+    // copy the newest snapshot published by the comm thread into the preallocated one
+    this->data->state.read(this->snapshot);
+
+    return this->snapshot;
+}
+
+// function to get the newest telemetry of all drives, the triple buffer hands over its front buffer
+const ELMOTelemetry &ELMOInterface::getTelemetry() {
+    return this->data->telemetry.read();
+}
+
+// function to get the ELMO status (reordered)
+ELMOStatus ELMOInterface::getELMOStatus() {
+
+    // take one snapshot so all drives come from the same bus cycle
+    return jointStatus(this->getState());
+}
+
+// function to get the raw encoder data from ELMO
+JointVec ELMOInterface::getEncoderData() {
+
+    // take one snapshot so all drives come from the same bus cycle
+    return jointEncoders(this->getState());
+}
+
+// function to compute the torque command
+JointTorque ELMOInterface::computeTorque(JointVec joint_ref, JointTorque tau_ff) {
+
+    // get the current joint state and gains
+    JointVec joint_data = this->getEncoderData();
+    this->updateParams();
+
+    // saturation, PD + feedforward and limit masking of all joints in one pass
+    int saturated, tripped;
+    JointTorque tau = jointPD(this->ramp.gains, this->active->limits, joint_ref, tau_ff, joint_data, saturated, tripped);
+
+    // only report joints that just went out of bounds
+    if (reportJoints(saturated, tripped, this->ref_saturated, this->joint_tripped) && this->recorder != NULL) {
+        this->recorder->trigger(RECORD_LIMIT);
     }
 
     // return the torque vector
-    tau << tau_HFL, tau_HSL, tau_KL, tau_HFR, tau_HSR, tau_KR;
-
     return tau;
 }
 
 // function to send target torque to the ELMO
 void ELMOInterface::sendTorque(JointTorque torque) {
     
-    // unpack the torque vector
-    double tau_HFL, tau_HSL, tau_KL, tau_HFR, tau_HSR, tau_KR;
-    tau_HFL = torque(0);
-    tau_HSL = torque(1);
-    tau_KL  = torque(2);
-    tau_HFR = torque(3);
-    tau_HSR = torque(4);
-    tau_KR  = torque(5);
-
-    // reorder the torques to match the ELMO daisy chain order
-    JointTorque torque_applied;
-    torque_applied << tau_HFL, tau_HSL, tau_HSR, tau_KL, tau_HFR, tau_KR;
-
-    // populate the data pointer with the torque values
-    for (int i = 0; i < 6; i++) {
-        this->data->torque[i] = (int16) torque_applied(i);
+    // fill the command buffer with the torques in daisy chain order and publish all drives at once
+    ELMOCommand &command = this->data->command.writeBuffer();
+    command.head.seq = ++this->command_seq;
+    command.head.timestamp = cycle_now_ns();
+    LegJointMap::toChain(torque.data(), command.drive.data(), &DriveCommand::torque);
+    this->data->command.publish();
+}
+
+// function to stream a setpoint to the in-cycle PD law
+void ELMOInterface::sendSetpoint(JointVec joint_ref, JointTorque tau_ff) {
+
+    // the PD law only runs in the bus cycle in CONTROL_CYCLE_PD mode without an external controller
+    if (this->pd == NULL) {
+        printf("ERROR : sendSetpoint needs the PD law in the bus cycle (CONTROL_CYCLE_PD, no controller set)\n");
+        return;
+    }
+
+    // fill the setpoint buffer and publish it, the comm thread picks it up in its next cycle
+    this->updateParams();
+    JointSetpoint &setpoint = this->pd->setpoint.writeBuffer();
+    setpoint.seq = ++this->command_seq;
+    setpoint.timestamp = cycle_now_ns();
+    setpoint.q_ref = joint_ref.head<NUM_JOINTS>().array();
+    setpoint.qd_ref = joint_ref.tail<NUM_JOINTS>().array();
+    setpoint.tau_ff = tau_ff.array();
+    setpoint.gains = this->ramp.gains;
+    this->pd->setpoint.publish();
+
+    // only report joints that just went out of bounds in the bus cycle
+    int saturated = this->pd->saturated.load(std::memory_order_relaxed);
+    int tripped = this->pd->tripped.load(std::memory_order_relaxed);
+    if (reportJoints(saturated, tripped, this->ref_saturated, this->joint_tripped) && this->recorder != NULL) {
+        this->recorder->trigger(RECORD_LIMIT);
+    }
+}
+
+// function to get the torques sent to the drives in the newest snapshot
+JointTorque ELMOInterface::getTorque() {
+    return jointTorques(this->getState());
+}
+
+// **************************************************************************************************************************
+
+// function to get the ELMO status out of a drive snapshot (reordered)
+ELMOStatus jointStatus(const ELMOState &state) {
+
+    const DriveState *drive = state.drive.data();
+    ELMOStatus tmp;
+
+    // poulate the Eigen vector with reordered data: inputs, control words, status words
+    LegJointMap::gather(drive, &DriveState::inputs, tmp.data());
+    LegJointMap::gather(drive, &DriveState::controlword, tmp.data() + LegJointMap::N);
+    LegJointMap::gather(drive, &DriveState::statusword, tmp.data() + 2 * LegJointMap::N);
+
+    return tmp;
+}
+
+// function to get the encoder data out of a drive snapshot
+JointVec jointEncoders(const ELMOState &state) {
+
+    const DriveState *drive = state.drive.data();
+    JointVec tmp;
+
+    // populate the Eigen vector with reordered and converted data: positions, velocities
+    LegJointMap::toJoint(drive, &DriveState::pos, tmp.data());
+    LegJointMap::toJoint(drive, &DriveState::vel, tmp.data() + LegJointMap::N);
+
+    return tmp;
+}
+
+// function to get the torques sent to the drives out of a drive snapshot
+JointTorque jointTorques(const ELMOState &state) {
+
+    JointTorque tmp;
+
+    LegJointMap::fromChain(state.drive.data(), &DriveState::torque, tmp.data());
+
+    return tmp;
+}
+
+// function to compute the PD + feedforward torques of the joints
+JointTorque jointPD(const JointGains &gains, const JointLimits &limits, const JointVec &joint_ref,
+                    const JointTorque &tau_ff, const JointVec &joint_data, int &saturated, int &tripped) {
+
+    JointArray tau;
+    pdTorque(gains, limits,
+             joint_ref.head<NUM_JOINTS>().array(), joint_ref.tail<NUM_JOINTS>().array(),
+             joint_data.head<NUM_JOINTS>().array(), joint_data.tail<NUM_JOINTS>().array(), tau_ff.array(),
+             tau, saturated, tripped);
+
+    return tau.matrix();
+}
+
+// function to print a warning for every joint in the mask
+static void warnJoints(int mask, const char *message) {
+
+    for (int i = 0; mask != 0 && i < NUM_JOINTS; i++) {
+        if (mask & (1 << i)) {
+            printf("[WARNING] Joint %s %s\n", JOINT_NAMES[i], message);
+        }
     }
 }
+
+// function to warn about the joints that just went out of bounds and keep the new masks
+int reportJoints(int saturated, int tripped, int &ref_saturated, int &joint_tripped) {
+
+    int just_tripped = tripped & ~joint_tripped;
+
+    warnJoints(saturated & ~ref_saturated, "reference is out of bounds! Saturating.");
+    warnJoints(just_tripped, "is out of bounds! Setting torque to zero.");
+    ref_saturated = saturated;
+    joint_tripped = tripped;
+
+    return just_tripped;
+}
+
+// **************************************************************************************************************************
+
+// constructor
+ELMOJointPD::ELMOJointPD(JointLimits limits, InterpConfig interp) : saturated(0), tripped(0), 
+                         interpolated(0), extrapolated(0), expired(0), limits(limits) {
+
+    this->interp.init(interp);
+}
+
+// function to size the torque command for the drives found
+void ELMOJointPD::init(int drives) {
+
+    this->command.drive.resize(drives);
+}
+
+// function to compute the torque of every drive from this cycle's encoders and the streamed setpoints
+const ELMOCommand &ELMOJointPD::update(const ELMOState &state) {
+
+    // joint limits, swapped ones are picked up at the cycle boundary
+    const JointLimits &limits = (this->params != NULL) ? this->params->read(PARAM_READER_BUS)->limits : this->limits;
+
+    // newest setpoint from the app, then the references at this cycle's time
+    const JointSetpoint &latest = this->setpoint.read();
+    if (latest.seq != 0) {
+        this->interp.push(latest);
+    }
+    JointSetpoint setpoint = latest;
+    int result = this->interp.sample(state.head.timestamp, setpoint);
+    switch (result) {
+        case SETPOINT_INTERPOLATED: this->interpolated.fetch_add(1, std::memory_order_relaxed); break;
+        case SETPOINT_EXTRAPOLATED: this->extrapolated.fetch_add(1, std::memory_order_relaxed); break;
+        case SETPOINT_EXPIRED:      this->expired.fetch_add(1, std::memory_order_relaxed); break;
+    }
+    const DriveState *drive = state.drive.data();
+
+    // fresh joint state from this cycle's snapshot
+    JointArray q, qd, tau;
+    LegJointMap::toJoint(drive, &DriveState::pos, q.data());
+    LegJointMap::toJoint(drive, &DriveState::vel, qd.data());
+
+    // saturation, PD + feedforward and limit masking of all joints in one pass
+    int saturated, tripped;
+    pdTorque(setpoint.gains, limits, setpoint.q_ref, setpoint.qd_ref, q, qd, setpoint.tau_ff, 
+             tau, saturated, tripped);
+    this->saturated.store(saturated, std::memory_order_relaxed);
+    this->tripped.store(tripped, std::memory_order_relaxed);
+
+    // no torque until the app sent its first setpoint
+    if (result == SETPOINT_NONE) {
+        tau.setZero();
+    }
+
+    // torques in daisy chain order
+    this->command.head.seq = latest.seq;
+    this->command.head.timestamp = latest.timestamp;
+    LegJointMap::toChain(tau.data(), this->command.drive.data(), &DriveCommand::torque);
+
+    return this->command;
+}
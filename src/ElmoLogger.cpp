@@ -0,0 +1,186 @@
+#include "../inc/ElmoLogger.hpp"
+
+// function to open the log file and start the writer thread
+bool ELMOLogger::start(const char* path, ELMOExecutor *executor) {
+
+    // open the binary log
+    this->file = fopen(path, "wb");
+    if (this->file == NULL) {
+        printf("Could not open log file %s\n", path);
+        return false;
+    }
+
+    // write the header
+    LogHeader header;
+    header.magic = LOG_MAGIC;
+    header.version = LOG_VERSION;
+    header.record_size = sizeof(LogRecord);
+    fwrite(&header, sizeof(header), 1, this->file);
+
+    this->running = true;
+
+    // writer thread in the executor's logger role
+    this->executor = executor;
+    if (executor != NULL) {
+        this->handle = executor->spawn(ROLE_LOGGER, "elmo_logger", &ELMOLogger::writerThread, (void *) this);
+        if (this->handle < 0) {
+            this->running = false;
+            fclose(this->file);
+            this->file = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    // writer thread runs at normal (non real-time) priority
+    pthread_attr_t attr;
+    struct sched_param param;
+    pthread_attr_init(&attr);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    param.sched_priority = 0;
+    pthread_attr_setschedparam(&attr, &param);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+
+    if (pthread_create(&this->writer, &attr, &ELMOLogger::writerThread, (void *) this) != 0) {
+        printf("Could not create the logger thread\n");
+        this->running = false;
+        fclose(this->file);
+        this->file = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+// function to drain the ring, close the file and join the writer thread
+void ELMOLogger::stop() {
+
+    if (this->file == NULL) {
+        return;
+    }
+
+    // the writer drains everything left in the ring before it exits
+    this->running = false;
+    if (this->executor != NULL) {
+        this->executor->join(this->handle);
+    }
+    else {
+        pthread_join(this->writer, NULL);
+    }
+
+    fclose(this->file);
+    this->file = NULL;
+
+    printf("Logger: %llu records written, %llu dropped\n",
+           (unsigned long long) this->getWritten(), (unsigned long long) this->getDropped());
+}
+
+// function to queue one record
+bool ELMOLogger::push(const LogRecord& record) {
+
+    // never wait on the disk, count the record as dropped instead
+    if (!this->ring.push(record)) {
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+// move up to one batch of records from the ring to the file
+size_t ELMOLogger::drain(LogRecord *batch) {
+
+    size_t n = 0;
+    while (n < LOG_BATCH_SIZE && this->ring.pop(batch[n])) {
+        n++;
+    }
+    if (n > 0) {
+        fwrite(batch, sizeof(LogRecord), n, this->file);
+        this->written.fetch_add(n, std::memory_order_relaxed);
+    }
+    return n;
+}
+
+// writer thread, batches records to disk
+void *ELMOLogger::writerThread(void *logger) {
+
+    ELMOLogger *self = (ELMOLogger *) logger;
+    LogRecord *batch = new LogRecord[LOG_BATCH_SIZE];
+
+    while (self->running) {
+        if (self->drain(batch) == 0) {
+            usleep(LOG_IDLE_US);
+        }
+    }
+
+    // flush whatever is left
+    while (self->drain(batch) > 0) {}
+    fflush(self->file);
+
+    delete[] batch;
+    return NULL;
+}
+
+// write one row of comma separated values
+static void writeRow(FILE *f, const double *v, int n) {
+
+    fprintf(f, "%g", v[0]);
+    for (int i = 1; i < n; i++) {
+        fprintf(f, ", %g", v[i]);
+    }
+    fprintf(f, "\n");
+}
+
+// function to convert a binary log into the CSV files read by data/plot_data.m
+int convertLogToCSV(const char* log_path, const char* csv_dir) {
+
+    FILE *in = fopen(log_path, "rb");
+    if (in == NULL) {
+        printf("Could not open log file %s\n", log_path);
+        return -1;
+    }
+
+    // check the header
+    LogHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != LOG_MAGIC ||
+        header.version != LOG_VERSION || header.record_size != sizeof(LogRecord)) {
+        printf("%s is not a compatible ELMO log\n", log_path);
+        fclose(in);
+        return -1;
+    }
+
+    // open the CSV files
+    char path[1028];
+    FILE *out[4];
+    const char *names[4] = {"time.csv", "data.csv", "commands.csv", "diagnostics.csv"};
+    for (int i = 0; i < 4; i++) {
+        snprintf(path, sizeof(path), "%s/%s", csv_dir, names[i]);
+        out[i] = fopen(path, "w");
+        if (out[i] == NULL) {
+            printf("Could not open %s\n", path);
+            for (int j = 0; j < i; j++) {
+                fclose(out[j]);
+            }
+            fclose(in);
+            return -1;
+        }
+    }
+
+    // convert every record
+    LogRecord record;
+    int count = 0;
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        writeRow(out[0], &record.time, 1);
+        writeRow(out[1], record.data, 18);
+        writeRow(out[2], record.commands, 18);
+        writeRow(out[3], record.diagnostics, 18);
+        count++;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        fclose(out[i]);
+    }
+    fclose(in);
+
+    printf("Converted %d records from %s to CSV in %s\n", count, log_path, csv_dir);
+    return count;
+}
@@ -0,0 +1,204 @@
+#include "../inc/ElmoMailbox.hpp"
+
+// constructor, requests can be queued before the worker starts
+ELMOMailbox::ELMOMailbox() : queue(MAILBOX_QUEUE), head(0), waiting(0), bus(NULL), executor(NULL), worker(-1), started(false), accepting(true),
+                             running(false), window(NULL), completed(0), failed(0), cancelled(0) {
+}
+
+// function to start the worker on an open bus
+bool ELMOMailbox::start(ELMOBus *bus, const CycleWindow *window, ELMOExecutor *executor) {
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->started || !this->accepting || executor == NULL) {
+        return false;
+    }
+    this->bus = bus;
+    this->window = window;
+    this->executor = executor;
+
+    // worker thread in the executor's logger role (non real-time by default), the comm thread always preempts it
+    this->running = true;
+    this->worker = executor->spawn(ROLE_LOGGER, "elmo_mailbox", &ELMOMailbox::workerThread, (void *) this);
+    if (this->worker < 0) {
+        printf("Could not create the mailbox thread\n");
+        this->running = false;
+        return false;
+    }
+    this->started = true;
+
+    return true;
+}
+
+// function to join the worker and cancel the requests left
+void ELMOMailbox::stop() {
+
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->accepting = false;
+        this->running = false;
+    }
+    this->wake.notify_all();
+
+    // the worker finishes the transfer it is in
+    if (this->started) {
+        this->executor->join(this->worker);
+        this->started = false;
+    }
+
+    // nothing else is sent on the bus
+    std::vector<Request> left;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        for (; this->waiting > 0; this->waiting--) {
+            left.push_back(std::move(this->queue[this->head]));
+            this->head = (this->head + 1) % MAILBOX_QUEUE;
+        }
+    }
+    for (size_t i = 0; i < left.size(); i++) {
+        this->complete(left[i], SDO_CANCELLED);
+    }
+}
+
+// function to build a request
+SdoResult ELMOMailbox::request(int drive, uint16 index, uint8 subindex, bool write, int size, uint32 value) {
+
+    SdoResult sdo;
+    sdo.drive = drive;
+    sdo.index = index;
+    sdo.subindex = subindex;
+    sdo.write = write;
+    sdo.size = size;
+    sdo.value = value;
+    sdo.status = SDO_CANCELLED;
+    sdo.t_queued = cycle_now_ns();
+    sdo.t_done = 0;
+
+    return sdo;
+}
+
+// requests completed through a future
+std::future<SdoResult> ELMOMailbox::read(int drive, uint16 index, uint8 subindex) {
+
+    Request req;
+    req.sdo = request(drive, index, subindex, false, sizeof(uint32), 0);
+    req.promise.reset(new std::promise<SdoResult>());
+    std::future<SdoResult> result = req.promise->get_future();
+    this->submit(req);
+
+    return result;
+}
+std::future<SdoResult> ELMOMailbox::write(int drive, uint16 index, uint8 subindex, int size, uint32 value) {
+
+    Request req;
+    req.sdo = request(drive, index, subindex, true, size, value);
+    req.promise.reset(new std::promise<SdoResult>());
+    std::future<SdoResult> result = req.promise->get_future();
+    this->submit(req);
+
+    return result;
+}
+
+// requests completed through a callback
+bool ELMOMailbox::read(int drive, uint16 index, uint8 subindex, SdoCallback done) {
+
+    Request req;
+    req.sdo = request(drive, index, subindex, false, sizeof(uint32), 0);
+    req.callback = done;
+
+    return this->submit(req);
+}
+bool ELMOMailbox::write(int drive, uint16 index, uint8 subindex, int size, uint32 value, SdoCallback done) {
+
+    Request req;
+    req.sdo = request(drive, index, subindex, true, size, value);
+    req.callback = done;
+
+    return this->submit(req);
+}
+
+// function to queue a request
+bool ELMOMailbox::submit(Request &req) {
+
+    bool queued = false;
+    if (req.sdo.size >= 1 && req.sdo.size <= (int) sizeof(uint32)) {
+
+        std::lock_guard<std::mutex> guard(this->lock);
+        if (this->accepting && this->waiting < MAILBOX_QUEUE) {
+            this->queue[(this->head + this->waiting) % MAILBOX_QUEUE] = std::move(req);
+            this->waiting++;
+            queued = true;
+        }
+    }
+
+    if (!queued) {
+        this->complete(req, SDO_CANCELLED);
+        return false;
+    }
+    this->wake.notify_one();
+
+    return true;
+}
+
+// function to fill in the outcome and complete the promise or call the callback
+void ELMOMailbox::complete(Request &req, int status) {
+
+    req.sdo.status = status;
+    req.sdo.t_done = cycle_now_ns();
+
+    std::atomic<uint64_t> &counter = (status == SDO_OK) ? this->completed
+                                   : (status == SDO_FAILED) ? this->failed
+                                   : this->cancelled;
+    counter.fetch_add(1, std::memory_order_relaxed);
+
+    if (req.callback) {
+        req.callback(req.sdo);
+    }
+    else if (req.promise) {
+        req.promise->set_value(req.sdo);
+    }
+}
+
+// worker thread, one transfer per window
+void *ELMOMailbox::workerThread(void *mailbox) {
+
+    ELMOMailbox *self = (ELMOMailbox *) mailbox;
+    int64_t last_close = 0;
+
+    while (true) {
+
+        // next request
+        Request req;
+        {
+            std::unique_lock<std::mutex> guard(self->lock);
+            self->wake.wait(guard, [self] { return !self->running.load() || self->waiting > 0; });
+            if (!self->running.load()) {
+                break;
+            }
+            req = std::move(self->queue[self->head]);
+            self->head = (self->head + 1) % MAILBOX_QUEUE;
+            self->waiting--;
+        }
+
+        // start right after a cycle's frame
+        if (!self->window->wait(last_close, self->running, MAILBOX_POLL_US)) {
+            self->complete(req, SDO_CANCELLED);
+            break;
+        }
+
+        SdoResult &sdo = req.sdo;
+        int wkc = 0;
+        if (sdo.drive >= 0 && sdo.drive < self->bus->slaveCount()) {
+
+            if (sdo.write) {
+                wkc = self->bus->sdoWrite(sdo.drive, sdo.index, sdo.subindex, sdo.size, &sdo.value, MAILBOX_TIMEOUT_US);
+            }
+            else {
+                sdo.value = 0;
+                wkc = self->bus->sdoRead(sdo.drive, sdo.index, sdo.subindex, &sdo.size, &sdo.value, MAILBOX_TIMEOUT_US);
+            }
+        }
+        self->complete(req, (wkc > 0) ? SDO_OK : SDO_FAILED);
+    }
+
+    return NULL;
+}
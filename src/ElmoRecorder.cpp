@@ -0,0 +1,187 @@
+#include "../inc/ElmoRecorder.hpp"
+
+// constructor, the ring is allocated once the drive count is known
+ELMORecorder::ELMORecorder(RecorderConfig config, double freq) : config(config), freq(freq), drives(0), slot_bytes(0),
+        capacity(0), post_cycles(0), next(0), count(0), post_left(-1), events(0), trigger_cycle(0), pending(0),
+        frozen(false), executor(NULL), dumper(-1), started(false), running(false), dumps(0), missed(0) {
+}
+
+// function to allocate the ring for the drives found and start the dump thread
+bool ELMORecorder::init(int drives, ELMOExecutor *executor) {
+
+    if (executor == NULL) {
+        printf("Could not create the flight recorder thread without an executor\n");
+        return false;
+    }
+
+    this->drives = drives;
+    this->slot_bytes = sizeof(RecordHead) + drives * sizeof(DriveState);
+    this->capacity = std::max((size_t) (this->config.window_s * this->freq), (size_t) 1);
+    this->post_cycles = (int64_t) (this->config.post_s * this->freq);
+
+    // fixed memory, zero filled so every page is touched before the loop starts
+    this->ring.assign(this->capacity * this->slot_bytes, 0);
+    this->next = 0;
+    this->count = 0;
+
+    printf("Flight recorder: %zu cycles (%.1f s), %.1f MB\n", this->capacity, this->config.window_s,
+           this->ring.size() / (1024.0 * 1024.0));
+
+    // dump thread in the executor's logger role (non real-time by default), the comm thread always preempts it
+    this->executor = executor;
+    this->running = true;
+    this->dumper = executor->spawn(ROLE_LOGGER, "elmo_recorder", &ELMORecorder::dumpThread, (void *) this);
+    if (this->dumper < 0) {
+        printf("Could not create the flight recorder thread\n");
+        this->running = false;
+        return false;
+    }
+    this->started = true;
+
+    return true;
+}
+
+// function to record one cycle
+void ELMORecorder::record(const RecordHead &head, const DriveState *drive) {
+
+    // events raised by other threads since the last cycle
+    uint32 events = head.events;
+    if (this->pending.load(std::memory_order_relaxed) != 0) {
+        events |= this->pending.exchange(0, std::memory_order_relaxed);
+    }
+
+    // the dump thread owns the ring until it is written
+    if (this->frozen.load(std::memory_order_acquire)) {
+        if (events & ~RECORD_STALE) {
+            this->missed.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    // one record: cycle fields and the drive snapshot
+    uint8_t *slot = this->ring.data() + this->next * this->slot_bytes;
+    RecordHead rec = head;
+    rec.events = events;
+    memcpy(slot, &rec, sizeof(rec));
+    if (drive != NULL) {
+        memcpy(slot + sizeof(RecordHead), drive, this->drives * sizeof(DriveState));
+    }
+    if (++this->next == this->capacity) {
+        this->next = 0;
+    }
+    if (this->count < this->capacity) {
+        this->count++;
+    }
+
+    // the first event arms the recorder, later ones are added to the same recording
+    uint32 trigger = events & ~RECORD_STALE;
+    if (this->post_left < 0) {
+        if (trigger == 0) {
+            return;
+        }
+        this->post_left = this->post_cycles;
+        this->events = trigger;
+        this->trigger_cycle = head.cycle;
+    }
+    else {
+        this->events |= trigger;
+    }
+
+    // freeze once the cycles after the event are in
+    if (this->post_left-- <= 0) {
+        this->post_left = -1;
+        this->frozen.store(true, std::memory_order_release);
+    }
+}
+
+// function to write an armed recording and join the dump thread
+void ELMORecorder::finish() {
+
+    if (!this->started) {
+        return;
+    }
+
+    // the loop stopped before the post event window was full, write what there is
+    if (this->post_left >= 0) {
+        this->post_left = -1;
+        this->frozen.store(true, std::memory_order_release);
+    }
+
+    this->running = false;
+    this->executor->join(this->dumper);
+    this->dumper = -1;
+    this->started = false;
+}
+
+// function to write the frozen ring as CSV, oldest cycle first
+void ELMORecorder::dump() {
+
+    char path[1100];
+    snprintf(path, sizeof(path), "%s/flight_%llu.csv", this->config.dir.c_str(), (unsigned long long) this->trigger_cycle);
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        printf("Could not open flight recording %s\n", path);
+    }
+    else {
+
+        // events of the recording, then one row per cycle
+        fprintf(file, "# events:%s%s%s%s, first event in cycle %llu\n",
+                (this->events & RECORD_FAULT) ? " fault" : "", (this->events & RECORD_WKC) ? " wkc" : "",
+                (this->events & RECORD_LIMIT) ? " limit" : "", (this->events & RECORD_MANUAL) ? " manual" : "",
+                (unsigned long long) this->trigger_cycle);
+        fprintf(file, "cycle,deadline_ns,t_recv_ns,wkc,events");
+        for (int j = 1; j <= this->drives; j++) {
+            fprintf(file, ",pos%d,vel%d,inputs%d,torque%d,controlword%d,statusword%d,stale%d", j, j, j, j, j, j, j);
+        }
+        fprintf(file, "\n");
+
+        size_t first = (this->count < this->capacity) ? 0 : this->next;
+        for (size_t k = 0; k < this->count; k++) {
+
+            const uint8_t *slot = this->ring.data() + ((first + k) % this->capacity) * this->slot_bytes;
+            RecordHead head;
+            memcpy(&head, slot, sizeof(head));
+            fprintf(file, "%llu,%lld,%lld,%d,%u", (unsigned long long) head.cycle, (long long) head.deadline_ns,
+                    (long long) head.t_recv, head.wkc, head.events);
+
+            for (int j = 0; j < this->drives; j++) {
+                DriveState drive;
+                memcpy(&drive, slot + sizeof(RecordHead) + j * sizeof(DriveState), sizeof(drive));
+                fprintf(file, ",%d,%d,%u,%d,%u,%u,%u", drive.pos, drive.vel, drive.inputs, drive.torque,
+                        drive.controlword, drive.statusword, drive.stale);
+            }
+            fprintf(file, "\n");
+        }
+        fclose(file);
+
+        this->dumps.fetch_add(1, std::memory_order_relaxed);
+        printf("Flight recorder: %zu cycles around cycle %llu written to %s\n", this->count,
+               (unsigned long long) this->trigger_cycle, path);
+    }
+
+    // hand the ring back to the comm thread, recording starts over
+    this->next = 0;
+    this->count = 0;
+    this->frozen.store(false, std::memory_order_release);
+}
+
+// dump thread, writes the ring every time it freezes
+void *ELMORecorder::dumpThread(void *recorder) {
+
+    ELMORecorder *self = (ELMORecorder *) recorder;
+
+    while (true) {
+
+        bool running = self->running.load();
+        if (self->frozen.load(std::memory_order_acquire)) {
+            self->dump();
+        }
+        if (!running) {
+            break;
+        }
+        usleep(RECORDER_IDLE_US);
+    }
+
+    return NULL;
+}
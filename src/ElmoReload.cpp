@@ -0,0 +1,171 @@
+#include "../inc/ElmoReload.hpp"
+#include "../inc/ElmoConfig.hpp"
+
+// Standard headers
+#include <cmath>
+#include <poll.h>
+#include <sys/inotify.h>
+
+// Other imports
+#include <yaml-cpp/yaml.h>
+
+// function to check gains and limits
+bool checkParams(const JointParams &params) {
+
+    bool ok = true;
+    for (int i = 0; i < NUM_JOINTS; i++) {
+
+        const JointGains &g = params.gains;
+        const JointLimits &l = params.limits;
+        if (!(std::isfinite(g.Kp(i)) && std::isfinite(g.Kd(i)) && std::isfinite(g.Kff(i)) &&
+              g.Kp(i) >= 0.0 && g.Kd(i) >= 0.0)) {
+            printf("WARNING : joint %s gains have to be finite, Kp and Kd not negative\n", JOINT_NAMES[i]);
+            ok = false;
+        }
+        if (!(std::isfinite(l.q_min(i)) && std::isfinite(l.q_max(i)) && l.q_min(i) < l.q_max(i) &&
+              std::isfinite(l.qd_min(i)) && std::isfinite(l.qd_max(i)) && l.qd_min(i) < l.qd_max(i))) {
+            printf("WARNING : joint %s limits have to be finite with min < max\n", JOINT_NAMES[i]);
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+// function to start watching the config file
+bool ELMOConfigWatcher::start(const char *path, ReloadConfig config, ELMOInterface *elmo, ELMOExecutor *executor) {
+
+    this->path = path;
+    size_t slash = this->path.rfind('/');
+    this->dir = (slash == std::string::npos) ? "." : this->path.substr(0, slash);
+    this->name = (slash == std::string::npos) ? this->path : this->path.substr(slash + 1);
+    this->config = config;
+    this->elmo = elmo;
+
+    // values in use, the loops started with the file as it is now
+    try {
+        ELMOConfig file = loadConfig(this->path);
+        this->params = {file.gains, file.limits, config.ramp_s};
+    }
+    catch (const YAML::Exception &e) {
+        printf("Could not read %s: %s\n", path, e.what());
+        return false;
+    }
+
+    this->running = true;
+
+    // watcher thread in the executor's logger role, it never runs in the loops
+    this->executor = executor;
+    this->handle = executor->spawn(ROLE_LOGGER, "elmo_reload", &ELMOConfigWatcher::watcherThread, (void *) this);
+    if (this->handle < 0) {
+        this->running = false;
+        return false;
+    }
+
+    printf("Watching %s for gain and limit changes\n", path);
+
+    return true;
+}
+
+// function to stop watching and join the thread
+void ELMOConfigWatcher::stop() {
+
+    if (!this->running.exchange(false)) {
+        return;
+    }
+    this->executor->join(this->handle);
+    this->handle = -1;
+}
+
+// function to parse and check the file and swap the values in
+void ELMOConfigWatcher::reload() {
+
+    JointParams params;
+    try {
+        ELMOConfig file = loadConfig(this->path);
+        params = {file.gains, file.limits, this->config.ramp_s};
+    }
+    catch (const YAML::Exception &e) {
+        printf("WARNING : %s not reloaded: %s\n", this->path.c_str(), e.what());
+        this->rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!checkParams(params)) {
+        printf("WARNING : %s not reloaded, keeping the gains and limits in use\n", this->path.c_str());
+        this->rejected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // the rest of the file is not reloaded, only act on gain or limit changes
+    const JointGains &g0 = this->params.gains, &g1 = params.gains;
+    const JointLimits &l0 = this->params.limits, &l1 = params.limits;
+    if ((g0.Kp == g1.Kp).all() && (g0.Kd == g1.Kd).all() && (g0.Kff == g1.Kff).all() &&
+        (l0.q_min == l1.q_min).all() && (l0.q_max == l1.q_max).all() &&
+        (l0.qd_min == l1.qd_min).all() && (l0.qd_max == l1.qd_max).all()) {
+        return;
+    }
+
+    // the previous swap is normally out of the loops within a tick
+    int64 t_end = cycle_now_ns() + (int64) (RELOAD_SWAP_S * 1e9);
+    while (!this->elmo->setParams(params)) {
+        if (cycle_now_ns() >= t_end || !this->running) {
+            printf("WARNING : %s not reloaded, the loops still use the previous gains and limits\n", this->path.c_str());
+            this->rejected.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        usleep(1000);
+    }
+    this->params = params;
+    this->reloads.fetch_add(1, std::memory_order_relaxed);
+
+    printf("Reloaded the gains and limits from %s (blended in over %.2f s)\n", this->path.c_str(), this->config.ramp_s);
+}
+
+// watcher thread
+void *ELMOConfigWatcher::watcherThread(void *arg) {
+
+    ELMOConfigWatcher *self = (ELMOConfigWatcher *) arg;
+
+    // watch the directory, editors replace the file rather than write it in place
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, self->dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        printf("WARNING : could not watch %s, gains and limits will not be reloaded\n", self->dir.c_str());
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool pending = false;
+    struct pollfd pfd = {fd, POLLIN, 0};
+    while (self->running) {
+
+        // wait for events, once the file changed wait until it has been quiet for a while
+        int ready = poll(&pfd, 1, pending ? RELOAD_SETTLE_MS : RELOAD_POLL_MS);
+        if (ready < 0) {
+            continue;
+        }
+        if (ready == 0) {
+            if (pending) {
+                pending = false;
+                self->reload();
+            }
+            continue;
+        }
+
+        // events on the watched file
+        ssize_t len = read(fd, buf, sizeof(buf));
+        for (char *p = buf; len > 0 && p < buf + len; ) {
+            struct inotify_event *event = (struct inotify_event *) p;
+            if (event->len > 0 && self->name == event->name) {
+                pending = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    close(fd);
+
+    return NULL;
+}
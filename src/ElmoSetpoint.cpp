@@ -0,0 +1,104 @@
+#include "../inc/ElmoSetpoint.hpp"
+
+// function to set the interpolation mode, delay, horizon and fallback
+void SetpointInterpolator::init(InterpConfig config) {
+
+    this->config = config;
+    this->held = 0;
+}
+
+// function to take in a new setpoint, older or repeated setpoints are ignored
+void SetpointInterpolator::push(const JointSetpoint &setpoint) {
+
+    if (this->held > 0 && (setpoint.seq == this->next.seq || setpoint.timestamp <= this->next.timestamp)) {
+        return;
+    }
+
+    this->prev = this->next;
+    this->next = setpoint;
+    this->held = (this->held < 2) ? this->held + 1 : 2;
+}
+
+// function to get the references at time t [ns]
+int SetpointInterpolator::sample(int64_t t, JointSetpoint &out) const {
+
+    if (this->held == 0) {
+        return SETPOINT_NONE;
+    }
+
+    const JointSetpoint &a = this->prev;
+    const JointSetpoint &b = this->next;
+
+    // play the references back late so the time normally falls between the two setpoints
+    int64_t t_ref = t - (int64_t) (this->config.delay_us * 1e3);
+
+    out.seq = b.seq;
+    out.timestamp = t_ref;
+    out.gains = b.gains;
+
+    /* between the two setpoints */
+    if (this->held == 2 && t_ref < b.timestamp) {
+
+        // before the older setpoint: hold it
+        if (t_ref <= a.timestamp) {
+            out.q_ref = a.q_ref;
+            out.qd_ref = a.qd_ref;
+            out.tau_ff = a.tau_ff;
+            return SETPOINT_INTERPOLATED;
+        }
+
+        double h = (b.timestamp - a.timestamp) * 1e-9;
+        double s = (t_ref - a.timestamp) * 1e-9 / h;
+
+        switch (this->config.mode) {
+
+            case INTERP_ZOH:
+                out.q_ref = a.q_ref;
+                out.qd_ref = a.qd_ref;
+                out.tau_ff = a.tau_ff;
+                break;
+
+            case INTERP_LINEAR:
+                out.q_ref = a.q_ref + s * (b.q_ref - a.q_ref);
+                out.qd_ref = a.qd_ref + s * (b.qd_ref - a.qd_ref);
+                out.tau_ff = a.tau_ff + s * (b.tau_ff - a.tau_ff);
+                break;
+
+            default: {
+                // cubic Hermite basis and its derivative
+                double s2 = s * s, s3 = s2 * s;
+                double h00 = 2.0 * s3 - 3.0 * s2 + 1.0, h10 = s3 - 2.0 * s2 + s;
+                double h01 = -2.0 * s3 + 3.0 * s2,      h11 = s3 - s2;
+                double d00 = 6.0 * s2 - 6.0 * s,        d10 = 3.0 * s2 - 4.0 * s + 1.0;
+                double d01 = -6.0 * s2 + 6.0 * s,       d11 = 3.0 * s2 - 2.0 * s;
+
+                out.q_ref = h00 * a.q_ref + (h10 * h) * a.qd_ref + h01 * b.q_ref + (h11 * h) * b.qd_ref;
+                out.qd_ref = (d00 / h) * a.q_ref + d10 * a.qd_ref + (d01 / h) * b.q_ref + d11 * b.qd_ref;
+                out.tau_ff = a.tau_ff + s * (b.tau_ff - a.tau_ff);
+                break;
+            }
+        }
+        return SETPOINT_INTERPOLATED;
+    }
+
+    /* past the newest setpoint (or it is the only one) */
+    double dt = (t_ref > b.timestamp) ? (t_ref - b.timestamp) * 1e-9 : 0.0;
+
+    // the app stopped streaming: fall back
+    if (dt * 1e6 > this->config.horizon_us) {
+        out.q_ref = b.q_ref;
+        out.qd_ref.setZero();
+        out.tau_ff.setZero();
+        if (this->config.fallback == FALLBACK_DAMP) {
+            out.gains.Kp.setZero();
+        }
+        return SETPOINT_EXPIRED;
+    }
+
+    // hold, or extrapolate with the newest velocity
+    out.q_ref = (this->config.mode == INTERP_ZOH) ? b.q_ref : JointArray(b.q_ref + dt * b.qd_ref);
+    out.qd_ref = b.qd_ref;
+    out.tau_ff = b.tau_ff;
+
+    return (dt > 0.0) ? SETPOINT_EXTRAPOLATED : SETPOINT_INTERPOLATED;
+}
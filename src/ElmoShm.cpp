@@ -0,0 +1,143 @@
+#include "../inc/ElmoShm.hpp"
+
+// function to create (or take over) the segment
+ShmBus *shmCreate(const char *name, double freq) {
+
+    // a segment left by a daemon that died is set up again
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0660);
+    if (fd < 0) {
+        printf("Could not create shared memory %s (%s)\n", name, strerror(errno));
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(ShmBus)) != 0) {
+        printf("Could not size shared memory %s (%s)\n", name, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    void *addr = mmap(NULL, sizeof(ShmBus), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        printf("Could not map shared memory %s (%s)\n", name, strerror(errno));
+        return NULL;
+    }
+
+    // channels and counters start zeroed, the magic tells clients the segment is ready
+    ShmBus *shm = new (addr) ShmBus();
+    shm->version = SHM_VERSION;
+    shm->daemon = getpid();
+    shm->freq = freq;
+    shm->command.init(ShmCommand());
+    shm->magic.store(SHM_MAGIC, std::memory_order_release);
+
+    return shm;
+}
+
+// function to map an existing segment
+ShmBus *shmAttach(const char *name) {
+
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(ShmBus)) {
+        close(fd);
+        return NULL;
+    }
+    void *addr = mmap(NULL, sizeof(ShmBus), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        return NULL;
+    }
+
+    // a segment that is not set up yet, of another layout, or left by a daemon that is gone
+    ShmBus *shm = (ShmBus *) addr;
+    if (shm->magic.load(std::memory_order_acquire) != SHM_MAGIC || shm->version != SHM_VERSION ||
+        kill(shm->daemon, 0) != 0) {
+        munmap(addr, sizeof(ShmBus));
+        return NULL;
+    }
+
+    return shm;
+}
+
+// function to unmap the segment
+void shmDetach(ShmBus *shm) {
+
+    if (shm != NULL) {
+        munmap((void *) shm, sizeof(ShmBus));
+    }
+}
+
+// function to unmap and remove the segment
+void shmRemove(ShmBus *shm, const char *name) {
+
+    if (shm != NULL) {
+        shm->magic.store(0, std::memory_order_release);
+        shmDetach(shm);
+    }
+    shm_unlink(name);
+}
+
+// **************************************************************************************************************************
+
+// constructor
+ELMOShmBridge::ELMOShmBridge(ShmBus *shm, ShmConfig config, JointLimits limits, InterpConfig interp) : shm(shm),
+                             timeout_ns((int64) (config.heartbeat_s * 1e9)), pd(limits, interp), setpoint_seq(0) {
+}
+
+// function to size the commands for the drives found, the segment has room for SHM_MAX_DRIVES
+void ELMOShmBridge::init(int drives) {
+
+    if (drives > SHM_MAX_DRIVES) {
+        printf("WARNING : %d drives on the chain, only the first %d are shared\n", drives, SHM_MAX_DRIVES);
+    }
+    this->pd.init(drives);
+    this->command.drive.resize(drives);
+    this->zero.drive.resize(drives);
+    this->shm->drives.store(std::min(drives, SHM_MAX_DRIVES), std::memory_order_release);
+}
+
+// function to publish the snapshot and apply the client's newest command
+const ELMOCommand &ELMOShmBridge::update(const ELMOState &state) {
+
+    ShmBus *shm = this->shm;
+    int drives = shm->drives.load(std::memory_order_relaxed);
+
+    // newest snapshot for the client
+    ShmState &out = shm->state.beginWrite();
+    out.head = state.head;
+    out.count = drives;
+    memcpy(out.drive, state.drive.data(), drives * sizeof(DriveState));
+    shm->state.endWrite();
+
+    // zero torque without a client, or once its newest command is older than the timeout
+    const ShmCommand &cmd = shm->command.read();
+    int64 attached = shm->attached.load(std::memory_order_acquire);
+    bool alive = shm->client.load(std::memory_order_relaxed) != 0 && cmd.head.seq != 0 && cmd.head.timestamp >= attached &&
+                 state.head.timestamp - shm->heartbeat.load(std::memory_order_relaxed) < this->timeout_ns;
+    if (!alive) {
+        shm->held.fetch_add(1, std::memory_order_relaxed);
+        return this->zero;
+    }
+
+    // setpoint: the PD law runs here on this cycle's encoders
+    if (cmd.head.mode == SHM_SETPOINT) {
+        if (cmd.head.seq != this->setpoint_seq) {
+            this->setpoint_seq = cmd.head.seq;
+            this->pd.setpoint.writeBuffer() = cmd.setpoint;
+            this->pd.setpoint.publish();
+        }
+        const ELMOCommand &tau = this->pd.update(state);
+        shm->saturated.store(this->pd.saturated.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        shm->tripped.store(this->pd.tripped.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return tau;
+    }
+
+    // torque of every drive
+    this->command.head.seq = cmd.head.seq;
+    this->command.head.timestamp = cmd.head.timestamp;
+    memcpy(this->command.drive.data(), cmd.drive, drives * sizeof(DriveCommand));
+
+    return this->command;
+}
@@ -0,0 +1,103 @@
+#include "../inc/ElmoStats.hpp"
+
+// function to clear all samples
+void LatencyHistogram::reset() {
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        this->counts[i].store(0, std::memory_order_relaxed);
+    }
+    this->count.store(0, std::memory_order_relaxed);
+    this->sum.store(0, std::memory_order_relaxed);
+    this->min.store(INT64_MAX, std::memory_order_relaxed);
+    this->max.store(0, std::memory_order_relaxed);
+}
+
+// function to get the value at a quantile in [0, 1]
+int64_t LatencyHistogram::quantile(double q) const {
+
+    uint64_t total = this->count.load(std::memory_order_relaxed);
+    if (total == 0) {
+        return 0;
+    }
+
+    // walk the buckets until the cumulative count reaches the target rank
+    uint64_t rank = (uint64_t) (q * (double) total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += this->counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // clamp the bucket midpoint to the exact extremes
+            int64_t v = valueOf(i);
+            int64_t lo = this->min.load(std::memory_order_relaxed);
+            int64_t hi = this->max.load(std::memory_order_relaxed);
+            return (v < lo) ? lo : ((v > hi) ? hi : v);
+        }
+    }
+    return this->max.load(std::memory_order_relaxed);
+}
+
+// function to compute min/p50/p99/p99.9/max
+TimingSummary LatencyHistogram::summary() const {
+
+    TimingSummary s;
+    s.count = this->count.load(std::memory_order_relaxed);
+    s.mean = (s.count > 0) ? (double) this->sum.load(std::memory_order_relaxed) / (double) s.count : 0.0;
+    s.min = (s.count > 0) ? this->min.load(std::memory_order_relaxed) : 0;
+    s.p50 = this->quantile(0.50);
+    s.p99 = this->quantile(0.99);
+    s.p999 = this->quantile(0.999);
+    s.max = this->max.load(std::memory_order_relaxed);
+
+    return s;
+}
+
+// function to summarize all histograms
+CycleStatsSummary CycleStats::summary() const {
+
+    CycleStatsSummary s;
+    s.period = this->period.summary();
+    s.wakeup = this->wakeup.summary();
+    s.roundtrip = this->roundtrip.summary();
+    s.io = this->io.summary();
+    s.processing = this->processing.summary();
+    s.overruns = this->overruns.load(std::memory_order_relaxed);
+    s.skipped = this->skipped.load(std::memory_order_relaxed);
+    s.dc_offset = this->dc_offset.summary();
+    s.dc_drift_ppm = this->dc_drift_ppb.load(std::memory_order_relaxed) * 1e-3;
+
+    return s;
+}
+
+// print one summary row in microseconds
+static void printRow(const char *name, const TimingSummary &t) {
+
+    printf("  %-11s %10llu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", name,
+           (unsigned long long) t.count, t.min / 1e3, t.p50 / 1e3, t.p99 / 1e3,
+           t.p999 / 1e3, t.max / 1e3, t.mean / 1e3);
+}
+
+// function to print the summary
+void CycleStats::print() const {
+
+    CycleStatsSummary s = this->summary();
+
+    printf("Cycle timing [us]:\n");
+    printf("  %-11s %10s %9s %9s %9s %9s %9s %9s\n", "", "count", "min", "p50", "p99", "p99.9", "max", "mean");
+    printRow("period", s.period);
+    printRow("wakeup", s.wakeup);
+    printRow("roundtrip", s.roundtrip);
+    printRow("bus io", s.io);
+    printRow("processing", s.processing);
+    if (s.dc_offset.count > 0) {
+        printRow("dc offset", s.dc_offset);
+    }
+    printf("  overruns: %llu, skipped cycles: %llu\n",
+           (unsigned long long) s.overruns, (unsigned long long) s.skipped);
+    if (s.dc_offset.count > 0) {
+        printf("  dc drift: %.3f ppm, last dc offset: %.2f us\n", 
+               s.dc_drift_ppm, this->dc_offset_ns.load(std::memory_order_relaxed) / 1e3);
+    }
+}
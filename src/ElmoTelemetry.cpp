@@ -0,0 +1,75 @@
+#include "../inc/ElmoTelemetry.hpp"
+
+// objects that can be mapped, indexed by TELEM_*
+const TelemetryObject telemetry_objects[TELEM_FIELDS] = {
+    {"current",         0x6078, 0, 2, true},
+    {"dc_voltage",      0x6079, 0, 4, false},
+    {"temperature",     0x22A2, 1, 2, true},
+    {"following_error", 0x60F4, 0, 4, true},
+    {"torque",          0x6077, 0, 2, true},
+};
+
+// function to find a telemetry object by name
+int telemetryObject(const std::string &name) {
+
+    for (int k = 0; k < TELEM_FIELDS; k++) {
+        if (name == telemetry_objects[k].name) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+// constructor, nothing mapped
+TelemetryLayout::TelemetryLayout() : fields(0), size(0) {
+
+    for (int k = 0; k < TELEM_FIELDS; k++) {
+        this->order[k] = -1;
+        this->offset[k] = -1;
+    }
+}
+
+// constructor, packs the configured objects in order, unknown and repeated objects are skipped
+TelemetryLayout::TelemetryLayout(const TelemetryConfig &config) : TelemetryLayout() {
+
+    for (size_t k = 0; k < config.objects.size(); k++) {
+
+        int object = config.objects[k];
+        if (object < 0 || object >= TELEM_FIELDS || this->has(object)) {
+            continue;
+        }
+        this->order[this->fields++] = object;
+        this->offset[object] = this->size;
+        this->size += telemetry_objects[object].size;
+    }
+}
+
+// PDO mapping entry of the k-th mapped object
+uint32_t TelemetryLayout::mapping(int k) const {
+
+    const TelemetryObject &obj = telemetry_objects[this->order[k]];
+    return ((uint32_t) obj.index << 16) | ((uint32_t) obj.subindex << 8) | (uint32_t) (obj.size * 8);
+}
+
+// function to write one object into a telemetry image
+void TelemetryLayout::set(uint8_t *image, int object, int32_t value) const {
+
+    if (!this->has(object)) {
+        return;
+    }
+    if (telemetry_objects[object].size == 2) {
+        uint16_t v = (uint16_t) value;
+        memcpy(image + this->offset[object], &v, sizeof(v));
+    }
+    else {
+        memcpy(image + this->offset[object], &value, sizeof(value));
+    }
+}
+
+// function to decode every object of a drive
+void TelemetryLayout::decode(const uint8_t *image, DriveTelemetry &out) const {
+
+    for (int k = 0; k < TELEM_FIELDS; k++) {
+        out.value[k] = this->get(image, k);
+    }
+}
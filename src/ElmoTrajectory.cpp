@@ -0,0 +1,375 @@
+#include "../inc/ElmoTrajectory.hpp"
+
+// Standard headers
+#include <stdlib.h>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// function to get the sine references
+void SineTrajectory::eval(double t, TrajectoryPoint &out) {
+
+    double w = 2.0 * M_PI * this->config.frequency;
+
+    out.q = this->config.offset + this->config.amplitude * sin(w * t);
+    out.qd = this->config.amplitude * (w * cos(w * t));
+    out.tau_ff.setZero();
+}
+
+// function to get the chirp references
+void ChirpTrajectory::eval(double t, TrajectoryPoint &out) {
+
+    double f0 = this->config.frequency;
+    double f1 = this->config.frequency_end;
+    double T = this->config.duration;
+
+    // phase and instantaneous frequency, the frequency rises linearly over the sweep then stays at f1
+    double phase, f;
+    if (t < T) {
+        phase = 2.0 * M_PI * (f0 * t + 0.5 * (f1 - f0) * t * t / T);
+        f = f0 + (f1 - f0) * t / T;
+    }
+    else {
+        phase = 2.0 * M_PI * (0.5 * (f0 + f1) * T + f1 * (t - T));
+        f = f1;
+    }
+
+    out.q = this->config.offset + this->config.amplitude * sin(phase);
+    out.qd = this->config.amplitude * (2.0 * M_PI * f * cos(phase));
+    out.tau_ff.setZero();
+}
+
+// function to get the step references
+void StepTrajectory::eval(double t, TrajectoryPoint &out) {
+
+    out.q = (t < this->config.duration) ? this->config.offset : (this->config.offset + this->config.amplitude).eval();
+    out.qd.setZero();
+    out.tau_ff.setZero();
+}
+
+// function to map a trajectory file
+bool FileTrajectory::open(const char *path) {
+
+    this->close();
+
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        printf("ERROR : could not open trajectory file %s\n", path);
+        return false;
+    }
+
+    // check the header against the file size
+    TrajectoryHeader header;
+    struct stat st;
+    if (read(fd, &header, sizeof(header)) != (ssize_t) sizeof(header) || fstat(fd, &st) != 0 ||
+        header.magic != TRAJ_MAGIC || header.version != TRAJ_VERSION || header.joints != NUM_JOINTS ||
+        header.samples == 0 || !(header.dt > 0.0) ||
+        (uint64_t) st.st_size < sizeof(header) + header.samples * sizeof(TrajectorySample)) {
+        printf("ERROR : %s is not a compatible trajectory file\n", path);
+        ::close(fd);
+        return false;
+    }
+
+    // map it read only, the mapping keeps the file open
+    size_t bytes = sizeof(header) + header.samples * sizeof(TrajectorySample);
+    void *map = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        printf("ERROR : could not map trajectory file %s\n", path);
+        return false;
+    }
+    madvise(map, bytes, MADV_SEQUENTIAL);
+
+    this->map = map;
+    this->map_bytes = bytes;
+    this->samples = (const TrajectorySample *) ((const char *) map + sizeof(header));
+    this->count = header.samples;
+    this->dt = header.dt;
+    this->window = (uint64_t) ceil(TRAJ_WINDOW_S / header.dt);
+
+    // read the first window in and the next one ahead
+    this->ahead = 0;
+    this->behind = 0;
+    this->advance(0);
+
+    printf("Trajectory %s: %llu samples, %.3f ms apart, %.1f s\n", path, (unsigned long long) this->count,
+           this->dt * 1e3, this->duration());
+
+    return true;
+}
+
+// function to unmap the file
+void FileTrajectory::close() {
+
+    if (this->map != NULL) {
+        munmap(this->map, this->map_bytes);
+    }
+    this->map = NULL;
+    this->map_bytes = 0;
+    this->samples = NULL;
+    this->count = 0;
+}
+
+// function to read the next window ahead and drop the one behind the playhead
+void FileTrajectory::advance(uint64_t k) {
+
+    // nothing to do until the playhead gets into the last window read ahead
+    if (k + this->window < this->ahead) {
+        return;
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    char *base = (char *) this->map;
+    char *end = base + this->map_bytes;
+
+    // page aligned byte range of samples [from, to)
+    auto range = [&](uint64_t from, uint64_t to, char *&a, char *&b) {
+        a = (char *) this->samples + std::min(from, this->count) * sizeof(TrajectorySample);
+        b = (char *) this->samples + std::min(to, this->count) * sizeof(TrajectorySample);
+        a = base + ((a - base) / page) * page;
+        b = std::min(base + ((b - base + page - 1) / page) * page, end);
+    };
+
+    char *a, *b;
+
+    // the window after the playhead's was requested one window ago, fault it in now so eval does not
+    uint64_t start = std::max(this->ahead, k);
+    range(start, k + 2 * this->window, a, b);
+    for (volatile char *p = a; p < b; p += page) {
+        (void) *p;
+    }
+
+    // ask for the window after that, it is read in the background
+    range(k + 2 * this->window, k + 3 * this->window, a, b);
+    if (a < b) {
+        madvise(a, b - a, MADV_WILLNEED);
+    }
+    this->ahead = k + 2 * this->window;
+
+    // drop what is more than a window behind, locked pages are unlocked first (mlockall)
+    if (k > this->behind + 2 * this->window) {
+        range(this->behind, k - this->window, a, b);
+        b = base + ((b - base) / page) * page;
+        if (a < b) {
+            munlock(a, b - a);
+            madvise(a, b - a, MADV_DONTNEED);
+        }
+        this->behind = k - this->window;
+    }
+}
+
+// function to get the references at time t
+void FileTrajectory::eval(double t, TrajectoryPoint &out) {
+
+    // hold the first / last position outside the file
+    double x = t / this->dt;
+    if (!(x >= 0.0) || this->count == 1) {
+        const TrajectorySample &a = this->samples[0];
+        out.q = Eigen::Map<const JointArray>(a.q);
+        out.qd.setZero();
+        out.tau_ff = Eigen::Map<const JointArray>(a.tau_ff);
+        return;
+    }
+    if (x > (double) (this->count - 1)) {
+        const TrajectorySample &b = this->samples[this->count - 1];
+        out.q = Eigen::Map<const JointArray>(b.q);
+        out.qd.setZero();
+        out.tau_ff = Eigen::Map<const JointArray>(b.tau_ff);
+        return;
+    }
+
+    // sample pair by index
+    uint64_t k = std::min((uint64_t) x, this->count - 2);
+    double s = x - (double) k;
+    double h = this->dt;
+    this->advance(k);
+
+    Eigen::Map<const JointArray> qa(this->samples[k].q), qb(this->samples[k + 1].q);
+    Eigen::Map<const JointArray> va(this->samples[k].qd), vb(this->samples[k + 1].qd);
+    Eigen::Map<const JointArray> fa(this->samples[k].tau_ff), fb(this->samples[k + 1].tau_ff);
+
+    // cubic Hermite basis and its derivative
+    double s2 = s * s, s3 = s2 * s;
+    double h00 = 2.0 * s3 - 3.0 * s2 + 1.0, h10 = s3 - 2.0 * s2 + s;
+    double h01 = -2.0 * s3 + 3.0 * s2,      h11 = s3 - s2;
+    double d00 = 6.0 * s2 - 6.0 * s,        d10 = 3.0 * s2 - 4.0 * s + 1.0;
+    double d01 = -6.0 * s2 + 6.0 * s,       d11 = 3.0 * s2 - 2.0 * s;
+
+    out.q = h00 * qa + (h10 * h) * va + h01 * qb + (h11 * h) * vb;
+    out.qd = (d00 / h) * qa + d10 * va + (d01 / h) * qb + d11 * vb;
+    out.tau_ff = fa + s * (fb - fa);
+}
+
+// function to create the trajectory of the configuration
+Trajectory *createTrajectory(TrajectoryConfig config) {
+
+    switch (config.type) {
+
+        case TRAJ_CHIRP:
+            return new ChirpTrajectory(config);
+
+        case TRAJ_STEP:
+            return new StepTrajectory(config);
+
+        case TRAJ_FILE: {
+            FileTrajectory *file = new FileTrajectory();
+            if (!file->open(config.file.c_str())) {
+                delete file;
+                return NULL;
+            }
+            return file;
+        }
+
+        default:
+            return new SineTrajectory(config);
+    }
+}
+
+// function to create the file for samples dt apart
+bool TrajectoryWriter::open(const char *path, double dt) {
+
+    this->close();
+
+    this->file = fopen(path, "wb");
+    if (this->file == NULL) {
+        printf("Could not open trajectory file %s\n", path);
+        return false;
+    }
+
+    // the sample count is filled in by close
+    memset(&this->header, 0, sizeof(this->header));
+    this->header.magic = TRAJ_MAGIC;
+    this->header.version = TRAJ_VERSION;
+    this->header.joints = NUM_JOINTS;
+    this->header.dt = dt;
+    this->samples = 0;
+    fwrite(&this->header, sizeof(this->header), 1, this->file);
+
+    return true;
+}
+
+// function to append the next sample
+void TrajectoryWriter::append(const TrajectoryPoint &point) {
+
+    TrajectorySample sample;
+    Eigen::Map<JointArray>(sample.q) = point.q;
+    Eigen::Map<JointArray>(sample.qd) = point.qd;
+    Eigen::Map<JointArray>(sample.tau_ff) = point.tau_ff;
+    fwrite(&sample, sizeof(sample), 1, this->file);
+    this->samples++;
+}
+
+// function to write the sample count and close the file
+void TrajectoryWriter::close() {
+
+    if (this->file == NULL) {
+        return;
+    }
+
+    this->header.samples = this->samples;
+    fseek(this->file, 0, SEEK_SET);
+    fwrite(&this->header, sizeof(this->header), 1, this->file);
+    fclose(this->file);
+    this->file = NULL;
+}
+
+// function to close the file without writing the sample count
+void TrajectoryWriter::discard() {
+
+    if (this->file == NULL) {
+        return;
+    }
+    fclose(this->file);
+    this->file = NULL;
+}
+
+// function to parse one CSV row (t and 18 values), false for rows that are not numbers (headers)
+static bool parseRow(char *line, double &t, TrajectoryPoint &point) {
+
+    double v[1 + 3 * NUM_JOINTS];
+    char *p = line;
+    for (int i = 0; i < 1 + 3 * NUM_JOINTS; i++) {
+        char *next;
+        v[i] = strtod(p, &next);
+        if (next == p) {
+            return false;
+        }
+        p = next;
+        while (*p == ',' || *p == ' ' || *p == '\t') {
+            p++;
+        }
+    }
+
+    t = v[0];
+    point.q = Eigen::Map<JointArray>(v + 1);
+    point.qd = Eigen::Map<JointArray>(v + 1 + NUM_JOINTS);
+    point.tau_ff = Eigen::Map<JointArray>(v + 1 + 2 * NUM_JOINTS);
+
+    return true;
+}
+
+// function to convert a CSV trajectory into a trajectory file
+long convertCSVToTrajectory(const char *csv_path, const char *traj_path) {
+
+    FILE *in = fopen(csv_path, "r");
+    if (in == NULL) {
+        printf("Could not open CSV file %s\n", csv_path);
+        return -1;
+    }
+
+    // the first two rows give the sample time
+    char line[4096];
+    double t[2];
+    TrajectoryPoint point[2];
+    int rows = 0;
+    while (rows < 2 && fgets(line, sizeof(line), in) != NULL) {
+        if (parseRow(line, t[rows], point[rows])) {
+            rows++;
+        }
+    }
+    double dt = (rows == 2) ? t[1] - t[0] : 0.0;
+    if (!(dt > 0.0)) {
+        printf("%s needs at least two rows of t, q1..q6, qd1..qd6, tau1..tau6 with increasing t\n", csv_path);
+        fclose(in);
+        return -1;
+    }
+
+    TrajectoryWriter writer;
+    if (!writer.open(traj_path, dt)) {
+        fclose(in);
+        return -1;
+    }
+    writer.append(point[0]);
+    writer.append(point[1]);
+
+    // every further row, the rows have to stay dt apart since the samples are found by index
+    long count = 2;
+    double t_row;
+    TrajectoryPoint row;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (!parseRow(line, t_row, row)) {
+            continue;
+        }
+        if (fabs(t_row - (t[0] + count * dt)) > 0.01 * dt) {
+            printf("Row %ld of %s is at t = %f, expected %f (rows have to be %f s apart)\n", count + 1, csv_path,
+                   t_row, t[0] + count * dt, dt);
+
+            // no truncated trajectory is left behind that would load without an error
+            writer.discard();
+            unlink(traj_path);
+            fclose(in);
+            return -1;
+        }
+        writer.append(row);
+        count++;
+    }
+
+    writer.close();
+    fclose(in);
+
+    printf("Converted %ld samples (%.3f ms apart) from %s to %s\n", count, dt * 1e3, csv_path, traj_path);
+
+    return count;
+}
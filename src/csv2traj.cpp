@@ -0,0 +1,17 @@
+// Custom ELMO libraries
+#include "../inc/ElmoTrajectory.hpp"
+
+// convert a CSV trajectory into the trajectory file played back by the "file" trajectory
+int main(int argc, char *argv[]) {
+
+    // usage: csv2traj [CSV file] [trajectory file]
+    const char *csv_path = (argc > 1) ? argv[1] : "../data/trajectory.csv";
+    const char *traj_path = (argc > 2) ? argv[2] : "../data/trajectory.traj";
+
+    if (convertCSVToTrajectory(csv_path, traj_path) < 0) {
+        printf("Usage: csv2traj [CSV file: t, q1..q6, qd1..qd6, tau1..tau6] [trajectory file]\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+// Standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Custom headers
+#include "../inc/ElmoInterface.hpp"
+#include "../inc/ElmoAllocCheck.hpp"
+#include "../inc/ElmoTrajectory.hpp"
+
+/* ELMO steady-state heap check
+ * ---------------------------
+ * usage: ./elmo_alloc_check [mode]   (default: app)
+ *   app       the app computes the torques (computeTorque / sendTorque)
+ *   cycle_pd  the comm thread runs the PD law on streamed setpoints (sendSetpoint)
+ *
+ * Runs the cyclic loop on the simulated bus with telemetry, the flight recorder and SDO reads going, and the
+ * ELMOInterface calls of an app loop. After the warm-up any heap call or page fault in the comm thread or the
+ * app thread fails the check (exit code 1) and the stacks of the first heap calls are printed.
+ */
+
+// check sizing
+#define CHECK_DRIVES   6
+#define CHECK_FREQ     2500.0   // bus rate [Hz]
+#define CHECK_APP_US   1000     // app loop period [us]
+#define CHECK_WARMUP_S 1.0      // [sec] before counting
+#define CHECK_RUN_S    3.0      // [sec] counted
+#define CHECK_SDO_HZ   10.0     // SDO reads per second from the app loop
+
+// char array to hold the ethernet port name
+char port[1028] = "sim";
+
+// function to run the app side for a while: read the drives, compute and send torques, queue SDO reads
+static void app_run(ELMOInterface &elmo, Trajectory &trajectory, int control, double seconds, const SdoCallback &done) {
+
+    int64 t_end = cycle_now_ns() + (int64) (seconds * 1e9);
+    int64 t_sdo = cycle_now_ns();
+    double t = 0.0;
+    int drive = 0;
+    TrajectoryPoint point;
+
+    while (cycle_now_ns() < t_end) {
+
+        ELMOStatus status = elmo.getELMOStatus();
+        JointVec joint_data = elmo.getEncoderData();
+        const ELMOTelemetry &telem = elmo.getTelemetry();
+        (void) status;
+        (void) telem;
+
+        // small sine around the current position
+        trajectory.eval(t, point);
+        JointVec joint_ref = joint_data;
+        joint_ref.head<NUM_JOINTS>().array() += point.q;
+        JointTorque tau_ff = JointTorque::Zero();
+
+        if (control == CONTROL_CYCLE_PD) {
+            elmo.sendSetpoint(joint_ref, tau_ff);
+            JointTorque tau = elmo.getTorque();
+            (void) tau;
+        }
+        else {
+            JointTorque tau = elmo.computeTorque(joint_ref, tau_ff);
+            elmo.sendTorque(tau);
+        }
+
+        if (cycle_now_ns() >= t_sdo) {
+            t_sdo += (int64) (1e9 / CHECK_SDO_HZ);
+            elmo.sdoRead(drive, 0x6041, 0, done);
+            drive = (drive + 1) % elmo.getDriveCount();
+        }
+
+        t += CHECK_APP_US * 1e-6;
+        usleep(CHECK_APP_US);
+    }
+}
+
+int main(int argc, char *argv[]) {
+
+    const char *which = (argc > 1) ? argv[1] : "app";
+    int control;
+    if (strcmp(which, "app") == 0) {
+        control = CONTROL_APP;
+    }
+    else if (strcmp(which, "cycle_pd") == 0) {
+        control = CONTROL_CYCLE_PD;
+    }
+    else {
+        printf("Unknown mode: %s\n", which);
+        return 1;
+    }
+
+    // default scheduling so the check runs without privileges, memory locked as in the control program
+    ExecutorConfig realtime;
+    realtime.lock_memory = true;
+    realtime.prefault_stack_kb = 512;
+    realtime.prefault_heap_mb = 16;
+    for (int r = 0; r < ROLE_COUNT; r++) {
+        realtime.role[r] = {SCHED_OTHER, 0, -1};
+    }
+    ELMOExecutor executor(realtime);
+    executor.lockMemory();
+    executor.adopt(ROLE_APP, "elmo_app");
+
+    // wide limits and soft gains, nothing trips
+    JointGains gains;
+    gains.Kp.setConstant(5.0);
+    gains.Kd.setConstant(0.1);
+    gains.Kff.setConstant(1.0);
+    JointLimits limits;
+    limits.q_min.setConstant(-100.0);
+    limits.q_max.setConstant(100.0);
+    limits.qd_min.setConstant(-100.0);
+    limits.qd_max.setConstant(100.0);
+
+    // every per cycle feature on: pipelined absolute deadline cycle, telemetry, flight recorder, drives dropping
+    // out and the others running on in degraded mode
+    BusConfig bus = {BUS_SIM, {CHECK_DRIVES, {}, 8192.0, 0.2, 0.05, 0.5, 20.0, 0.0, 0.2}, {}, true};
+    CycleConfig cycle = {CYCLE_ABS_DEADLINE, 20.0, CATCHUP_SKIP, 1, 0.0, 0.0, 0.0, PIPELINE_ON};
+    TelemetryConfig telemetry = {{TELEM_CURRENT, TELEM_DC_VOLTAGE, TELEM_TEMPERATURE, TELEM_FOLLOWING_ERROR, TELEM_TORQUE}, 5};
+    RecorderConfig recorder = {true, 1.0, 0.2, "/tmp"};
+    InterpConfig interp = {INTERP_LINEAR, 1000.0, 10000.0, FALLBACK_HOLD};
+
+    ELMOInterface elmo;
+    elmo.setGains(gains);
+    elmo.setLimits(limits);
+    elmo.setCycleConfig(cycle);
+    elmo.setEnableConfig({ENABLE_PDO, 1.0});
+    elmo.setBusConfig(bus);
+    elmo.setDriveCount(CHECK_DRIVES);
+    elmo.setTelemetryConfig(telemetry);
+    elmo.setRecorderConfig(recorder);
+    elmo.setControlMode(control);
+    elmo.setInterpConfig(interp);
+    elmo.initELMO(10, CHECK_FREQ, port, executor);
+
+    // count the app thread (this one) and the comm thread
+    pid_t bus_tid = executor.threadId("elmo_bus");
+    allocCheckThread(allocCheckSelf());
+    allocCheckThread(bus_tid);
+
+    // references of the app loop
+    TrajectoryConfig sine;
+    sine.type = TRAJ_SINE;
+    sine.amplitude.setConstant(0.01);
+    sine.offset.setZero();
+    sine.frequency = 1.0;
+    SineTrajectory trajectory(sine);
+
+    // the SDO replies run on the mailbox worker, which is not counted
+    SdoCallback done = [](const SdoResult &) {};
+
+    // warm up, then count
+    app_run(elmo, trajectory, control, CHECK_WARMUP_S, done);
+    allocCheckBegin();
+    app_run(elmo, trajectory, control, CHECK_RUN_S, done);
+    AllocUsage usage = allocCheckEnd();
+
+    elmo.shutdownELMO();
+    elmo.printCycleStats();
+
+    bool passed = (usage.calls == 0 && usage.minflt == 0 && usage.majflt == 0);
+    printf("Steady state (%s, %.0f Hz bus, %.1f s after a %.1f s warm-up, comm and app threads):\n", which,
+           CHECK_FREQ, CHECK_RUN_S, CHECK_WARMUP_S);
+    printf("  heap calls: %llu (%llu bytes), minor faults: %ld, major faults: %ld\n",
+           (unsigned long long) usage.calls, (unsigned long long) usage.bytes, usage.minflt, usage.majflt);
+    if (!passed) {
+        fflush(stdout);
+        allocCheckTraces(stdout);
+    }
+    printf("%s\n", passed ? "PASSED" : "FAILED");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,390 @@
+// Standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// Custom headers
+#include "../inc/ElmoCycle.hpp"
+#include "../inc/ElmoControl.hpp"
+#include "../inc/ElmoComm.hpp"
+
+/* ELMO micro-benchmarks
+ * -------------------
+ * usage: ./elmo_bench [benchmark]   (default: all)
+ *   pd      vectorized PD kernel vs. the original per-joint computeTorque
+ *   scaling cyclic loop processing time vs. number of drives, on the simulated bus
+ *   pipeline sequential vs. pipelined cycle, time the loop thread is blocked on the bus
+ *   mailbox cyclic loop timing with and without SDO reads going out between the cycles
+ */
+
+// number of drives processed per cycle in the benchmarks
+#define BENCH_DRIVES 6
+
+// **************************************************************************************************************************
+
+// original scalar gains and limits layout
+struct LegacyGains {
+    double Kp_HFL, Kp_HSL, Kp_KL, Kp_HFR, Kp_HSR, Kp_KR;
+    double Kd_HFL, Kd_HSL, Kd_KL, Kd_HFR, Kd_HSR, Kd_KR;
+    double Kff_HFL, Kff_HSL, Kff_KL, Kff_HFR, Kff_HSR, Kff_KR;
+};
+struct LegacyLimits {
+    double q_max_HFL, q_min_HFL, q_max_HSL, q_min_HSL, q_max_KL, q_min_KL;
+    double q_max_HFR, q_min_HFR, q_max_HSR, q_min_HSR, q_max_KR, q_min_KR;
+};
+
+// original computeTorque body (warnings replaced by a counter, they do not change the torques)
+static void pd_legacy(const LegacyGains &gains, const LegacyLimits &limits, const double *ref_in, 
+                      const double *joint_data, const double *tau_ff, double *tau, int &warnings) {
+
+    double joint_ref[12];
+    memcpy(joint_ref, ref_in, sizeof(joint_ref));
+    double tau_HFL, tau_HSL, tau_KL, tau_HFR, tau_HSR, tau_KR;
+
+    // saturate the reference joint angles
+    if (joint_ref[0] < limits.q_min_HFL || joint_ref[0] > limits.q_max_HFL) {
+        warnings++;
+        joint_ref[0] = std::min(std::max(joint_ref[0], limits.q_min_HFL), limits.q_max_HFL);
+    }
+    if (joint_ref[1] < limits.q_min_HSL || joint_ref[1] > limits.q_max_HSL) {
+        warnings++;
+        joint_ref[1] = std::min(std::max(joint_ref[1], limits.q_min_HSL), limits.q_max_HSL);
+    }
+    if (joint_ref[2] < limits.q_min_KL || joint_ref[2] > limits.q_max_KL) {
+        warnings++;
+        joint_ref[2] = std::min(std::max(joint_ref[2], limits.q_min_KL), limits.q_max_KL);
+    }
+    if (joint_ref[3] < limits.q_min_HFR || joint_ref[3] > limits.q_max_HFR) {
+        warnings++;
+        joint_ref[3] = std::min(std::max(joint_ref[3], limits.q_min_HFR), limits.q_max_HFR);
+    }
+    if (joint_ref[4] < limits.q_min_HSR || joint_ref[4] > limits.q_max_HSR) {
+        warnings++;
+        joint_ref[4] = std::min(std::max(joint_ref[4], limits.q_min_HSR), limits.q_max_HSR);
+    }
+    if (joint_ref[5] < limits.q_min_KR || joint_ref[5] > limits.q_max_KR) {
+        warnings++;
+        joint_ref[5] = std::min(std::max(joint_ref[5], limits.q_min_KR), limits.q_max_KR);
+    }
+
+    // compute the torque for each joint
+    tau_HFL = gains.Kp_HFL * (joint_ref[0] - joint_data[0]) 
+            + gains.Kd_HFL * (joint_ref[6] - joint_data[6]) 
+            + gains.Kff_HFL * tau_ff[0];
+
+    tau_HSL = gains.Kp_HSL * (joint_ref[1] - joint_data[1])
+            + gains.Kd_HSL * (joint_ref[7] - joint_data[7])
+            + gains.Kff_HSL * tau_ff[1];
+
+    tau_KL =  gains.Kp_KL * (joint_ref[2] - joint_data[2])
+            + gains.Kd_KL * (joint_ref[8] - joint_data[8])
+            + gains.Kff_KL * tau_ff[2];
+
+    tau_HFR = gains.Kp_HFR * (joint_ref[3] - joint_data[3])
+            + gains.Kd_HFR * (joint_ref[9] - joint_data[9])
+            + gains.Kff_HFR * tau_ff[3];
+
+    tau_HSR = gains.Kp_HSR * (joint_ref[4] - joint_data[4])
+            + gains.Kd_HSR * (joint_ref[10] - joint_data[10])
+            + gains.Kff_HSR * tau_ff[4];
+
+    tau_KR =  gains.Kp_KR * (joint_ref[5] - joint_data[5])
+            + gains.Kd_KR * (joint_ref[11] - joint_data[11])
+            + gains.Kff_KR * tau_ff[5]; 
+
+    // check that we have not exceeded the joint limits 
+    if (joint_data[0] < limits.q_min_HFL || joint_data[0] > limits.q_max_HFL) {
+        warnings++;
+        tau_HFL = 0.0;
+    }
+    if (joint_data[1] < limits.q_min_HSL || joint_data[1] > limits.q_max_HSL) {
+        warnings++;
+        tau_HSL = 0.0;
+    }
+    if (joint_data[2] < limits.q_min_KL || joint_data[2] > limits.q_max_KL) {
+        warnings++;
+        tau_KL = 0.0;
+    }
+    if (joint_data[3] < limits.q_min_HFR || joint_data[3] > limits.q_max_HFR) {
+        warnings++;
+        tau_HFR = 0.0;
+    }
+    if (joint_data[4] < limits.q_min_HSR || joint_data[4] > limits.q_max_HSR) {
+        warnings++;
+        tau_HSR = 0.0;
+    }
+    if (joint_data[5] < limits.q_min_KR || joint_data[5] > limits.q_max_KR) {
+        warnings++;
+        tau_KR = 0.0;
+    }
+
+    tau[0] = tau_HFL; tau[1] = tau_HSL; tau[2] = tau_KL;
+    tau[3] = tau_HFR; tau[4] = tau_HSR; tau[5] = tau_KR;
+}
+
+// function to compare the PD kernel with the original path bit for bit and time both
+static void bench_pd() {
+
+    printf("PD torque kernel (%d joints)\n", NUM_JOINTS);
+
+    // gains and limits of config.yaml, in both layouts
+    JointGains gains;
+    JointLimits limits;
+    gains.Kp << 1500.0, 2500.0, 3200.0, 0.0, 3000.0, 3200.0;
+    gains.Kd << 50.0, 85.0, 150.0, 0.0, 90.0, 250.0;
+    gains.Kff << 0.0, 0.0, 0.0, 0.0, 0.0, 0.0;
+    limits.q_min << -0.35, -0.5, -5.0, -0.3, -0.5, -0.52;
+    limits.q_max << 0.3, 0.35, 5.0, 0.35, 0.35, 0.52;
+    limits.qd_min.setConstant(-1.0);
+    limits.qd_max.setConstant(1.0);
+
+    LegacyGains lg = {gains.Kp(0), gains.Kp(1), gains.Kp(2), gains.Kp(3), gains.Kp(4), gains.Kp(5),
+                      gains.Kd(0), gains.Kd(1), gains.Kd(2), gains.Kd(3), gains.Kd(4), gains.Kd(5),
+                      gains.Kff(0), gains.Kff(1), gains.Kff(2), gains.Kff(3), gains.Kff(4), gains.Kff(5)};
+    LegacyLimits ll = {limits.q_max(0), limits.q_min(0), limits.q_max(1), limits.q_min(1), limits.q_max(2), limits.q_min(2),
+                       limits.q_max(3), limits.q_min(3), limits.q_max(4), limits.q_min(4), limits.q_max(5), limits.q_min(5)};
+
+    // the same random inputs for both paths, some references and joints out of bounds
+    // (a small set reused by every call so the inputs stay in cache, like in the control tick)
+    struct PDInput {
+        double ref[12];         // original layout: q_ref, qd_ref
+        double joint[12];       //                  q, qd
+        JointArray q_ref, qd_ref, q, qd, tau_ff;
+    };
+    const int calls = 1 << 20;
+    const int sets = 256;
+    std::vector<PDInput> in(sets);
+    srand(2);
+    for (int c = 0; c < sets; c++) {
+        for (int k = 0; k < 12; k++) {
+            in[c].ref[k] = 1.2 * ((double) rand() / RAND_MAX - 0.5);
+            in[c].joint[k] = 1.2 * ((double) rand() / RAND_MAX - 0.5);
+        }
+        for (int k = 0; k < NUM_JOINTS; k++) {
+            in[c].q_ref(k) = in[c].ref[k];
+            in[c].qd_ref(k) = in[c].ref[k + 6];
+            in[c].q(k) = in[c].joint[k];
+            in[c].qd(k) = in[c].joint[k + 6];
+            in[c].tau_ff(k) = (double) rand() / RAND_MAX - 0.5;
+        }
+    }
+    std::vector<JointArray> tau_ref(sets), tau(sets);
+    int warnings = 0, saturated, tripped;
+
+    // bit-for-bit comparison and out of bounds events on every input set
+    int events = 0;
+    for (int c = 0; c < sets; c++) {
+        pd_legacy(lg, ll, in[c].ref, in[c].joint, in[c].tau_ff.data(), tau_ref[c].data(), warnings);
+        pdTorque(gains, limits, in[c].q_ref, in[c].qd_ref, in[c].q, in[c].qd, in[c].tau_ff, tau[c], saturated, tripped);
+        events += __builtin_popcount(saturated) + __builtin_popcount(tripped);
+    }
+    bool identical = true;
+    for (int c = 0; c < sets; c++) {
+        identical = identical && memcmp(tau[c].data(), tau_ref[c].data(), sizeof(double) * NUM_JOINTS) == 0;
+    }
+    printf("  %d input sets, torques bit-for-bit identical: %s, out of bounds events: %d / %d\n", 
+           sets, identical ? "yes" : "NO", events, warnings);
+
+    // original path
+    int64_t t0 = cycle_now_ns();
+    for (int k = 0; k < calls; k++) {
+        int c = k & (sets - 1);
+        pd_legacy(lg, ll, in[c].ref, in[c].joint, in[c].tau_ff.data(), tau_ref[c].data(), warnings);
+    }
+    int64_t t1 = cycle_now_ns();
+
+    // array kernel
+    for (int k = 0; k < calls; k++) {
+        int c = k & (sets - 1);
+        pdTorque(gains, limits, in[c].q_ref, in[c].qd_ref, in[c].q, in[c].qd, in[c].tau_ff, tau[c], saturated, tripped);
+    }
+    int64_t t2 = cycle_now_ns();
+
+    printf("  original:     %7.2f ns/call\n", (t1 - t0) / (double) calls);
+    printf("  array kernel: %7.2f ns/call\n", (t2 - t1) / (double) calls);
+    printf("  speedup:      %7.2fx\n", (double) (t1 - t0) / (double) (t2 - t1));
+}
+
+// **************************************************************************************************************************
+
+// function to run the cyclic loop on the simulated bus and return its timing
+static CycleStatsSummary loop_run(int drives, double freq, double seconds, double roundtrip_us, CycleConfig cycle, 
+                                  double sdo_rate = 0.0, uint64 *sdo_done = NULL) {
+
+    BusConfig bus = {BUS_SIM, {drives, {}, 8192.0, 0.2, 0.05, 0.5, roundtrip_us, 0.0, 0.0}, {}, false};
+
+    ELMOData *data = new ELMOData();
+    data->OpMode = 10;
+    data->freq = freq;
+    data->drives = drives;
+    data->cycle = cycle;
+    data->enable = {ENABLE_PDO, 1.0};
+    data->motor_control_switch = true;
+    strcpy(data->port, "sim");
+
+    // the mailbox worker is started by an executor with default scheduling, one per run
+    ExecutorConfig defaults;
+    defaults.lock_memory = false;
+    defaults.prefault_stack_kb = 0;
+    defaults.prefault_heap_mb = 0;
+    for (int r = 0; r < ROLE_COUNT; r++) {
+        defaults.role[r] = {SCHED_OTHER, 0, -1};
+    }
+    ELMOExecutor executor(defaults);
+    data->executor = &executor;
+
+    // the loop and the bus print their setup and shutdown, keep them off the results
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    data->bus = createBus(bus, freq);
+    pthread_t thread;
+    pthread_create(&thread, NULL, &ELMOcommunication, (void *) &data);
+    while (data->commStatus == 0) {
+        usleep(1000);
+    }
+
+    // publish a torque command every millisecond while the loop runs, and read status words at sdo_rate
+    int64 t_end = cycle_now_ns() + (int64) (seconds * 1e9);
+    int64 t_sdo = cycle_now_ns();
+    uint64 seq = 0;
+    while (data->commStatus == 1 && cycle_now_ns() < t_end) {
+        ELMOCommand &command = data->command.writeBuffer();
+        command.head.seq = ++seq;
+        for (int i = 0; i < drives; i++) {
+            command.drive[i].torque = (int16) (i + seq % 100);
+        }
+        data->command.publish();
+        if (sdo_rate > 0.0 && cycle_now_ns() >= t_sdo) {
+            t_sdo += (int64) (1e9 / sdo_rate);
+            data->mailbox.read((int) (seq % drives), 0x6041, 0, [](const SdoResult &) {});
+        }
+        usleep(1000);
+    }
+    data->motor_control_switch = false;
+    pthread_join(thread, NULL);
+
+    std::cout.flush();
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    close(null_fd);
+
+    CycleStatsSummary s = data->stats.summary();
+    if (sdo_done != NULL) {
+        *sdo_done = data->mailbox.getCompleted();
+    }
+    delete data->bus;
+    delete data;
+
+    return s;
+}
+
+// cyclic loop processing time of one drive count
+static void scaling_run(int drives, double freq, double seconds) {
+
+    // simulated chain without the emulated round trip, so only the loop itself is measured
+    CycleConfig cycle = {CYCLE_BUSY_POLL, 0.0, CATCHUP_SKIP, 1, 0.0, 0.0, 0.0, PIPELINE_OFF};
+    CycleStatsSummary s = loop_run(drives, freq, seconds, 0.0, cycle);
+
+    printf("  %6d %10llu %9.2f %9.2f %9.2f %12.1f\n", drives, (unsigned long long) s.processing.count,
+           s.processing.p50 * 1e-3, s.processing.p99 * 1e-3, s.processing.mean * 1e-3, s.processing.mean / drives);
+}
+
+// function to measure how the cyclic loop scales with the number of drives
+static void bench_scaling() {
+
+    printf("Cyclic loop processing (simulated bus, 10 kHz busy poll) [us]:\n");
+    printf("  %6s %10s %9s %9s %9s %12s\n", "drives", "cycles", "p50", "p99", "mean", "ns/drive");
+
+    const int drives[] = {6, 12, 24, 48, 96};
+    for (size_t i = 0; i < sizeof(drives) / sizeof(drives[0]); i++) {
+        scaling_run(drives[i], 10000.0, 0.5);
+    }
+}
+
+// function to compare the sequential and the pipelined cycle with a 50 us frame round trip
+static void bench_pipeline() {
+
+    const double freq = 2500.0, roundtrip_us = 50.0;
+    printf("Sequential vs. pipelined cycle (simulated bus, %d drives, %.0f Hz, %.0f us round trip) [us]:\n",
+           BENCH_DRIVES, freq, roundtrip_us);
+    printf("  %-10s %9s %9s %9s %9s %9s\n", "", "bus io", "io p99", "process", "busy", "of period");
+
+    double io[2];
+    for (int p = PIPELINE_OFF; p <= PIPELINE_ON; p++) {
+
+        CycleConfig cycle = {CYCLE_ABS_DEADLINE, 20.0, CATCHUP_SKIP, 1, 0.0, 0.0, 0.0, p};
+        CycleStatsSummary s = loop_run(BENCH_DRIVES, freq, 1.0, roundtrip_us, cycle);
+
+        // time the loop thread is busy per cycle: blocked in the exchange plus processing
+        io[p] = s.io.mean * 1e-3;
+        double busy = io[p] + s.processing.mean * 1e-3;
+        printf("  %-10s %9.2f %9.2f %9.2f %9.2f %8.1f%%\n", (p == PIPELINE_ON) ? "pipelined" : "sequential",
+               io[p], s.io.p99 * 1e-3, s.processing.mean * 1e-3, busy, 100.0 * busy * 1e-6 * freq);
+    }
+    printf("  reclaimed:  %.2f us per cycle\n", io[PIPELINE_OFF] - io[PIPELINE_ON]);
+}
+
+// function to compare the cyclic loop timing with and without SDO traffic next to it
+static void bench_mailbox() {
+
+    const double freq = 2500.0, roundtrip_us = 50.0;
+    printf("Cyclic loop with SDO reads (simulated bus, %d drives, %.0f Hz, %.0f us round trip) [us]:\n",
+           BENCH_DRIVES, freq, roundtrip_us);
+    printf("  %-9s %8s %9s %9s %9s %9s %9s\n", "SDO/s", "SDOs", "wakeup", "wk p99", "io p99", "period", "per max");
+
+    const double rates[] = {0.0, 10.0, 100.0};
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+
+        CycleConfig cycle = {CYCLE_ABS_DEADLINE, 20.0, CATCHUP_SKIP, 1, 0.0, 0.0, 0.0, PIPELINE_OFF};
+        uint64 sdos = 0;
+        CycleStatsSummary s = loop_run(BENCH_DRIVES, freq, 2.0, roundtrip_us, cycle, rates[r], &sdos);
+
+        printf("  %-9.0f %8llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", rates[r], (unsigned long long) sdos,
+               s.wakeup.mean * 1e-3, s.wakeup.p99 * 1e-3, s.io.p99 * 1e-3, s.period.mean * 1e-3, s.period.max * 1e-3);
+    }
+}
+
+// **************************************************************************************************************************
+
+int main(int argc, char *argv[]) {
+
+    const char *which = (argc > 1) ? argv[1] : "all";
+    bool all = (strcmp(which, "all") == 0);
+    bool ran = false;
+
+    if (all || strcmp(which, "pd") == 0) {
+        bench_pd();
+        ran = true;
+    }
+
+    if (all || strcmp(which, "scaling") == 0) {
+        bench_scaling();
+        ran = true;
+    }
+
+    if (all || strcmp(which, "pipeline") == 0) {
+        bench_pipeline();
+        ran = true;
+    }
+
+    if (all || strcmp(which, "mailbox") == 0) {
+        bench_mailbox();
+        ran = true;
+    }
+
+    if (!ran) {
+        printf("Unknown benchmark: %s\n", which);
+        return 1;
+    }
+
+    return 0;
+}
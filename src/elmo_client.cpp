@@ -0,0 +1,66 @@
+// standard imports
+#include <stdlib.h>
+#include <math.h>
+
+// Custom ELMO libraries
+#include "../inc/ElmoClient.hpp"
+#include "../inc/ElmoConfig.hpp"
+
+/* ELMO bus daemon client
+ * ----------------------
+ * usage: ./elmo_client [seconds]   (from build/, reads ../config/config.yaml, default: max_prog_time)
+ *
+ * Attaches to the running elmo_daemon and holds every joint at the position it found it in, in the
+ * control mode of the config: "app" computes the torques here, "cycle_pd" streams setpoints to the PD law
+ * the daemon runs in every bus cycle. Detaching hands the drives back to zero torque.
+ */
+
+int main(int argc, char *argv[]) {
+
+    // load the config file
+    ELMOConfig config = loadConfig("../config/config.yaml");
+    double seconds = (argc > 1) ? atof(argv[1]) : config.max_time;
+
+    // attach to the daemon's bus
+    ELMOClient elmo;
+    int64 t0 = cycle_now_ns();
+    if (!elmo.attach(config.daemon.name.c_str())) {
+        return 1;
+    }
+    int64 t1 = cycle_now_ns();
+    printf("Attached to %s in %.1f us, %d drives\n", config.daemon.name.c_str(), (t1 - t0) * 1e-3, elmo.getDriveCount());
+
+    elmo.setGains(config.gains);
+    elmo.setLimits(config.limits);
+
+    // hold the joints where they are
+    JointVec joint_ref = elmo.getEncoderData();
+    joint_ref.tail<NUM_JOINTS>().setZero();
+    JointTorque tau_ff = JointTorque::Zero();
+
+    int64 period_ns = (int64) (1e9 / config.app_freq);
+    int64 t_end = cycle_now_ns() + (int64) (seconds * 1e9);
+    uint64 ticks = 0;
+    for (int64 t = cycle_now_ns(); t < t_end; t += period_ns) {
+
+        if (config.control == CONTROL_CYCLE_PD) {
+            elmo.sendSetpoint(joint_ref, tau_ff);
+        }
+        else {
+            elmo.sendTorque(elmo.computeTorque(joint_ref, tau_ff));
+        }
+        ticks++;
+
+        // next tick on the app period
+        struct timespec ts = {(time_t) ((t + period_ns) / 1000000000), (long) ((t + period_ns) % 1000000000)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+
+    // hand the drives back to zero torque
+    int64 t2 = cycle_now_ns();
+    elmo.detach();
+    int64 t3 = cycle_now_ns();
+    printf("Detached in %.1f us after %llu ticks\n", (t3 - t2) * 1e-3, (unsigned long long) ticks);
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+// standard imports
+#include <signal.h>
+
+// Custom ELMO libraries
+#include "../inc/ElmoInterface.hpp"
+#include "../inc/ElmoConfig.hpp"
+#include "../inc/ElmoShm.hpp"
+
+/* ELMO bus daemon
+ * ---------------
+ * usage: ./elmo_daemon   (from build/, reads ../config/config.yaml)
+ *
+ * Owns the EtherCAT bus and keeps the drives enabled. Every bus cycle the snapshot goes to the shared memory
+ * segment daemon.name and the newest command of the attached controller (ELMOClient) comes back from it.
+ * Without a controller, or once its newest command is older than daemon.heartbeat_ms, the drives are held
+ * at zero torque. Controllers attach and detach without touching the bus. SIGINT / SIGTERM shut it down.
+ */
+
+// time between the daemon's checks of the client and the telemetry [us]
+#define DAEMON_POLL_US 1000
+
+// char array to hold the ethernet port name
+char port[1028];
+
+// set by SIGINT / SIGTERM
+static volatile sig_atomic_t stop = 0;
+
+static void onSignal(int) {
+    stop = 1;
+}
+
+int main() {
+
+    // load the config file
+    ELMOConfig config = loadConfig("../config/config.yaml");
+    config.port.copy(port, sizeof(port));
+    const char *name = config.daemon.name.c_str();
+
+    // lock the memory before any thread starts, this thread watches the clients
+    ELMOExecutor executor(config.realtime);
+    executor.lockMemory();
+    executor.adopt(ROLE_APP, "elmo_daemon");
+
+    // shared memory segment for the controllers
+    ShmBus *shm = shmCreate(name, config.freq);
+    if (shm == NULL) {
+        return 1;
+    }
+
+    // the bridge runs in every bus cycle: state out, client command in, zero torque without a heartbeat
+    ELMOShmBridge bridge(shm, config.daemon, config.limits, config.interp);
+
+    ELMOInterface elmo;
+    elmo.setGains(config.gains);
+    elmo.setLimits(config.limits);
+    elmo.setCycleConfig(config.cycle);
+    elmo.setEnableConfig(config.enable);
+    elmo.setBusConfig(config.bus);
+    elmo.setDriveCount(config.drives);
+    elmo.setTelemetryConfig(config.telemetry);
+    elmo.setRecorderConfig(config.recorder);
+    elmo.setInterpConfig(config.interp);
+    elmo.setCycleController(&bridge);
+    elmo.initELMO(config.opmode, config.freq, port, executor);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    shm->online.store(1, std::memory_order_release);
+    printf("Bus daemon on %s: %d drives at %.0f Hz, zero torque after %.0f ms without a client heartbeat\n", name,
+           shm->drives.load(), config.freq, config.daemon.heartbeat_s * 1e3);
+
+    // report clients coming and going, forward the telemetry
+    pid_t client = 0;
+    uint64 telemetry_cycle = 0;
+    while (!stop) {
+
+        pid_t now = shm->client.load(std::memory_order_acquire);
+        if (now != client) {
+            if (now != 0) {
+                printf("Client %d attached\n", (int) now);
+            }
+            else {
+                printf("Client %d detached\n", (int) client);
+            }
+            client = now;
+        }
+
+        const ELMOTelemetry &telem = elmo.getTelemetry();
+        if (telem.head.cycle != telemetry_cycle) {
+            telemetry_cycle = telem.head.cycle;
+            ShmTelemetry &out = shm->telemetry.beginWrite();
+            out.head = telem.head;
+            out.count = std::min(telem.drives(), SHM_MAX_DRIVES);
+            memcpy(out.drive, telem.drive.data(), out.count * sizeof(DriveTelemetry));
+            shm->telemetry.endWrite();
+        }
+
+        usleep(DAEMON_POLL_US);
+    }
+
+    // clients see the bus go away, then the drives are brought down
+    shm->online.store(0, std::memory_order_release);
+    elmo.shutdownELMO();
+    elmo.printCycleStats();
+    printf("  clients: %llu attached, %llu cycles held at zero torque\n",
+           (unsigned long long) shm->attaches.load(), (unsigned long long) shm->held.load());
+    shmRemove(shm, name);
+
+    executor.report();
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+
+// Custom headers
+#include "../inc/ElmoCycle.hpp"
+#include "../inc/ElmoChannel.hpp"
+
+/* ELMO read-copy-update stress check
+ * ---------------------------------
+ * usage: ./elmo_rcu_check [seconds]   (default: 2)
+ *
+ * Runs a writer publishing copies as fast as their grace periods allow against readers picking them up and
+ * leaving in a loop, as the bus threads do at their cycle boundaries. Every copy is filled with one sequence
+ * number and poisoned when it is freed, a reader that sees a torn or poisoned copy or a sequence going back
+ * fails the check (exit code 1).
+ */
+
+// check sizing
+#define RCU_READERS 2
+#define RCU_WORDS   64          // words per copy, a reader checks all of them
+#define RCU_POISON  0xdeadbeefdeadbeefULL
+#define RCU_LEAVE   7           // a reader leaves every RCU_LEAVE reads, so its mark goes through IDLE
+
+// one copy, poisoned when freed
+struct RcuValue {
+  uint64_t word[RCU_WORDS];
+  RcuValue(uint64_t seq = 0) { for (int i = 0; i < RCU_WORDS; i++) this->word[i] = seq; };
+  RcuValue(const RcuValue &v) { memcpy(this->word, v.word, sizeof(this->word)); };
+  ~RcuValue() { for (int i = 0; i < RCU_WORDS; i++) ((volatile uint64_t *) this->word)[i] = RCU_POISON; };
+};
+
+typedef RcuCell<RcuValue, RCU_READERS> RcuValueCell;
+
+// state shared with the reader threads
+struct RcuRun {
+  RcuValueCell cell;
+  std::atomic<bool> done;
+  std::atomic<uint64_t> errors;
+  uint64_t reads[RCU_READERS];
+};
+
+// shared state, static so the cache line aligned cell is aligned
+static RcuRun rcu_run;
+
+struct RcuReader {
+  RcuRun *run;
+  int id;
+};
+
+// reader thread: read, check the copy, leave now and then
+static void *reader_thread(void *arg) {
+
+    RcuReader *reader = (RcuReader *) arg;
+    RcuRun *run = reader->run;
+    uint64_t last = 0;
+    uint64_t reads = 0;
+
+    while (!run->done.load(std::memory_order_relaxed)) {
+
+        const RcuValue *v = run->cell.read(reader->id);
+        if (v != NULL) {
+            uint64_t seq = v->word[0];
+            bool ok = (seq != RCU_POISON && seq >= last);
+            for (int i = 1; i < RCU_WORDS && ok; i++) {
+                ok = (((const volatile uint64_t *) v->word)[i] == seq);
+            }
+            if (!ok) {
+                run->errors.fetch_add(1, std::memory_order_relaxed);
+            }
+            last = seq;
+        }
+
+        if (++reads % RCU_LEAVE == 0) {
+            run->cell.leave(reader->id);
+        }
+    }
+
+    run->cell.leave(reader->id);
+    run->reads[reader->id] = reads;
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+
+    double seconds = (argc > 1) ? atof(argv[1]) : 2.0;
+
+    RcuRun *run = &rcu_run;
+    run->done.store(false);
+    run->errors.store(0);
+
+    pthread_t threads[RCU_READERS];
+    RcuReader readers[RCU_READERS];
+    for (int r = 0; r < RCU_READERS; r++) {
+        readers[r] = {run, r};
+        if (pthread_create(&threads[r], NULL, reader_thread, &readers[r]) != 0) {
+            printf("ERROR : could not start reader %d\n", r);
+            return 1;
+        }
+    }
+
+    // writer: publish the next sequence number whenever the previous copy is out of its grace period
+    uint64_t seq = 1;
+    uint64_t refused = 0;
+    int64_t t_end = cycle_now_ns() + (int64_t) (seconds * 1e9);
+    while (cycle_now_ns() < t_end) {
+        if (run->cell.publish(RcuValue(seq))) {
+            seq++;
+        }
+        else {
+            refused++;
+            sched_yield();
+        }
+    }
+
+    run->done.store(true);
+    for (int r = 0; r < RCU_READERS; r++) {
+        pthread_join(threads[r], NULL);
+    }
+
+    uint64_t errors = run->errors.load();
+    printf("RCU stress (%d readers, %.1f s): %llu copies published, %llu refused in their grace period\n",
+           RCU_READERS, seconds, (unsigned long long) (seq - 1), (unsigned long long) refused);
+    for (int r = 0; r < RCU_READERS; r++) {
+        printf("  reader %d: %llu reads\n", r, (unsigned long long) run->reads[r]);
+    }
+    printf("  torn or freed copies seen: %llu\n", (unsigned long long) errors);
+    printf("%s\n", (errors == 0) ? "PASSED" : "FAILED");
+
+    return (errors == 0) ? 0 : 1;
+}
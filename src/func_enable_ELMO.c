@@ -19,76 +19,36 @@
  */
 #include "simstruc.h"
 #include <stdio.h>
+#include "../inc/ElmoDS402.h"
 
 /* ELMO drive control 
  * -------------------
  * refer to DS-402 document from ELMO
  * refer to my notes
+ * the state machine itself lives in ElmoDS402.c (shared with the C++ cyclic loop),
+ * build with: mex func_enable_ELMO.c ElmoDS402.c
  */
 void func_ELMO_ctrl(int_T driveNum, uint16_T statusWord, uint16_T *ctrlWord){
     
-    uint16_T ctrlWord_tmp = 0; // disable voltage cmd
+    /* message reported for each DS402 state */
+    static const char *state_msg[DS402_NUM_STATES] = {
+        "Drive %d NOT ready!\n",
+        "Drive %d in SOD mode.\n",
+        "Drive %d in RSO mode.\n",
+        "Drive %d in SO mode.\n",
+        "ATTENTION!!! Drive %d ARMED.\n",
+        "Drive %d quick-stopped.\n",
+        "Drive %d FAILED: fault reaction active.\n",
+        "Drive %d FAILED: fault.\n",
+        "Drive %d FAILED: unknown state.\n"
+    };
+    const ds402_entry_t *entry = ds402_lookup(statusWord);
     char msg[255];
-//     ctrlWord[0] = 0;
-    
-    if(!((statusWord >> 0) & 1) && !((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && !((statusWord >> 6) & 1)){    
-        sprintf(msg,"Drive %d NOT ready!\n", driveNum);
-        ssPrintf(msg);
-        
-    }else if(!((statusWord >> 0) & 1) && !((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 6) & 1)){
-        /* transition from "SOD" to "ready to switch on (RSO)" */
-        sprintf(msg,"Drive %d in SOD mode.\n", driveNum);
-        ssPrintf(msg);        
-        ctrlWord_tmp = (1 << 1) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 2) | ctrlWord_tmp;         
-    }else if(((statusWord >> 0) & 1) && !((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)){        
-        sprintf(msg,"Drive %d in RSO mode.\n", driveNum);
-        ssPrintf(msg);        
-        /* transition from "RSO" to "switched on (SO)" */
-        ctrlWord_tmp = (1 << 0) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 1) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 2) | ctrlWord_tmp; 
-        
-    }else if(((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)){        
-        sprintf(msg,"Drive %d in SO mode.\n", driveNum);
-        ssPrintf(msg);
-        /* transition from "SO" to "operation (OP)" mode */
-        ctrlWord_tmp = (1 << 0) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 1) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 2) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 3) | ctrlWord_tmp; 
-        
-    }else if(((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && ((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)){     
-        /* drive armed */  
-        sprintf(msg,"ATTENTION!!! Drive %d ARMED.\n", driveNum);
-        ssPrintf(msg);
-        /* "OP" mode */
-        ctrlWord_tmp = (1 << 0) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 1) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 2) | ctrlWord_tmp; 
-        ctrlWord_tmp = (1 << 3) | ctrlWord_tmp;
-        
-    }else if(((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && ((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && !((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)){
-        /* drive failed */
-        sprintf(msg,"Drive %d quick-stopped.\n", driveNum);
-        ssPrintf(msg);
-        
-    }else if (((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && ((statusWord >> 2) & 1) && ((statusWord >> 3) & 1) && !((statusWord >> 6) & 1)){
-        /* drive failed */
-        sprintf(msg,"Drive %d FAILED: fault reaction active.\n", driveNum);
-        ssPrintf(msg);
     
-    }else if (!((statusWord >> 0) & 1) && !((statusWord >> 1) & 1) && !((statusWord >> 2) & 1) && ((statusWord >> 3) & 1) && !((statusWord >> 6) & 1)){
-        /* drive failed */
-        sprintf(msg,"Drive %d FAILED: fault.\n", driveNum);
-        ssPrintf(msg);
-    }else{
-        /* unknown state */
-        sprintf(msg,"Drive %d FAILED: unknown state.\n", driveNum);
-        ssPrintf(msg);
-    }
+    sprintf(msg, state_msg[entry->state], driveNum);
+    ssPrintf(msg);
      
-    ctrlWord[0] = ctrlWord_tmp;
+    ctrlWord[0] = entry->controlword;
 }
 
 /* ELMO drive shutdown
@@ -101,7 +61,7 @@ void func_ELMO_shutdown(int_T driveNum, uint16_T statusWord, uint16_T *ctrlWord)
     uint16_T ctrlWord_tmp = 0; // disable voltage cmd
     char msg[255];
     
-    if(((statusWord >> 0) & 1) && ((statusWord >> 1) & 1) && ((statusWord >> 2) & 1) && !((statusWord >> 3) & 1) && ((statusWord >> 5) & 1) && !((statusWord >> 6) & 1)){
+    if(ds402_lookup(statusWord)->state == DS402_OP_ENABLED){
         sprintf(msg,"Drive %d is shutdown.\n", driveNum);
         ssPrintf(msg);    
     }else{
@@ -0,0 +1,17 @@
+// Custom ELMO libraries
+#include "../inc/ElmoLogger.hpp"
+
+// convert a binary ELMO log into the CSV files read by data/plot_data.m
+int main(int argc, char *argv[]) {
+
+    // usage: log2csv [log file] [output directory]
+    const char *log_path = (argc > 1) ? argv[1] : "../data/log.bin";
+    const char *csv_dir = (argc > 2) ? argv[2] : "../data";
+
+    if (convertLogToCSV(log_path, csv_dir) < 0) {
+        printf("Usage: log2csv [log file] [output directory]\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -8,133 +8,46 @@
 #include <sstream>
 
 // Other imports 
-#include <yaml-cpp/yaml.h>
 #include <Eigen/Dense>
 
 // Custom ELMO libraries
 #include "../inc/ElmoComm.hpp"
 #include "../inc/ElmoInterface.hpp"
+#include "../inc/ElmoLogger.hpp"
+#include "../inc/ElmoConfig.hpp"
+#include "../inc/ElmoTrajectory.hpp"
+#include "../inc/ElmoReload.hpp"
 
 // char array to hold the ethernet port name
 char port[1028];
 
-// sine wave signal
-double sin_wave(double t, double A, double f) {
-
-    double w, x;
-    w = 2 * M_PI * f;
-
-    x = A * sin(w * t);
-
-    return x;
-}
-
-// derivative of sine wave 
-double sin_wave_dt(double t, double A, double f) {
-
-    double w, dx;
-    w = 2 * M_PI * f;
-
-    dx = A * w * cos(w * t);
-
-    return dx;
-}
-
 // main ELMO control loop
 int main() {
 
-    // load config file
-    std::string config_file = "../config/config.yaml";
+    // load the config file
+    ELMOConfig config = loadConfig("../config/config.yaml");
 
-    // instantiate yaml config object
-    YAML::Node config = YAML::LoadFile(config_file);
+    // setup ethercat
+    config.port.copy(port, sizeof(port));
 
-    // load in the config parameters
-    std::string eth_port = config["ethernet"].as<std::string>();
+    // lock the memory before any thread starts, this thread runs the app loop
+    ELMOExecutor executor(config.realtime);
+    executor.lockMemory();
+    executor.adopt(ROLE_APP, "elmo_app");
 
-    // setup ethercat
-    eth_port.copy(port, sizeof(port));
-
-    // operation mode (TODO: fix bug, need to start at 8 then go to 10)
-    uint8 opmode = (uint8) config["OpMode"].as<int>();
-
-    // operating frequency
-    double freq = config["frequency"].as<double>();
-
-    // max program time
-    double max_time = config["max_prog_time"].as<double>();
-
-    // set up the joint gains
-    JointGains gains;
-    gains.Kp_HFL = config["gains"]["HFL"]["Kp"].as<double>();  // Hip Frontal Left (HFL)
-    gains.Kd_HFL = config["gains"]["HFL"]["Kd"].as<double>();
-    gains.Kff_HFL = config["gains"]["HFL"]["Kff"].as<double>();
-    
-    gains.Kp_HSL = config["gains"]["HSL"]["Kp"].as<double>();  // Hip Sagittal Left (HSL)
-    gains.Kd_HSL = config["gains"]["HSL"]["Kd"].as<double>();
-    gains.Kff_HSL = config["gains"]["HSL"]["Kff"].as<double>();
-    
-    gains.Kp_KL = config["gains"]["KL"]["Kp"].as<double>();    // Knee Left (KL)
-    gains.Kd_KL = config["gains"]["KL"]["Kd"].as<double>();
-    gains.Kff_KL = config["gains"]["KL"]["Kff"].as<double>();
-    
-    gains.Kp_HFR = config["gains"]["HFR"]["Kp"].as<double>();  // Hip Frontal Right (HFR)
-    gains.Kd_HFR = config["gains"]["HFR"]["Kd"].as<double>();
-    gains.Kff_HFR = config["gains"]["HFR"]["Kff"].as<double>();
-    
-    gains.Kp_HSR = config["gains"]["HSR"]["Kp"].as<double>();  // Hip Sagittal Right (HSR)
-    gains.Kd_HSR = config["gains"]["HSR"]["Kd"].as<double>();
-    gains.Kff_HSR = config["gains"]["HSR"]["Kff"].as<double>();
-    
-    gains.Kp_KR = config["gains"]["KR"]["Kp"].as<double>();    // Knee Right (KR)
-    gains.Kd_KR = config["gains"]["KR"]["Kd"].as<double>();
-    gains.Kff_KR = config["gains"]["KR"]["Kff"].as<double>();
-
-    // set up joint limits
-    JointLimits limits;
-    limits.q_min_HFL = config["limits"]["HFL"]["q_min"].as<double>(); // Hip Frontal Left (HFL)
-    limits.q_max_HFL = config["limits"]["HFL"]["q_max"].as<double>(); 
-    limits.qd_min_HFL = config["limits"]["HFL"]["qd_min"].as<double>();
-    limits.qd_max_HFL = config["limits"]["HFL"]["qd_max"].as<double>();
-
-    limits.q_min_HSL = config["limits"]["HSL"]["q_min"].as<double>(); // Hip Sagittal Left (HSL)
-    limits.q_max_HSL = config["limits"]["HSL"]["q_max"].as<double>();
-    limits.qd_min_HSL = config["limits"]["HSL"]["qd_min"].as<double>();
-    limits.qd_max_HSL = config["limits"]["HSL"]["qd_max"].as<double>();
-
-    limits.q_min_KL = config["limits"]["KL"]["q_min"].as<double>();   // Knee Left (KL)
-    limits.q_max_KL = config["limits"]["KL"]["q_max"].as<double>();
-    limits.qd_min_KL = config["limits"]["KL"]["qd_min"].as<double>();
-    limits.qd_max_KL = config["limits"]["KL"]["qd_max"].as<double>();
-
-    limits.q_min_HFR = config["limits"]["HFR"]["q_min"].as<double>();  // Hip Frontal Right (HFR)
-    limits.q_max_HFR = config["limits"]["HFR"]["q_max"].as<double>();
-    limits.qd_min_HFR = config["limits"]["HFR"]["qd_min"].as<double>();
-    limits.qd_max_HFR = config["limits"]["HFR"]["qd_max"].as<double>();
-
-    limits.q_min_HSR = config["limits"]["HSR"]["q_min"].as<double>();  // Hip Sagittal Right (HSR)
-    limits.q_max_HSR = config["limits"]["HSR"]["q_max"].as<double>();
-    limits.qd_min_HSR = config["limits"]["HSR"]["qd_min"].as<double>();
-    limits.qd_max_HSR = config["limits"]["HSR"]["qd_max"].as<double>();
-
-    limits.q_min_KR = config["limits"]["KR"]["q_min"].as<double>();    // Knee Right (KR)
-    limits.q_max_KR = config["limits"]["KR"]["q_max"].as<double>();
-    limits.qd_min_KR = config["limits"]["KR"]["qd_min"].as<double>();
-    limits.qd_max_KR = config["limits"]["KR"]["qd_max"].as<double>();
-
-    // for logging purposes
-    std::string log_file_time = "../data/time.csv";
-    std::string log_file_data = "../data/data.csv";
-    std::string log_file_commands = "../data/commands.csv";
-    std::string log_file_diagnostics = "../data/diagnostics.csv";
-    std::ofstream file_time;
-    std::ofstream file_data;
-    std::ofstream file_commands;
-    std::ofstream file_diagnostics;
-    file_time.open(log_file_time);
-    file_data.open(log_file_data);
-    file_commands.open(log_file_commands);
-    file_diagnostics.open(log_file_diagnostics);
+    // joint references, a file trajectory is mapped after the memory is locked so it is only read as it plays
+    Trajectory *trajectory = createTrajectory(config.trajectory);
+    if (trajectory == NULL) {
+        return 1;
+    }
+    TrajectoryPoint point;
+
+    // for logging purposes, records are written to disk by a background thread
+    std::string log_file = "../data/log.bin";
+    std::string log_dir = "../data";
+    ELMOLogger logger;
+    logger.start(log_file.c_str(), &executor);
+    LogRecord record;
 
     //***************************************************************
     // DO STUFF
@@ -143,99 +56,101 @@ int main() {
     ELMOInterface elmo;
 
     // set the joint gains and limits
-    elmo.setGains(gains);
-    elmo.setLimits(limits);
+    elmo.setGains(config.gains);
+    elmo.setLimits(config.limits);
+
+    // set the cyclic loop scheduling mode, the enable sequence and the EtherCAT backend
+    elmo.setCycleConfig(config.cycle);
+    elmo.setEnableConfig(config.enable);
+    elmo.setBusConfig(config.bus);
+    elmo.setDriveCount(config.drives);
+    elmo.setTelemetryConfig(config.telemetry);
+    elmo.setRecorderConfig(config.recorder);
+
+    // run the PD law in the app loop or in every bus cycle
+    elmo.setControlMode(config.control);
+    elmo.setInterpConfig(config.interp);
+
+    // start the bus thread and the ecat checking thread in their executor roles
+    elmo.initELMO(config.opmode, config.freq, port, executor);
+
+    // retune the gains and limits by saving the config file while running
+    ELMOConfigWatcher watcher;
+    if (config.reload.enabled) {
+        watcher.start("../config/config.yaml", config.reload, &elmo, &executor);
+    }
 
-    // create two threads, one for ELMO communication and the other for ecat checking
-    pthread_t thread1, thread2;
-    elmo.initELMO(opmode, freq, port, thread1, thread2);
+    // error register (0x1001) of a drive, the error code (0x603F) is read when it is set. The callbacks capture
+    // at most two pointers so queuing them does not allocate
+    SdoCallback error_code = [](const SdoResult &sdo) {
+        if (sdo.status == SDO_OK) {
+            printf("WARNING : drive %d error code 0x%04x\n", sdo.drive + 1, sdo.value);
+        }
+    };
+    SdoCallback error_register = [&elmo, &error_code](const SdoResult &sdo) {
+        if (sdo.status == SDO_OK && sdo.value != 0) {
+            printf("WARNING : drive %d error register 0x%02x\n", sdo.drive + 1, sdo.value);
+            elmo.sdoRead(sdo.drive, 0x603F, 0, error_code);
+        }
+        else if (sdo.status == SDO_FAILED) {
+            printf("WARNING : drive %d did not answer the error register read\n", sdo.drive + 1);
+        }
+    };
 
-    // for trajectory generation
-    double sine_sig, sine_sig_dt, sin_tau;
-    double A_ref, f_ref;
-    A_ref = 0.2;
-    f_ref = 0.25;
+    // app ticks are released on absolute deadlines and the thread sleeps in between, so at its real-time
+    // priority it never keeps the logger, mailbox and config watcher threads off its core
+    CycleScheduler app_cycle;
+    app_cycle.init(config.app_freq, {CYCLE_ABS_DEADLINE, 0.0, CATCHUP_SKIP, 1, 0.0, 0.0, 0.0, PIPELINE_OFF});
 
     // initialize the intial time
-    bool first_time = true;
     auto start = std::chrono::high_resolution_clock::now();
-    auto t1 = start;
-    double dt = 0.0, time = 0.0;
+    auto t_diag = start;
+    double time = 0.0;
 
     // get encoder data
-    while (time <= max_time) {
+    while (time <= config.max_time) {
 
         // get the current time in seconds
         auto t2 = std::chrono::high_resolution_clock::now();
-        auto duration_dt = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1);
-        dt = duration_dt.count() / 1'000'000.0; 
-        
-        if (dt >= (1.0 / freq) || first_time == true) {
-
-            // update first time
-            first_time = false;
-
-            // update time
-            t1 = t2;
-
-            // for logging time
-            auto duration_tot = std::chrono::duration_cast<std::chrono::microseconds>(t2 - start);
-            time = duration_tot.count() / 1'000'000.0; 
-
-            // get the current ELMO status
-            ELMOStatus diagnostics = elmo.getELMOStatus();
-
-            // get the current encoder data
-            JointVec data = elmo.getEncoderData();
-
-            // specify some joint reference
-            sine_sig = sin_wave(time, A_ref, f_ref);
-            sine_sig_dt = sin_wave_dt(time, A_ref, f_ref);
-            JointVec joint_ref;
-            joint_ref.setZero();
-
-            // HSL
-            joint_ref(0) = -0.0;
-            joint_ref(6) = 0.0;
-            // joint_ref(0) = sine_sig;
-            // joint_ref(6) = sine_sig_dt;
-
-            // HSL
-            joint_ref(1) = 0.0;
-            joint_ref(7) = 0.0;
-            // joint_ref(1) = sine_sig;
-            // joint_ref(7) = sine_sig_dt;
-
-            // KL 
-            joint_ref(2) = 0.0;
-            joint_ref(8) = 0.0;
-            // joint_ref(2) = sine_sig;
-            // joint_ref(8) = sine_sig_dt;
-
-            // HFR
-            joint_ref(3) = -0.0;
-            joint_ref(9) = 0.0;
-            // joint_ref(3) = sine_sig;
-            // joint_ref(9) = sine_sig_dt;
-
-            // HSR
-            joint_ref(4) = 0.0;
-            joint_ref(10) = 0.0;
-            // joint_ref(4) = sine_sig;
-            // joint_ref(10) = sine_sig_dt;
-            
-            // KR
-            joint_ref(5) = -0.0;
-            joint_ref(11) = 0.0;
-            // joint_ref(5) = sine_sig;
-            // joint_ref(11) = sine_sig_dt;
-
-            // specify some feedforward torque
-            JointTorque tau_ff;
-            tau_ff.setZero();
+
+        // for logging time
+        auto duration_tot = std::chrono::duration_cast<std::chrono::microseconds>(t2 - start);
+        time = duration_tot.count() / 1'000'000.0; 
+
+        // poll the drive diagnostics, the replies come back on the mailbox thread
+        if (config.diag_rate > 0.0 && std::chrono::duration<double>(t2 - t_diag).count() >= 1.0 / config.diag_rate) {
+            t_diag = t2;
+            for (int i = 0; i < elmo.getDriveCount(); i++) {
+                elmo.sdoRead(i, 0x1001, 0, error_register);
+            }
+        }
+
+        // get the current ELMO status
+        ELMOStatus diagnostics = elmo.getELMOStatus();
+
+        // get the current encoder data
+        JointVec data = elmo.getEncoderData();
+
+        // joint references and feedforward torque of the trajectory
+        trajectory->eval(time, point);
+        JointVec joint_ref;
+        joint_ref.head<NUM_JOINTS>() = point.q.matrix();
+        joint_ref.tail<NUM_JOINTS>() = point.qd.matrix();
+        JointTorque tau_ff = point.tau_ff.matrix();
+
+        JointTorque tau;
+        if (config.control == CONTROL_CYCLE_PD) {
+
+            // stream the setpoint, the comm thread computes the torque in every bus cycle
+            elmo.sendSetpoint(joint_ref, tau_ff);
+
+            // torque sent in the newest bus cycle
+            tau = elmo.getTorque();
+        }
+        else {
 
             // compute the net torque command
-            JointTorque tau = elmo.computeTorque(joint_ref, tau_ff);
+            tau = elmo.computeTorque(joint_ref, tau_ff);
 
             // DEBUG
             tau(0) = 0.0;  // Hip Frontal Left (HFL)
@@ -247,41 +162,54 @@ int main() {
 
             // send the torque command to the ELMO
             elmo.sendTorque(tau);
+        }
 
-            // log the time data
-            file_time << time << std::endl;
+        // log the time data
+        record.time = time;
 
-            // log the encoder and torque sent data
-            file_data << data(0);
-            for (int i = 1; i < data.size(); i++) {
-                file_data << ", " << data(i);
-            }
-            for (int i = 0; i < tau.size(); i++) {
-                file_data << ", " << tau(i);
-            }
-            file_data << std::endl;
+        // log the encoder and torque sent data
+        memcpy(record.data, data.data(), 12 * sizeof(double));
+        memcpy(record.data + 12, tau.data(), 6 * sizeof(double));
 
-            // log the reference and feedforward torque data
-            file_commands << joint_ref(0);
-            for (int i = 1; i < joint_ref.size(); i++) {
-                file_commands << ", " << joint_ref(i);
-            }
-            for (int i = 0; i < tau_ff.size(); i++) {
-                file_commands << ", " << tau_ff(i);
-            }
-            file_commands << std::endl;
+        // log the reference and feedforward torque data
+        memcpy(record.commands, joint_ref.data(), 12 * sizeof(double));
+        memcpy(record.commands + 12, tau_ff.data(), 6 * sizeof(double));
 
-            // log the diagnostics data
-            file_diagnostics << diagnostics(0);
-            for (int i = 1; i < diagnostics.size(); i++) {
-                file_diagnostics << ", " << diagnostics(i);
-            }
-            file_diagnostics << std::endl;
-        }
+        // log the diagnostics data
+        memcpy(record.diagnostics, diagnostics.data(), 18 * sizeof(double));
+
+        // queue the record, the writer thread batches it to disk
+        logger.push(record);
+
+        // sleep until the next tick
+        app_cycle.wait();
     }
 
-    // shutdown the ELMOs gracefully
+    // stop reloading, then shutdown the ELMOs gracefully
+    watcher.stop();
     elmo.shutdownELMO();
+    delete trajectory;
+
+    // dump the cyclic loop timing
+    elmo.printCycleStats();
+
+    // newest telemetry of every drive
+    const ELMOTelemetry &telem = elmo.getTelemetry();
+    if (!config.telemetry.objects.empty() && telem.head.cycle > 0) {
+        printf("Telemetry (cycle %llu):\n", (unsigned long long) telem.head.cycle);
+        for (int i = 0; i < telem.drives(); i++) {
+            const int32 *v = telem.drive[i].value;
+            printf("  drive %d: current %d, dc bus %.2f V, temperature %d C, following error %d, torque %d\n", i + 1,
+                   v[TELEM_CURRENT], v[TELEM_DC_VOLTAGE] * 1e-3, v[TELEM_TEMPERATURE], v[TELEM_FOLLOWING_ERROR], v[TELEM_TORQUE]);
+        }
+    }
+
+    // flush the log and convert it to CSV for data/plot_data.m
+    logger.stop();
+    convertLogToCSV(log_file.c_str(), log_dir.c_str());
+
+    // page faults and context switches of every thread
+    executor.report();
 
     return 0;
 }